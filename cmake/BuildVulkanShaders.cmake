@@ -54,7 +54,7 @@ foreach(GLSL_SHADER_FILE ${GLSL_SHADER_FILES})
 endforeach(GLSL_SHADER_FILE)
 
 string(SHA256 GLSL_SHADER_SHA256 "${TMP_SHADER_SHA256_LIST}")
-set(GLSL_SHADER_SHA256 "${GLSL_SHADER_SHA256}@v1")
+set(GLSL_SHADER_SHA256 "${GLSL_SHADER_SHA256}@v3")
 
 set(FOUND_MATCHING_SHA256_FILE FALSE)
 
@@ -162,6 +162,12 @@ if(NOT FOUND_MATCHING_SHA256_FILE)
   generate_shader_file("-DTW_QUAD_TEXTURED" "-DTW_PUSH_CONST" "${PROJECT_SOURCE_DIR}/data/shader/vulkan/quad.frag" "data/shader/vulkan/quad_push_textured.frag.spv")
   generate_shader_file("-DTW_QUAD_TEXTURED" "-DTW_PUSH_CONST" "${PROJECT_SOURCE_DIR}/data/shader/vulkan/quad.vert" "data/shader/vulkan/quad_push_textured.vert.spv")
 
+  # mario
+  generate_shader_file("" "" "${PROJECT_SOURCE_DIR}/data/shader/vulkan/mario.frag" "data/shader/vulkan/mario.frag.spv")
+  generate_shader_file("" "" "${PROJECT_SOURCE_DIR}/data/shader/vulkan/mario.vert" "data/shader/vulkan/mario.vert.spv")
+  generate_shader_file("-DTW_MARIO_POSE" "" "${PROJECT_SOURCE_DIR}/data/shader/vulkan/mario.frag" "data/shader/vulkan/mario_pose.frag.spv")
+  generate_shader_file("-DTW_MARIO_POSE" "" "${PROJECT_SOURCE_DIR}/data/shader/vulkan/mario.vert" "data/shader/vulkan/mario_pose.vert.spv")
+
   execute_process(${GLSLANG_VALIDATOR_COMMAND_LIST} RESULT_VARIABLE STATUS)
   if(STATUS AND NOT STATUS EQUAL 0)
     message(FATAL_ERROR "${GLSLANG_VALIDATOR_COMMAND_LIST} failed")
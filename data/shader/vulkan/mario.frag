@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform sampler2D gTextureSampler;
+
+#ifdef TW_MARIO_POSE
+layout(push_constant) uniform SFragParamsBO {
+	layout(offset = 112) uniform int gWingCap;
+	layout(offset = 116) uniform int gMetalCap;
+} gFragParamsBO;
+#else
+layout(push_constant) uniform SFragParamsBO {
+	layout(offset = 64) uniform int gWingCap;
+	layout(offset = 68) uniform int gMetalCap;
+} gFragParamsBO;
+#endif
+
+layout (location = 0) noperspective in vec3 oVertColor;
+layout (location = 1) noperspective in vec3 oNormal;
+layout (location = 2) noperspective in vec2 oTexCoord;
+
+layout (location = 0) out vec4 FragClr;
+
+void main()
+{
+	float Light = 0.5 + 0.5 * clamp(dot(oNormal, normalize(vec3(1.0))), 0.0, 1.0);
+	vec4 TexColor = texture(gTextureSampler, oTexCoord);
+	// the wing cap pass only keeps the feathers, not the white rectangles around them
+	if(gFragParamsBO.gWingCap == 1 && TexColor.a != 1.0)
+		discard;
+	vec3 VertColor = gFragParamsBO.gMetalCap == 1 ? vec3(0.0) : oVertColor;
+	vec3 MainColor = mix(VertColor, TexColor.rgb, TexColor.a);
+	FragClr = vec4(MainColor * Light, 1.0);
+}
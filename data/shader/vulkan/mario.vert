@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout (location = 0) in vec3 inVertex;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec4 inVertexColor;
+layout (location = 3) in vec2 inTexCoord;
+
+#ifdef TW_MARIO_POSE
+// the vertices are a part of the bind pose, drawn with the part's transform
+layout(push_constant) uniform SPosBO {
+	layout(offset = 0) uniform mat4 gProjModel;
+	layout(offset = 64) uniform vec4 gNormalMatrix[3];
+	layout(offset = 120) uniform uint gBodyColor; // no custom colors if the alpha is 0
+	layout(offset = 124) uniform uint gFeetColor;
+} gPosBO;
+#else
+layout(push_constant) uniform SPosBO {
+	layout(offset = 0) uniform mat4 gProjection;
+} gPosBO;
+#endif
+
+layout (location = 0) noperspective out vec3 oVertColor;
+layout (location = 1) noperspective out vec3 oNormal;
+layout (location = 2) noperspective out vec2 oTexCoord;
+
+void main()
+{
+#ifdef TW_MARIO_POSE
+	gl_Position = gPosBO.gProjModel * vec4(inVertex, 1.0);
+	oNormal = normalize(mat3(gPosBO.gNormalMatrix[0].xyz, gPosBO.gNormalMatrix[1].xyz, gPosBO.gNormalMatrix[2].xyz) * inNormal);
+
+	// the custom colors of the OpenGL Mario shader
+	oVertColor = inVertexColor.rgb;
+	vec4 BodyColor = unpackUnorm4x8(gPosBO.gBodyColor);
+	if(BodyColor.a != 0.0)
+	{
+		ivec3 Color = ivec3(round(inVertexColor.rgb * 255.0));
+		if(Color == ivec3(0, 0, 255)) // overalls / pants
+			oVertColor = BodyColor.rgb / 2.0;
+		else if(Color == ivec3(255, 0, 0)) // shirt / hat
+			oVertColor = BodyColor.rgb;
+		else if(Color == ivec3(114, 28, 14)) // shoes
+			oVertColor = unpackUnorm4x8(gPosBO.gFeetColor).rgb;
+	}
+#else
+	gl_Position = gPosBO.gProjection * vec4(inVertex, 1.0);
+	oVertColor = inVertexColor.rgb;
+	oNormal = inNormal;
+#endif
+	oTexCoord = inTexCoord;
+}
@@ -339,6 +339,26 @@ Objects = [
 		NetIntAny("m_Layer"),
 		NetIntAny("m_EntityClass"),
 	]),
+
+	# Mario simulated by the server, sent instead of its laser outline to
+	# clients that announced Cl_MarioInfo. The item ID is the owner's client ID.
+	# Clients pose their own copy of Mario from it with sm64_mario_anim_tick.
+	NetObjectEx("Mario", "mario@netobj.ddnet-sm64", [
+		NetIntAny("m_X"),
+		NetIntAny("m_Y"),
+		NetIntAny("m_VelX"),
+		NetIntAny("m_VelY"),
+		NetIntAny("m_Action"),
+		NetIntAny("m_Flags"),
+		NetIntAny("m_AnimID"),
+		NetIntAny("m_AnimFrame"),
+		NetIntAny("m_AnimAccel"),
+		NetIntAny("m_AngleX"),
+		NetIntAny("m_AngleY"),
+		NetIntAny("m_AngleZ"),
+		NetIntRange("m_Scale", 1, 500),
+		NetIntAny("m_TickPhase"),
+	]),
 ]
 
 Messages = [
@@ -513,4 +533,8 @@ Messages = [
 		NetIntAny("m_ServerTimeBest"),
 		NetIntAny("m_PlayerTimeBest"),
 	]),
+
+	NetMessageEx("Cl_MarioInfo", "mario-info@netmsg.ddnet-sm64", [
+		NetIntAny("m_Version"),
+	]),
 ]
@@ -1,3 +1,4 @@
+#include <pthread.h>
 #include <ultra64.h>
 #include <sm64.h>
 #include "heap.h"
@@ -804,13 +805,28 @@ void create_next_audio_buffer(s16 *samples, u32 num_samples) {
 #endif
 #endif
 
+// libsm64: set while re-simulating ticks whose sounds were already played
+static THREAD_LOCAL u8 sSoundRequestsMuted = FALSE;
+
+void set_sound_requests_muted(u8 muted) {
+    sSoundRequestsMuted = muted;
+}
+
 /**
  * Called from threads: thread5_game_loop
  */
+// libsm64: Marios can be ticked from several threads at once, they queue their sounds one at a time
+static pthread_mutex_t sSoundRequestLock = PTHREAD_MUTEX_INITIALIZER;
+
 void play_sound(s32 soundBits, f32 *pos) {
+    if (sSoundRequestsMuted) {
+        return;
+    }
+    pthread_mutex_lock(&sSoundRequestLock);
     sSoundRequests[sSoundRequestCount].soundBits = soundBits;
     sSoundRequests[sSoundRequestCount].position = pos;
     sSoundRequestCount++;
+    pthread_mutex_unlock(&sSoundRequestLock);
 	//DEBUG_PRINT("play_sound(%d) request#%d; pos %f %f %f\n", soundBits,sSoundRequestCount,pos[0],pos[1],pos[2]);
 }
 
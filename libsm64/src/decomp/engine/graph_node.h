@@ -346,10 +346,10 @@ struct GraphNodeCullingRadius
     u8 pad1E[2];
 };
 
-extern struct GraphNodeMasterList *gCurGraphNodeMasterList;
-extern struct GraphNodePerspective *gCurGraphNodeCamFrustum;
-extern struct GraphNodeCamera *gCurGraphNodeCamera;
-extern struct GraphNodeHeldObject *gCurGraphNodeHeldObject;
+extern THREAD_LOCAL struct GraphNodeMasterList *gCurGraphNodeMasterList;
+extern THREAD_LOCAL struct GraphNodePerspective *gCurGraphNodeCamFrustum;
+extern THREAD_LOCAL struct GraphNodeCamera *gCurGraphNodeCamera;
+extern THREAD_LOCAL struct GraphNodeHeldObject *gCurGraphNodeHeldObject;
 
 extern struct GraphNode *gCurRootGraphNode;
 extern struct GraphNode *gCurGraphNodeList[];
@@ -3,161 +3,353 @@
 #include "../include/surface_terrains.h"
 #include "../../load_surfaces.h"
 
+static s32 s_use_surface_grid = TRUE;
+
+void surface_collision_set_use_grid( s32 useGrid )
+{
+    s_use_surface_grid = useGrid;
+}
+
 /**
- * Iterate through the list of ceilings and find the first ceiling over a given point.
+ * Check a single ceiling against a given point, lowering *pheight if it is the closest one so far.
  */
-static struct Surface *find_ceil_from_list( s32 x, s32 y, s32 z, f32 *pheight) {
-    register struct Surface *surf;
+static s32 check_ceil( struct Surface *surf, s32 x, s32 y, s32 z, f32 *pheight) {
     register s32 x1, z1, x2, z2, x3, z3;
-    struct Surface *ceil = NULL;
 
-    ceil = NULL;
+    // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
+    if( !surf->isValid ) return FALSE;
 
-    uint32_t groupCount = loaded_surface_iter_group_count();
-    for( int i = 0; i < groupCount; ++i ) {
-    uint32_t surfCount = loaded_surface_iter_group_size( i );
-    for( int j = 0; j < surfCount; ++j ) {
-        surf = loaded_surface_iter_get_at_index( i, j );
+    // Do the check normally done in add_surface_to_cell
+    if( surf->normal.y >= -0.01f ) return FALSE;
 
-        // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
-        if( !surf->isValid ) continue;
+    x1 = surf->vertex1[0];
+    z1 = surf->vertex1[2];
+    z2 = surf->vertex2[2];
+    x2 = surf->vertex2[0];
 
-        // Do the check normally done in add_surface_to_cell
-        if( surf->normal.y >= -0.01f ) continue;
+    // Checking if point is in bounds of the triangle laterally.
+    if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) > 0) {
+        return FALSE;
+    }
 
-        x1 = surf->vertex1[0];
-        z1 = surf->vertex1[2];
-        z2 = surf->vertex2[2];
-        x2 = surf->vertex2[0];
+    // Slight optimization by checking these later.
+    x3 = surf->vertex3[0];
+    z3 = surf->vertex3[2];
+    if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) > 0) {
+        return FALSE;
+    }
+    if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) > 0) {
+        return FALSE;
+    }
 
-        // Checking if point is in bounds of the triangle laterally.
-        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) > 0) {
-            continue;
-        }
+    {
+        f32 nx = surf->normal.x;
+        f32 ny = surf->normal.y;
+        f32 nz = surf->normal.z;
+        f32 oo = surf->originOffset;
+        f32 height;
 
-        // Slight optimization by checking these later.
-        x3 = surf->vertex3[0];
-        z3 = surf->vertex3[2];
-        if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) > 0) {
-            continue;
+        // If a wall, ignore it. Likely a remnant, should never occur.
+        if (ny == 0.0f) {
+            return FALSE;
         }
-        if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) > 0) {
-            continue;
+
+        // Find the ceil height at the specific point.
+        height = -(x * nx + nz * z + oo) / ny;
+
+        // Checks for ceiling interaction with a 78 unit buffer.
+        //! (Exposed Ceilings) Because any point above a ceiling counts
+        //  as interacting with a ceiling, ceilings far below can cause
+        // "invisible walls" that are really just exposed ceilings.
+        if (y - (height - -78.0f) > 0.0f) {
+            return FALSE;
         }
 
+        if( height < *pheight )
         {
-            f32 nx = surf->normal.x;
-            f32 ny = surf->normal.y;
-            f32 nz = surf->normal.z;
-            f32 oo = surf->originOffset;
-            f32 height;
-
-            // If a wall, ignore it. Likely a remnant, should never occur.
-            if (ny == 0.0f) {
-                continue;
-            }
+            *pheight = height;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
 
-            // Find the ceil height at the specific point.
-            height = -(x * nx + nz * z + oo) / ny;
+/**
+ * Iterate through the list of ceilings and find the first ceiling over a given point.
+ */
+static struct Surface *find_ceil_from_list( s32 x, s32 y, s32 z, f32 *pheight) {
+    struct Surface *ceil = NULL;
 
-            // Checks for ceiling interaction with a 78 unit buffer.
-            //! (Exposed Ceilings) Because any point above a ceiling counts
-            //  as interacting with a ceiling, ceilings far below can cause
-            // "invisible walls" that are really just exposed ceilings.
-            if (y - (height - -78.0f) > 0.0f) {
-                continue;
-            }
+    uint32_t groupCount = loaded_surface_iter_group_count();
+    for( int i = 0; i < groupCount; ++i ) {
+    uint32_t surfCount = loaded_surface_iter_group_size( i );
+    for( int j = 0; j < surfCount; ++j ) {
+        struct Surface *surf = loaded_surface_iter_get_at_index( i, j );
+        if( check_ceil( surf, x, y, z, pheight ))
+            ceil = surf;
+    }}
+    return ceil;
+}
 
-            if( height < *pheight )
-            {
-                *pheight = height;
-                ceil = surf;
-            }
+/**
+ * Walk the grid column containing the point upwards and find the first ceiling over it.
+ * Each surface is tested in the first row of the walk that it occupies, so once a ceiling
+ * is found below the top of the current row, nothing further up can be closer. The walk
+ * covers all loaded rows: rows more than SURFACE_GRID_SIZE apart share a bucket, which the
+ * first row check skips.
+ */
+static struct Surface *find_ceil_from_grid( s32 x, s32 y, s32 z, f32 *pheight) {
+    struct Surface *ceil = NULL;
+    s32 minRow, maxRow;
+
+    if( !loaded_surface_grid_get_row_range( &minRow, &maxRow ))
+        return NULL;
+
+    s32 cellX = SURFACE_GRID_CELL_COORD( x );
+    s32 startRow = SURFACE_GRID_CELL_COORD( y - 78 );
+    if( startRow < minRow ) startRow = minRow;
+
+    for( s32 row = startRow; row <= maxRow; ++row ) {
+        uint32_t count;
+        struct SurfaceGridEntry *entries = loaded_surface_grid_get_cell( cellX, row, &count );
+
+        for( uint32_t i = 0; i < count; ++i ) {
+            struct SurfaceGridEntry *entry = &entries[i];
+            if( cellX < entry->minCellX || cellX > entry->maxCellX ) continue;
+            if( entry->maxCellY < startRow ) continue;
+
+            s32 firstRow = entry->minCellY > startRow ? entry->minCellY : startRow;
+            if( firstRow != row ) continue;
+
+            if( check_ceil( entry->surf, x, y, z, pheight ))
+                ceil = entry->surf;
         }
-    }}
+
+        if( ceil != NULL && *pheight < (( row + 1 ) << SURFACE_GRID_CELL_SHIFT ))
+            break;
+    }
     return ceil;
 }
 
 /**
- * Iterate through the list of floors and find the first floor under a given point.
+ * Check a single floor against a given point, raising *pheight if it is the closest one so far.
  */
-static struct Surface *find_floor_from_list( s32 x, s32 y, s32 z, f32 *pheight) {
-    register struct Surface *surf;
+static s32 check_floor( struct Surface *surf, s32 x, s32 y, s32 z, f32 *pheight) {
     register s32 x1, z1, x2, z2, x3, z3;
     f32 nx, ny, nz;
     f32 oo;
     f32 height;
+
+    // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
+    if( !surf->isValid ) return FALSE;
+
+    // Do the check normally done in add_surface_to_cell
+    if( surf->normal.y <= 0.01f ) return FALSE;
+
+    x1 = surf->vertex1[0];
+    z1 = surf->vertex1[2];
+    x2 = surf->vertex2[0];
+    z2 = surf->vertex2[2];
+
+    // Check that the point is within the triangle bounds.
+    if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) < 0) {
+        return FALSE;
+    }
+
+    // To slightly save on computation time, set this later.
+    x3 = surf->vertex3[0];
+    z3 = surf->vertex3[2];
+
+    if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) < 0) {
+        return FALSE;
+    }
+    if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) < 0) {
+        return FALSE;
+    }
+
+    nx = surf->normal.x;
+    ny = surf->normal.y;
+    nz = surf->normal.z;
+    oo = surf->originOffset;
+
+    // If a wall, ignore it. Likely a remnant, should never occur.
+    if (ny == 0.0f) {
+        return FALSE;
+    }
+
+    // Find the height of the floor at a given location.
+    height = -(x * nx + nz * z + oo) / ny;
+    // Checks for floor interaction with a 78 unit buffer.
+    if (y - (height + -78.0f) < 0.0f) {
+        return FALSE;
+    }
+
+    if( height > *pheight )
+    {
+        *pheight = height;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Iterate through the list of floors and find the first floor under a given point.
+ */
+static struct Surface *find_floor_from_list( s32 x, s32 y, s32 z, f32 *pheight) {
     struct Surface *floor = NULL;
 
     uint32_t groupCount = loaded_surface_iter_group_count();
     for( int i = 0; i < groupCount; ++i ) {
     uint32_t surfCount = loaded_surface_iter_group_size( i );
     for( int j = 0; j < surfCount; ++j ) {
-        surf = loaded_surface_iter_get_at_index( i, j );
+        struct Surface *surf = loaded_surface_iter_get_at_index( i, j );
+        if( check_floor( surf, x, y, z, pheight ))
+            floor = surf;
+    }}
+    return floor;
+}
 
-        // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
-        if( !surf->isValid ) continue;
+/**
+ * Walk the grid column containing the point downwards and find the first floor under it.
+ * Mirror image of find_ceil_from_grid.
+ */
+static struct Surface *find_floor_from_grid( s32 x, s32 y, s32 z, f32 *pheight) {
+    struct Surface *floor = NULL;
+    s32 minRow, maxRow;
 
-        // Do the check normally done in add_surface_to_cell
-        if( surf->normal.y <= 0.01f ) continue;
+    if( !loaded_surface_grid_get_row_range( &minRow, &maxRow ))
+        return NULL;
 
-        x1 = surf->vertex1[0];
-        z1 = surf->vertex1[2];
-        x2 = surf->vertex2[0];
-        z2 = surf->vertex2[2];
+    s32 cellX = SURFACE_GRID_CELL_COORD( x );
+    s32 startRow = SURFACE_GRID_CELL_COORD( y + 78 );
+    if( startRow > maxRow ) startRow = maxRow;
 
-        // Check that the point is within the triangle bounds.
-        if ((z1 - z) * (x2 - x1) - (x1 - x) * (z2 - z1) < 0) {
-            continue;
-        }
+    for( s32 row = startRow; row >= minRow; --row ) {
+        uint32_t count;
+        struct SurfaceGridEntry *entries = loaded_surface_grid_get_cell( cellX, row, &count );
 
-        // To slightly save on computation time, set this later.
-        x3 = surf->vertex3[0];
-        z3 = surf->vertex3[2];
+        for( uint32_t i = 0; i < count; ++i ) {
+            struct SurfaceGridEntry *entry = &entries[i];
+            if( cellX < entry->minCellX || cellX > entry->maxCellX ) continue;
+            if( entry->minCellY > startRow ) continue;
 
-        if ((z2 - z) * (x3 - x2) - (x2 - x) * (z3 - z2) < 0) {
-            continue;
-        }
-        if ((z3 - z) * (x1 - x3) - (x3 - x) * (z1 - z3) < 0) {
-            continue;
+            s32 firstRow = entry->maxCellY < startRow ? entry->maxCellY : startRow;
+            if( firstRow != row ) continue;
+
+            if( check_floor( entry->surf, x, y, z, pheight ))
+                floor = entry->surf;
         }
 
-        nx = surf->normal.x;
-        ny = surf->normal.y;
-        nz = surf->normal.z;
-        oo = surf->originOffset;
+        if( floor != NULL && *pheight >= ( row << SURFACE_GRID_CELL_SHIFT ))
+            break;
+    }
+    return floor;
+}
 
-        // If a wall, ignore it. Likely a remnant, should never occur.
-        if (ny == 0.0f) {
-            continue;
-        }
+/**
+ * Check a single wall against the collision data and push the point out of it.
+ */
+static s32 check_wall( struct Surface *surf, struct WallCollisionData *data, f32 x, f32 y, f32 z, f32 radius) {
+    register f32 offset;
+    register f32 px, pz;
+    register f32 w1, w2, w3;
+    register f32 y1, y2, y3;
 
-        // Find the height of the floor at a given location.
-        height = -(x * nx + nz * z + oo) / ny;
-        // Checks for floor interaction with a 78 unit buffer.
-        if (y - (height + -78.0f) < 0.0f) {
-            continue;
+    // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
+    if( !surf->isValid ) return FALSE;
+
+    // Do the check normally done in add_surface_to_cell
+    if( surf->normal.y < -0.01f || surf->normal.y > 0.01f ) return FALSE;
+
+    // Exclude a large number of walls immediately to optimize.
+    if (y < surf->lowerY || y > surf->upperY) {
+        return FALSE;
+    }
+
+    offset = surf->normal.x * x + surf->normal.y * y + surf->normal.z * z + surf->originOffset;
+
+    if (offset < -radius || offset > radius) {
+        return FALSE;
+    }
+
+    px = x;
+    pz = z;
+
+    //! (Quantum Tunneling) Due to issues with the vertices walls choose and
+    //  the fact they are floating point, certain floating point positions
+    //  along the seam of two walls may collide with neither wall or both walls.
+    if (surf->flags & SURFACE_FLAG_X_PROJECTION) {
+        w1 = -surf->vertex1[2];            w2 = -surf->vertex2[2];            w3 = -surf->vertex3[2];
+        y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
+
+        if (surf->normal.x > 0.0f) {
+            if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) > 0.0f) {
+                return FALSE;
+            }
+            if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) > 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) > 0.0f) {
+                return FALSE;
+            }
+        } else {
+            if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) < 0.0f) {
+                return FALSE;
+            }
+            if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) < 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) < 0.0f) {
+                return FALSE;
+            }
         }
+    } else {
+        w1 = surf->vertex1[0];            w2 = surf->vertex2[0];            w3 = surf->vertex3[0];
+        y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
 
-        if( height > *pheight )
-        {
-            *pheight = height;
-            floor = surf;
+        if (surf->normal.z > 0.0f) {
+            if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) > 0.0f) {
+                return FALSE;
+            }
+            if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) > 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) > 0.0f) {
+                return FALSE;
+            }
+        } else {
+            if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) < 0.0f) {
+                return FALSE;
+            }
+            if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) < 0.0f) {
+                return FALSE;
+            }
+            if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) < 0.0f) {
+                return FALSE;
+            }
         }
-    }}
-    return floor;
+    }
+
+    //! (Wall Overlaps) Because this doesn't update the x and z local variables,
+    //  multiple walls can push mario more than is required.
+    data->x += surf->normal.x * (radius - offset);
+    data->z += surf->normal.z * (radius - offset);
+
+    //! (Unreferenced Walls) Since this only returns the first four walls,
+    //  this can lead to wall interaction being missed. Typically unreferenced walls
+    //  come from only using one wall, however.
+    if (data->numWalls < 4) {
+        data->walls[data->numWalls++] = surf;
+    }
+
+    return TRUE;
 }
 
 static s32 find_wall_collisions_from_list( struct WallCollisionData *data) {
-    register struct Surface *surf;
-    register f32 offset;
     register f32 radius = data->radius;
     register f32 x = data->x;
     register f32 y = data->y + data->offsetY;
     register f32 z = data->z;
-    register f32 px, pz;
-    register f32 w1, w2, w3;
-    register f32 y1, y2, y3;
     s32 numCols = 0;
 
     // Max collision radius = 200
@@ -169,101 +361,46 @@ static s32 find_wall_collisions_from_list( struct WallCollisionData *data) {
     for( int i = 0; i < groupCount; ++i ) {
     uint32_t surfCount = loaded_surface_iter_group_size( i );
     for( int j = 0; j < surfCount; ++j ) {
-        surf = loaded_surface_iter_get_at_index( i, j );
-
-        // libsm64: Weed out surfaces whose triangles are actually line segs. TODO do this at surface load time
-        if( !surf->isValid ) continue;
-
-        // Do the check normally done in add_surface_to_cell
-        if( surf->normal.y < -0.01f || surf->normal.y > 0.01f ) continue;
+        numCols += check_wall( loaded_surface_iter_get_at_index( i, j ), data, x, y, z, radius );
+    }}
 
-        if( surf->normal.x < -0.707f || surf->normal.x > 0.707f ) {
-            surf->flags |= SURFACE_FLAG_X_PROJECTION;
-        }
+    return numCols;
+}
 
-        // Exclude a large number of walls immediately to optimize.
-        if (y < surf->lowerY || y > surf->upperY) {
-            continue;
-        }
+/**
+ * Visit the grid cells within the collision radius of the point. A surface spanning several
+ * of them is only checked in the first visited cell it occupies, so walls never push twice.
+ */
+static s32 find_wall_collisions_from_grid( struct WallCollisionData *data) {
+    register f32 radius = data->radius;
+    register f32 x = data->x;
+    register f32 y = data->y + data->offsetY;
+    register f32 z = data->z;
+    s32 numCols = 0;
 
-        offset = surf->normal.x * x + surf->normal.y * y + surf->normal.z * z + surf->originOffset;
+    // Max collision radius = 200
+    if (radius > 200.0f) {
+        radius = 200.0f;
+    }
 
-        if (offset < -radius || offset > radius) {
-            continue;
-        }
+    // Walls using the X projection can be up to radius / 0.707 away along X from the point.
+    s32 row = SURFACE_GRID_CELL_COORD( floorf( y ));
+    s32 minCellX = SURFACE_GRID_CELL_COORD( floorf( x - radius * 1.5f ));
+    s32 maxCellX = SURFACE_GRID_CELL_COORD( floorf( x + radius * 1.5f ));
 
-        px = x;
-        pz = z;
-
-        //! (Quantum Tunneling) Due to issues with the vertices walls choose and
-        //  the fact they are floating point, certain floating point positions
-        //  along the seam of two walls may collide with neither wall or both walls.
-        if (surf->flags & SURFACE_FLAG_X_PROJECTION) {
-            w1 = -surf->vertex1[2];            w2 = -surf->vertex2[2];            w3 = -surf->vertex3[2];
-            y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
-
-            if (surf->normal.x > 0.0f) {
-                if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) > 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) > 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) > 0.0f) {
-                    continue;
-                }
-            } else {
-                if ((y1 - y) * (w2 - w1) - (w1 - -pz) * (y2 - y1) < 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - -pz) * (y3 - y2) < 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - -pz) * (y1 - y3) < 0.0f) {
-                    continue;
-                }
-            }
-        } else {
-            w1 = surf->vertex1[0];            w2 = surf->vertex2[0];            w3 = surf->vertex3[0];
-            y1 = surf->vertex1[1];            y2 = surf->vertex2[1];            y3 = surf->vertex3[1];
-
-            if (surf->normal.z > 0.0f) {
-                if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) > 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) > 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) > 0.0f) {
-                    continue;
-                }
-            } else {
-                if ((y1 - y) * (w2 - w1) - (w1 - px) * (y2 - y1) < 0.0f) {
-                    continue;
-                }
-                if ((y2 - y) * (w3 - w2) - (w2 - px) * (y3 - y2) < 0.0f) {
-                    continue;
-                }
-                if ((y3 - y) * (w1 - w3) - (w3 - px) * (y1 - y3) < 0.0f) {
-                    continue;
-                }
-            }
-        }
+    for( s32 cellX = minCellX; cellX <= maxCellX; ++cellX ) {
+        uint32_t count;
+        struct SurfaceGridEntry *entries = loaded_surface_grid_get_cell( cellX, row, &count );
 
-        //! (Wall Overlaps) Because this doesn't update the x and z local variables,
-        //  multiple walls can push mario more than is required.
-        data->x += surf->normal.x * (radius - offset);
-        data->z += surf->normal.z * (radius - offset);
+        for( uint32_t i = 0; i < count; ++i ) {
+            struct SurfaceGridEntry *entry = &entries[i];
+            if( row < entry->minCellY || row > entry->maxCellY ) continue;
+            if( cellX < entry->minCellX || cellX > entry->maxCellX ) continue;
+            if( cellX != minCellX && cellX != entry->minCellX ) continue;
 
-        //! (Unreferenced Walls) Since this only returns the first four walls,
-        //  this can lead to wall interaction being missed. Typically unreferenced walls
-        //  come from only using one wall, however.
-        if (data->numWalls < 4) {
-            data->walls[data->numWalls++] = surf;
+            numCols += check_wall( entry->surf, data, x, y, z, radius );
         }
-
-        numCols++;
-    }}
+    }
 
     return numCols;
 }
@@ -306,18 +443,24 @@ s32 find_wall_collisions(struct WallCollisionData *colData)
     //     return numCollisions;
     // }
 
-    numCollisions += find_wall_collisions_from_list(colData);
+    if( s_use_surface_grid )
+        numCollisions += find_wall_collisions_from_grid(colData);
+    else
+        numCollisions += find_wall_collisions_from_list(colData);
     return numCollisions;
 }
 
 f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil)
 {
     f32 height = CELL_HEIGHT_LIMIT;
-	*pceil = find_ceil_from_list( posX, posY, posZ, &height );
+	if( s_use_surface_grid )
+		*pceil = find_ceil_from_grid( posX, posY, posZ, &height );
+	else
+		*pceil = find_ceil_from_list( posX, posY, posZ, &height );
 	return height;
 }
 
-struct FloorGeometry sFloorGeo;
+THREAD_LOCAL struct FloorGeometry sFloorGeo;
 
 f32 find_floor_height_and_data(f32 xPos, f32 yPos, f32 zPos, struct FloorGeometry **floorGeo)
 {
@@ -340,14 +483,20 @@ f32 find_floor_height_and_data(f32 xPos, f32 yPos, f32 zPos, struct FloorGeometr
 f32 find_floor_height(f32 x, f32 y, f32 z)
 {
     f32 height = FLOOR_LOWER_LIMIT;
-	find_floor_from_list( x, y, z, &height );
+	if( s_use_surface_grid )
+		find_floor_from_grid( x, y, z, &height );
+	else
+		find_floor_from_list( x, y, z, &height );
 	return height;
 }
 
 f32 find_floor(f32 xPos, f32 yPos, f32 zPos, struct Surface **pfloor)
 {
     f32 height = FLOOR_LOWER_LIMIT;
-	*pfloor = find_floor_from_list( xPos, yPos, zPos, &height );
+	if( s_use_surface_grid )
+		*pfloor = find_floor_from_grid( xPos, yPos, zPos, &height );
+	else
+		*pfloor = find_floor_from_list( xPos, yPos, zPos, &height );
 	return height;
 }
 
@@ -30,6 +30,7 @@ struct FloorGeometry
     f32 originOffset;
 };
 
+void surface_collision_set_use_grid(s32 useGrid);
 s32 f32_find_wall_collision(f32 *xPtr, f32 *yPtr, f32 *zPtr, f32 offsetY, f32 radius);
 s32 find_wall_collisions(struct WallCollisionData *colData);
 f32 find_ceil(f32 posX, f32 posY, f32 posZ, struct Surface **pceil);
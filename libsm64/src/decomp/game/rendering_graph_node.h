@@ -5,12 +5,12 @@
 
 #include "../engine/graph_node.h"
 
-extern struct GraphNodeRoot *gCurGraphNodeRoot;
-extern struct GraphNodeMasterList *gCurGraphNodeMasterList;
-extern struct GraphNodePerspective *gCurGraphNodeCamFrustum;
-extern struct GraphNodeCamera *gCurGraphNodeCamera;
-extern struct GraphNodeObject *gCurGraphNodeObject;
-extern struct GraphNodeHeldObject *gCurGraphNodeHeldObject;
+extern THREAD_LOCAL struct GraphNodeRoot *gCurGraphNodeRoot;
+extern THREAD_LOCAL struct GraphNodeMasterList *gCurGraphNodeMasterList;
+extern THREAD_LOCAL struct GraphNodePerspective *gCurGraphNodeCamFrustum;
+extern THREAD_LOCAL struct GraphNodeCamera *gCurGraphNodeCamera;
+extern THREAD_LOCAL struct GraphNodeObject *gCurGraphNodeObject;
+extern THREAD_LOCAL struct GraphNodeHeldObject *gCurGraphNodeHeldObject;
 
 // after processing an object, the type is reset to this
 #define ANIM_TYPE_NONE                  0
@@ -29,5 +29,6 @@ extern struct GraphNodeHeldObject *gCurGraphNodeHeldObject;
 void geo_process_node_and_siblings(struct GraphNode *firstNode);
 //void geo_process_root(struct GraphNodeRoot *node, Vp *b, Vp *c, s32 clearColor);
 void geo_process_root_hack_single_node(struct GraphNode *node);
+void geo_process_root_hack_animation_only(void);
 
 #endif // RENDERING_GRAPH_NODE_H
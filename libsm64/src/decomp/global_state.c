@@ -3,7 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-struct GlobalState *g_state = 0;
+THREAD_LOCAL struct GlobalState *g_state = 0;
 
 struct GlobalState *global_state_create(void)
 {
@@ -47,7 +47,7 @@ struct GlobalState
 // From mario_actions_submerged.c, needed to initialize global state
 #define MIN_SWIM_STRENGTH 160
 
-extern struct GlobalState *g_state;
+extern THREAD_LOCAL struct GlobalState *g_state;
 
 extern struct GlobalState *global_state_create(void);
 extern void global_state_bind(struct GlobalState *state);
@@ -51,6 +51,13 @@
 #define ALIGNED8
 #endif
 
+// libsm64: state of the Mario being ticked is kept per thread, so Marios can tick in parallel
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
 // Align to 16-byte boundary for audio lib requirements
 #ifdef __GNUC__
 #define ALIGNED16 __attribute__((aligned(16)))
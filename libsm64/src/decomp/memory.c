@@ -11,7 +11,8 @@ struct AllocOnlyPool
     void **allocatedBlocks;
 };
 
-struct AllocOnlyPool *s_display_list_pool;
+// matrices allocated while rendering a Mario, per thread since Marios can be ticked in parallel
+static THREAD_LOCAL struct AllocOnlyPool *s_display_list_pool = NULL;
 
 void memory_init(void)
 {
@@ -20,7 +21,9 @@ void memory_init(void)
 
 void memory_terminate(void)
 {
-    alloc_only_pool_free( s_display_list_pool );
+    if( s_display_list_pool != NULL )
+        alloc_only_pool_free( s_display_list_pool );
+    s_display_list_pool = NULL;
 }
 
 struct AllocOnlyPool *alloc_only_pool_init(void)
@@ -49,7 +52,8 @@ void alloc_only_pool_free(struct AllocOnlyPool *pool)
 
 void display_list_pool_reset(void)
 {
-    alloc_only_pool_free( s_display_list_pool );
+    if( s_display_list_pool != NULL )
+        alloc_only_pool_free( s_display_list_pool );
     s_display_list_pool = alloc_only_pool_init();
 }
 
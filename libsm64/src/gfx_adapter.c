@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "libsm64.h"
 #include "decomp/engine/math_util.h"
@@ -7,21 +8,42 @@
 #include "gfx_adapter.h"
 #include "gfx_adapter_commands.h"
 #include "load_tex_data.h"
+#include "debug_print.h"
 
-static Mat4 s_curMatrix;
-static float s_curColor[3];
+static THREAD_LOCAL Mat4 s_curMatrix;
+static THREAD_LOCAL float s_curColor[3];
 
-static uint16_t s_scaleS, s_scaleT, s_uls, s_ult;
-static int s_textureOn, s_textureIndex;
-static float s_texWidth;
-static float s_texHeight;
+static THREAD_LOCAL uint16_t s_scaleS, s_scaleT, s_uls, s_ult;
+static THREAD_LOCAL int s_textureOn, s_textureIndex;
+static THREAD_LOCAL float s_texWidth;
+static THREAD_LOCAL float s_texHeight;
 
-static struct SM64MarioGeometryBuffers *s_outBuffers;
+static THREAD_LOCAL struct SM64MarioGeometryBuffers *s_outBuffers;
+static THREAD_LOCAL struct SM64MarioPose *s_outPose;
+static THREAD_LOCAL float *s_trianglesEnd;
+static THREAD_LOCAL int s_skipTriangles;
 
-static float *s_trianglePtr;
-static float *s_colorPtr;
-static float *s_normalPtr;
-static float *s_uvPtr;
+// the display lists drawn in this pose so far, a display list drawn twice is two parts
+static THREAD_LOCAL void *s_poseDisplayLists[SM64_MARIO_MAX_POSE_PARTS];
+
+// the bind pose mesh is shared by the Marios of all threads
+struct BindPosePart
+{
+    void *displayList;
+    int occurrence;
+    uint16_t firstTriangle;
+    uint16_t numTriangles;
+};
+static pthread_mutex_t s_bindPoseLock = PTHREAD_MUTEX_INITIALIZER;
+static struct SM64MarioGeometryBuffers s_bindPose;
+static struct BindPosePart *s_bindPoseParts;
+static int s_numBindPoseParts, s_maxBindPoseParts;
+static bool s_bindPoseFull;
+
+static THREAD_LOCAL float *s_trianglePtr;
+static THREAD_LOCAL float *s_colorPtr;
+static THREAD_LOCAL float *s_normalPtr;
+static THREAD_LOCAL float *s_uvPtr;
 
 static void mtxf_mul_vec3f_x(Mat4 mtx, Vec3f b, float w, Vec3f out)
 {
@@ -64,6 +86,10 @@ static void process_display_list( void *dl )
                 int64_t v02 = *ptr++;
                 UNUSED int64_t flag0 = *ptr++;
 
+                // only the render state is followed for parts already in the bind pose
+                if( s_skipTriangles || s_trianglePtr >= s_trianglesEnd )
+                    break;
+
                 float x0 = vdata[v00].v.ob[0], y0 = vdata[v00].v.ob[1], z0 = vdata[v00].v.ob[2];
                 float x1 = vdata[v01].v.ob[0], y1 = vdata[v01].v.ob[1], z1 = vdata[v01].v.ob[2];
                 float x2 = vdata[v02].v.ob[0], y2 = vdata[v02].v.ob[1], z2 = vdata[v02].v.ob[2];
@@ -201,17 +227,161 @@ void gSPMatrix( void *pkt, Mtx *m, uint8_t flags )
     guMtxL2F( s_curMatrix, m );
 }
 
+static void bind_output_buffers( struct SM64MarioGeometryBuffers *outBuffers, uint32_t maxTriangles )
+{
+    s_outBuffers = outBuffers;
+    s_trianglePtr = s_outBuffers->position + 9 * s_outBuffers->numTrianglesUsed;
+    s_colorPtr = s_outBuffers->color + 9 * s_outBuffers->numTrianglesUsed;
+    s_normalPtr = s_outBuffers->normal + 9 * s_outBuffers->numTrianglesUsed;
+    s_uvPtr = s_outBuffers->uv + 6 * s_outBuffers->numTrianglesUsed;
+    s_trianglesEnd = s_outBuffers->position + 9 * maxTriangles;
+}
+
+// returns the part's range of the bind pose, the part is added with the current render state if it's new
+static bool get_bind_pose_part( void *dl, int occurrence, uint16_t *firstTriangle, uint16_t *numTriangles )
+{
+    bool found = false;
+    pthread_mutex_lock( &s_bindPoseLock );
+
+    for( int i = 0; i < s_numBindPoseParts; ++i )
+    {
+        if( s_bindPoseParts[i].displayList == dl && s_bindPoseParts[i].occurrence == occurrence )
+        {
+            *firstTriangle = s_bindPoseParts[i].firstTriangle;
+            *numTriangles = s_bindPoseParts[i].numTriangles;
+            found = true;
+            break;
+        }
+    }
+
+    if( !found && !s_bindPoseFull )
+    {
+        if( s_bindPose.position == NULL )
+        {
+            s_bindPose.position = malloc( sizeof( float ) * 9 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+            s_bindPose.normal = malloc( sizeof( float ) * 9 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+            s_bindPose.color = malloc( sizeof( float ) * 9 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+            s_bindPose.uv = malloc( sizeof( float ) * 6 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+            s_bindPose.numTrianglesUsed = 0;
+        }
+        if( s_numBindPoseParts == s_maxBindPoseParts )
+        {
+            s_maxBindPoseParts = s_maxBindPoseParts ? s_maxBindPoseParts * 2 : SM64_MARIO_MAX_POSE_PARTS;
+            s_bindPoseParts = realloc( s_bindPoseParts, sizeof( struct BindPosePart ) * s_maxBindPoseParts );
+        }
+
+        // the part's vertices in its own space
+        struct SM64MarioGeometryBuffers *poseBuffers = s_outBuffers;
+        Mat4 poseMatrix;
+        mtxf_copy( poseMatrix, s_curMatrix );
+        mtxf_identity( s_curMatrix );
+        bind_output_buffers( &s_bindPose, SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+
+        struct BindPosePart *part = &s_bindPoseParts[s_numBindPoseParts++];
+        part->displayList = dl;
+        part->occurrence = occurrence;
+        part->firstTriangle = s_bindPose.numTrianglesUsed;
+        process_display_list( dl );
+        part->numTriangles = s_bindPose.numTrianglesUsed - part->firstTriangle;
+
+        if( s_bindPose.numTrianglesUsed == SM64_MARIO_BIND_POSE_MAX_TRIANGLES )
+        {
+            DEBUG_PRINT( "Mario's bind pose is full, parts drawn for the first time from now on are missing" );
+            s_bindPoseFull = true;
+        }
+
+        mtxf_copy( s_curMatrix, poseMatrix );
+        s_outBuffers = poseBuffers;
+
+        *firstTriangle = part->firstTriangle;
+        *numTriangles = part->numTriangles;
+        found = true;
+    }
+
+    pthread_mutex_unlock( &s_bindPoseLock );
+    return found;
+}
+
+static void pose_display_list( void *dl )
+{
+    struct SM64MarioPose *pose = s_outPose;
+    if( pose->numPartsUsed == SM64_MARIO_MAX_POSE_PARTS )
+        return;
+
+    int occurrence = 0;
+    for( int i = 0; i < pose->numPartsUsed; ++i )
+        if( s_poseDisplayLists[i] == dl )
+            occurrence++;
+
+    uint16_t firstTriangle, numTriangles;
+    if( get_bind_pose_part( dl, occurrence, &firstTriangle, &numTriangles ))
+    {
+        // the render state set by the part still applies to the next ones
+        s_skipTriangles = 1;
+        process_display_list( dl );
+        s_skipTriangles = 0;
+    }
+    else
+        numTriangles = 0;
+
+    // parts without triangles still count for the occurrences
+    struct SM64MarioPart *part = &pose->parts[pose->numPartsUsed];
+    s_poseDisplayLists[pose->numPartsUsed] = dl;
+    part->firstTriangle = firstTriangle;
+    part->numTriangles = numTriangles;
+    mtxf_copy( part->transform, s_curMatrix );
+    pose->numPartsUsed++;
+}
+
 void gSPDisplayList( void *pkt, struct DisplayListNode *dl )
 {
-    process_display_list( (void*)dl );
+    if( s_outPose != NULL )
+        pose_display_list( (void*)dl );
+    else
+        process_display_list( (void*)dl );
 }
 
 void gfx_adapter_bind_output_buffers( struct SM64MarioGeometryBuffers *outBuffers )
 {
-    s_outBuffers = outBuffers;
-    s_trianglePtr = s_outBuffers->position;
-    s_colorPtr = s_outBuffers->color;
-    s_normalPtr = s_outBuffers->normal;
-    s_uvPtr = s_outBuffers->uv;
-    s_outBuffers->numTrianglesUsed = 0;
+    s_outPose = NULL;
+    outBuffers->numTrianglesUsed = 0;
+    bind_output_buffers( outBuffers, SM64_GEO_MAX_TRIANGLES );
+}
+
+void gfx_adapter_bind_output_pose( struct SM64MarioPose *outPose )
+{
+    s_outPose = outPose;
+    s_outPose->numPartsUsed = 0;
+}
+
+void gfx_adapter_update_bind_pose( struct SM64MarioGeometryBuffers *outBuffers )
+{
+    pthread_mutex_lock( &s_bindPoseLock );
+    if( outBuffers->numTrianglesUsed < s_bindPose.numTrianglesUsed )
+    {
+        int first = outBuffers->numTrianglesUsed;
+        int count = s_bindPose.numTrianglesUsed - first;
+        memcpy( outBuffers->position + 9 * first, s_bindPose.position + 9 * first, sizeof( float ) * 9 * count );
+        memcpy( outBuffers->normal + 9 * first, s_bindPose.normal + 9 * first, sizeof( float ) * 9 * count );
+        memcpy( outBuffers->color + 9 * first, s_bindPose.color + 9 * first, sizeof( float ) * 9 * count );
+        memcpy( outBuffers->uv + 6 * first, s_bindPose.uv + 6 * first, sizeof( float ) * 6 * count );
+        outBuffers->numTrianglesUsed = s_bindPose.numTrianglesUsed;
+    }
+    pthread_mutex_unlock( &s_bindPoseLock );
+}
+
+void gfx_adapter_free_bind_pose( void )
+{
+    pthread_mutex_lock( &s_bindPoseLock );
+    free( s_bindPose.position );
+    free( s_bindPose.normal );
+    free( s_bindPose.color );
+    free( s_bindPose.uv );
+    memset( &s_bindPose, 0, sizeof( s_bindPose ));
+    free( s_bindPoseParts );
+    s_bindPoseParts = NULL;
+    s_numBindPoseParts = 0;
+    s_maxBindPoseParts = 0;
+    s_bindPoseFull = false;
+    pthread_mutex_unlock( &s_bindPoseLock );
 }
\ No newline at end of file
@@ -12,4 +12,7 @@
 extern void gSPMatrix( void *pkt, Mtx *m, uint8_t flags );
 extern void gSPDisplayList( void *pkt, struct DisplayListNode *dl );
 
-extern void gfx_adapter_bind_output_buffers( struct SM64MarioGeometryBuffers *outBuffers );
\ No newline at end of file
+extern void gfx_adapter_bind_output_buffers( struct SM64MarioGeometryBuffers *outBuffers );
+extern void gfx_adapter_bind_output_pose( struct SM64MarioPose *outPose );
+extern void gfx_adapter_update_bind_pose( struct SM64MarioGeometryBuffers *outBuffers );
+extern void gfx_adapter_free_bind_pose( void );
\ No newline at end of file
@@ -47,12 +47,26 @@
 #include "decomp/tools/convUtils.h"
 #include "decomp/mario/geo.inc.h"
 
+// The geo callbacks write into Mario's graph nodes while rendering him, so every thread that ticks
+// Marios processes its own copy of the graph. All copies live in the same pool.
 static struct AllocOnlyPool *s_mario_geo_pool = NULL;
-static struct GraphNode *s_mario_graph_node = NULL;
+static pthread_mutex_t s_mario_geo_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t s_mario_geo_generation = 0;
+static THREAD_LOCAL struct GraphNode *s_mario_graph_node = NULL;
+static THREAD_LOCAL uint32_t s_mario_graph_node_generation = 0;
 static struct AudioAPI *audio_api;
 
 static bool s_init_global = false;
 static bool s_init_one_mario = false;
+static bool s_audio_thread_running = false;
+static bool s_audio_pull = false;
+
+enum AudioMode
+{
+    AUDIO_MODE_THREAD, // libsm64 plays its audio itself
+    AUDIO_MODE_NONE, // headless
+    AUDIO_MODE_PULL, // the embedder mixes it, see sm64_audio_pull
+};
 
 struct MarioInstance
 {
@@ -77,6 +91,19 @@ static void update_button( bool on, u16 button )
     }
 }
 
+static struct GraphNode *get_mario_graph_node( void )
+{
+    if( s_mario_graph_node == NULL || s_mario_graph_node_generation != s_mario_geo_generation )
+    {
+        pthread_mutex_lock( &s_mario_geo_lock );
+        s_mario_graph_node = process_geo_layout( s_mario_geo_pool, mario_geo_ptr );
+        s_mario_graph_node_generation = s_mario_geo_generation;
+        pthread_mutex_unlock( &s_mario_geo_lock );
+    }
+
+    return s_mario_graph_node;
+}
+
 static struct Area *allocate_area( void )
 {
     struct Area *result = malloc( sizeof( struct Area ));
@@ -96,7 +123,7 @@ static void free_area( struct Area *area )
 }
 
 pthread_t gSoundThread;
-SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction )
+static void global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction, enum AudioMode audioMode )
 {
 	g_debug_print_func = debugPrintFunction;
 	
@@ -118,10 +145,29 @@ SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugP
 
     s_init_global = true;
 
-    load_mario_textures_from_rom( rom, outTexture );
+    if( outTexture != NULL )
+        load_mario_textures_from_rom( rom, outTexture );
     load_mario_anims_from_rom( rom );
 
     memory_init();
+
+	// the sound banks are still set up when headless, Mario keeps queueing sounds nobody plays
+	if( audioMode == AUDIO_MODE_NONE ) {
+		audio_init();
+		sound_init();
+		sound_reset(0);
+		DEBUG_PRINT("Audio API: None (headless)");
+		return;
+	}
+
+	if( audioMode == AUDIO_MODE_PULL ) {
+		audio_init();
+		sound_init();
+		sound_reset(0);
+		s_audio_pull = true;
+		DEBUG_PRINT("Audio API: None (pulled by the embedder)");
+		return;
+	}
 	
 	#if HAVE_WASAPI && !defined(SM64_NULL_AUDIO)
 	if (audio_api == NULL && audio_wasapi.init()) {
@@ -156,6 +202,22 @@ SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugP
 	sound_init();
 	sound_reset(0);
 	pthread_create(&gSoundThread, NULL, audio_thread, &s_init_global);
+	s_audio_thread_running = true;
+}
+
+SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction )
+{
+    global_init( rom, outTexture, debugPrintFunction, AUDIO_MODE_THREAD );
+}
+
+SM64_LIB_FN void sm64_global_init_pull_audio( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction )
+{
+    global_init( rom, outTexture, debugPrintFunction, AUDIO_MODE_PULL );
+}
+
+SM64_LIB_FN void sm64_global_init_headless( uint8_t *rom, SM64DebugPrintFunctionPtr debugPrintFunction )
+{
+    global_init( rom, NULL, debugPrintFunction, AUDIO_MODE_NONE );
 }
 
 SM64_LIB_FN void sm64_global_terminate( void )
@@ -163,7 +225,10 @@ SM64_LIB_FN void sm64_global_terminate( void )
     if( !s_init_global ) return;
 
 	audio_api = NULL;
-	pthread_cancel(gSoundThread);
+	if( s_audio_thread_running )
+		pthread_cancel(gSoundThread);
+	s_audio_thread_running = false;
+	s_audio_pull = false;
 
     global_state_bind( NULL );
     
@@ -181,8 +246,11 @@ SM64_LIB_FN void sm64_global_terminate( void )
 	   
 	ctl_free();
     alloc_only_pool_free( s_mario_geo_pool );
+    s_mario_geo_pool = NULL;
+    s_mario_geo_generation++;
     surfaces_unload_all();
     unload_mario_anims();
+    gfx_adapter_free_bind_pose();
     memory_terminate();
 }
 
@@ -203,7 +271,7 @@ SM64_LIB_FN int32_t sm64_mario_create( float x, float y, float z, int16_t rx, in
     {
         s_init_one_mario = true;
         s_mario_geo_pool = alloc_only_pool_init();
-        s_mario_graph_node = process_geo_layout( s_mario_geo_pool, mario_geo_ptr );
+        get_mario_graph_node();
     }
 
     gCurrSaveFileNum = 1;
@@ -262,7 +330,7 @@ SM64_LIB_FN struct SM64AnimInfo* sm64_mario_get_anim_info( int32_t marioId, int1
 	return &gMarioState->marioObj->header.gfx.animInfo;
 }
 
-SM64_LIB_FN void sm64_mario_anim_tick( int32_t marioId, uint32_t stateFlags, struct SM64AnimInfo* animInfo, struct SM64MarioGeometryBuffers *outBuffers, int16_t rot[3] )
+static void mario_anim_tick( int32_t marioId, uint32_t stateFlags, struct SM64AnimInfo* animInfo, struct SM64MarioGeometryBuffers *outBuffers, struct SM64MarioPose *outPose, int16_t rot[3] )
 {
 	if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
     {
@@ -279,17 +347,35 @@ SM64_LIB_FN void sm64_mario_anim_tick( int32_t marioId, uint32_t stateFlags, str
 	
 	gMarioState->flags = stateFlags;
 	mario_update_hitbox_and_cap_model( gMarioState );
-	if (gMarioState->marioObj->header.gfx.animInfo.animFrame != animInfo->animID && animInfo->animID != -1)
+	if (gMarioState->marioObj->header.gfx.animInfo.animID != animInfo->animID && animInfo->animID != -1)
         set_mario_anim_with_accel( gMarioState, animInfo->animID, animInfo->animAccel );
     gMarioState->marioObj->header.gfx.animInfo.animAccel = animInfo->animAccel;
 
-    gfx_adapter_bind_output_buffers( outBuffers );
-    geo_process_root_hack_single_node( s_mario_graph_node );
+    // pose the given frame as is instead of advancing the animation from it
+    gMarioState->marioObj->header.gfx.animInfo.animFrame = animInfo->animFrame;
+    gMarioState->marioObj->header.gfx.animInfo.animFrameAccelAssist = animInfo->animFrameAccelAssist;
+    gMarioState->marioObj->header.gfx.animInfo.animTimer = gAreaUpdateCounter;
+
+    if( outPose != NULL )
+        gfx_adapter_bind_output_pose( outPose );
+    else
+        gfx_adapter_bind_output_buffers( outBuffers );
+    geo_process_root_hack_single_node( get_mario_graph_node() );
     gAreaUpdateCounter++;
 }
 
+SM64_LIB_FN void sm64_mario_anim_tick( int32_t marioId, uint32_t stateFlags, struct SM64AnimInfo* animInfo, struct SM64MarioGeometryBuffers *outBuffers, int16_t rot[3] )
+{
+    mario_anim_tick( marioId, stateFlags, animInfo, outBuffers, NULL, rot );
+}
 
-SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioGeometryBuffers *outBuffers )
+SM64_LIB_FN void sm64_mario_anim_tick_pose( int32_t marioId, uint32_t stateFlags, struct SM64AnimInfo* animInfo, struct SM64MarioPose *outPose, int16_t rot[3] )
+{
+    mario_anim_tick( marioId, stateFlags, animInfo, NULL, outPose, rot );
+}
+
+
+static void mario_tick( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioGeometryBuffers *outBuffers, struct SM64MarioPose *outPose )
 {
     if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
     {
@@ -318,9 +404,19 @@ SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs
     bhv_mario_update();
     update_mario_platform(); // TODO platform grabbed here and used next tick could be a use-after-free
 
-    gfx_adapter_bind_output_buffers( outBuffers );
-
-    geo_process_root_hack_single_node( s_mario_graph_node );
+    // without output buffers only Mario's animation is advanced, the physics depend on it
+    if( outPose != NULL )
+    {
+        gfx_adapter_bind_output_pose( outPose );
+        geo_process_root_hack_single_node( get_mario_graph_node() );
+    }
+    else if( outBuffers != NULL )
+    {
+        gfx_adapter_bind_output_buffers( outBuffers );
+        geo_process_root_hack_single_node( get_mario_graph_node() );
+    }
+    else
+        geo_process_root_hack_animation_only();
 
     gAreaUpdateCounter++;
 
@@ -334,6 +430,21 @@ SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs
 	outState->invincTimer = gMarioState->invincTimer;
 }
 
+SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioGeometryBuffers *outBuffers )
+{
+    mario_tick( marioId, inputs, outState, outBuffers, NULL );
+}
+
+SM64_LIB_FN void sm64_mario_tick_pose( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioPose *outPose )
+{
+    mario_tick( marioId, inputs, outState, NULL, outPose );
+}
+
+SM64_LIB_FN void sm64_mario_update_bind_pose( struct SM64MarioGeometryBuffers *outBuffers )
+{
+    gfx_adapter_update_bind_pose( outBuffers );
+}
+
 SM64_LIB_FN void sm64_mario_delete( int32_t marioId )
 {
     if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
@@ -354,6 +465,72 @@ SM64_LIB_FN void sm64_mario_delete( int32_t marioId )
     obj_pool_free_index( &s_mario_instance_pool, marioId );
 }
 
+// Everything a Mario's simulation depends on. The pointers inside it all point into the Mario's own
+// global state, object and area, or into static tables, so they stay valid when restored into the same Mario.
+struct MarioSavedState
+{
+    struct GlobalState globalState;
+    struct Object marioObject;
+    struct Area area;
+    struct Camera camera;
+};
+
+SM64_LIB_FN uint32_t sm64_mario_saved_state_size( void )
+{
+    return sizeof( struct MarioSavedState );
+}
+
+SM64_LIB_FN void sm64_mario_save_state( int32_t marioId, void *outBuffer )
+{
+    if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
+    {
+        DEBUG_PRINT("Tried to save non-existant Mario with ID: %d", marioId);
+        return;
+    }
+
+    struct GlobalState *globalState = ((struct MarioInstance *)s_mario_instance_pool.objects[ marioId ])->globalState;
+    global_state_bind( globalState );
+
+    struct MarioSavedState *saved = (struct MarioSavedState *)outBuffer;
+    memcpy( &saved->globalState, globalState, sizeof( struct GlobalState ));
+    memcpy( &saved->marioObject, gMarioObject, sizeof( struct Object ));
+    memcpy( &saved->area, gCurrentArea, sizeof( struct Area ));
+    memcpy( &saved->camera, gCurrentArea->camera, sizeof( struct Camera ));
+}
+
+SM64_LIB_FN void sm64_mario_restore_state( int32_t marioId, const void *buffer )
+{
+    if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
+    {
+        DEBUG_PRINT("Tried to restore non-existant Mario with ID: %d", marioId);
+        return;
+    }
+
+    struct GlobalState *globalState = ((struct MarioInstance *)s_mario_instance_pool.objects[ marioId ])->globalState;
+    global_state_bind( globalState );
+
+    const struct MarioSavedState *saved = (const struct MarioSavedState *)buffer;
+    struct Object *marioObject = gMarioObject;
+    struct Area *area = gCurrentArea;
+    struct Camera *camera = area->camera;
+    memcpy( globalState, &saved->globalState, sizeof( struct GlobalState ));
+    memcpy( marioObject, &saved->marioObject, sizeof( struct Object ));
+    memcpy( area, &saved->area, sizeof( struct Area ));
+    memcpy( camera, &saved->camera, sizeof( struct Camera ));
+
+    // surfaces may have been loaded and unloaded since the state was saved, look them up again
+    struct MarioState *m = gMarioState;
+    m->wall = NULL;
+    m->floorHeight = find_floor( m->pos[0], m->pos[1], m->pos[2], &m->floor );
+    m->ceilHeight = vec3f_find_ceil( m->pos, m->floorHeight, &m->ceil );
+    update_mario_platform();
+}
+
+SM64_LIB_FN void sm64_set_sounds_muted( uint8_t muted )
+{
+    set_sound_requests_muted( muted );
+}
+
 SM64_LIB_FN void sm64_set_mario_position(int32_t marioId, float x, float y, float z)
 {
 	if( marioId >= s_mario_instance_pool.size || s_mario_instance_pool.objects[marioId] == NULL )
@@ -711,6 +888,16 @@ SM64_LIB_FN void sm64_surface_object_delete( uint32_t objectId )
     surfaces_unload_object( objectId );
 }
 
+SM64_LIB_FN uint32_t sm64_surface_object_count( void )
+{
+    return surfaces_count_objects();
+}
+
+SM64_LIB_FN uint32_t sm64_surface_count( void )
+{
+    return surfaces_count_total();
+}
+
 SM64_LIB_FN void sm64_seq_player_play_sequence(uint8_t player, uint8_t seqId, uint16_t arg2)
 {
     seq_player_play_sequence(player,seqId,arg2);
@@ -782,19 +969,57 @@ void* audio_thread(void* keepAlive)
 	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE,NULL); 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED,NULL);
 	
-    long long currentTime = timeInMilliseconds();
-    long long targetTime = 0;
+    long long targetTime = timeInMilliseconds();
     while(1)
 	{
 		if(!*((bool*)keepAlive)) return NULL;
 		audio_signal_game_loop_tick();
 		audio_tick();
-		targetTime = currentTime + 33;
-		while (timeInMilliseconds() < targetTime)
+		// sleep until the next tick is due instead of polling the clock
+		targetTime += 33;
+		long long currentTime = timeInMilliseconds();
+		if (currentTime < targetTime)
+			usleep((targetTime - currentTime) * 1000);
+		else
+			targetTime = currentTime; // fell behind, don't try to catch up
+    }
+}
+
+// one block of audio generated for sm64_audio_pull that wasn't pulled completely yet
+static s16 s_pull_buffer[SAMPLES_HIGH * 2];
+static uint32_t s_pull_frames = 0;
+static uint32_t s_pull_pos = 0;
+static uint32_t s_pull_block = 0;
+
+SM64_LIB_FN uint32_t sm64_audio_pull( int16_t *outFrames, uint32_t numFrames )
+{
+	if( !s_audio_pull )
+	{
+		memset( outFrames, 0, numFrames * 2 * sizeof(int16_t) );
+		return 0;
+	}
+
+	uint32_t done = 0;
+	while( done < numFrames )
+	{
+		if( s_pull_pos == s_pull_frames )
 		{
-			usleep(100);
-			if(!*((bool*)keepAlive)) return NULL;
+			// the game loop ticks once every two blocks like in audio_thread, the block sizes
+			// 528, 528, 544 average out to the SM64_AUDIO_RATE frames the 30 ticks per second need
+			if( s_pull_block % 2 == 0 )
+				audio_signal_game_loop_tick();
+			s_pull_frames = s_pull_block % 3 == 2 ? SAMPLES_HIGH : SAMPLES_LOW;
+			s_pull_block = (s_pull_block + 1) % 6;
+			create_next_audio_buffer( s_pull_buffer, s_pull_frames );
+			s_pull_pos = 0;
 		}
-		currentTime = timeInMilliseconds();
-    }
+
+		uint32_t n = numFrames - done;
+		if( n > s_pull_frames - s_pull_pos )
+			n = s_pull_frames - s_pull_pos;
+		memcpy( outFrames + done * 2, s_pull_buffer + s_pull_pos * 2, n * 2 * sizeof(int16_t) );
+		s_pull_pos += n;
+		done += n;
+	}
+	return numFrames;
 }
@@ -16,6 +16,16 @@
     #define SM64_LIB_FN
 #endif
 
+enum
+{
+    SM64_TEXTURE_WIDTH = 64 * 11,
+    SM64_TEXTURE_HEIGHT = 64,
+    SM64_GEO_MAX_TRIANGLES = 1024,
+    SM64_AUDIO_RATE = 32000,
+    SM64_MARIO_MAX_POSE_PARTS = 64,
+    SM64_MARIO_BIND_POSE_MAX_TRIANGLES = 4096,
+};
+
 struct SM64Surface
 {
     int16_t type;
@@ -65,6 +75,23 @@ struct SM64MarioGeometryBuffers
     uint16_t numTrianglesUsed;
 };
 
+// One drawn part of Mario, e.g. his head or left thigh: a range of the bind pose mesh (see sm64_mario_update_bind_pose)
+// and the matrix that places it. Like SM64's Mat4, vertices are row vectors multiplied from the left.
+struct SM64MarioPart
+{
+    uint16_t firstTriangle;
+    uint16_t numTriangles;
+    float transform[4][4];
+};
+
+// Mario's pose as the transforms of the parts he draws, an alternative to SM64MarioGeometryBuffers
+// for renderers that transform the bind pose mesh on the GPU.
+struct SM64MarioPose
+{
+    struct SM64MarioPart parts[SM64_MARIO_MAX_POSE_PARTS];
+    uint16_t numPartsUsed;
+};
+
 struct SM64MarioColorGroup
 {
     uint8_t shade[3];
@@ -108,23 +135,42 @@ struct SM64AnimInfo
 
 typedef void (*SM64DebugPrintFunctionPtr)( const char * );
 
-enum
-{
-    SM64_TEXTURE_WIDTH = 64 * 11,
-    SM64_TEXTURE_HEIGHT = 64,
-    SM64_GEO_MAX_TRIANGLES = 1024,
-};
 
 extern SM64_LIB_FN void sm64_global_init( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction );
+// Initializes without libsm64's own audio output and thread, the audio is generated on demand by sm64_audio_pull.
+extern SM64_LIB_FN void sm64_global_init_pull_audio( uint8_t *rom, uint8_t *outTexture, SM64DebugPrintFunctionPtr debugPrintFunction );
+// Initializes without the audio thread and without decoding Mario's texture, for servers.
+// sm64_mario_tick may be passed NULL output buffers to skip generating Mario's mesh.
+extern SM64_LIB_FN void sm64_global_init_headless( uint8_t *rom, SM64DebugPrintFunctionPtr debugPrintFunction );
 extern SM64_LIB_FN void sm64_global_terminate( void );
+// Fills outFrames with numFrames interleaved stereo frames at SM64_AUDIO_RATE and returns numFrames, or silence and 0
+// if libsm64 wasn't initialized with sm64_global_init_pull_audio. Only one thread may pull, stop before terminating.
+extern SM64_LIB_FN uint32_t sm64_audio_pull( int16_t *outFrames, uint32_t numFrames );
 
 extern SM64_LIB_FN void sm64_static_surfaces_load( const struct SM64Surface *surfaceArray, uint32_t numSurfaces );
 
 extern SM64_LIB_FN int32_t sm64_mario_create( float x, float y, float z, int16_t rx, int16_t ry, int16_t rz, uint8_t fake );
 extern SM64_LIB_FN void sm64_mario_tick( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioGeometryBuffers *outBuffers );
 extern SM64_LIB_FN struct SM64AnimInfo* sm64_mario_get_anim_info( int32_t marioId, int16_t rot[3] );
+// Poses Mario with the animation and frame in animInfo and generates his mesh, without ticking his physics.
+// Meant for Marios created with fake = 1 that mirror another Mario, e.g. one received over the network.
 extern SM64_LIB_FN void sm64_mario_anim_tick( int32_t marioId, uint32_t stateFlags, struct SM64AnimInfo* animInfo, struct SM64MarioGeometryBuffers *outBuffers, int16_t rot[3] );
+// Like sm64_mario_tick and sm64_mario_anim_tick, but output the transforms of Mario's parts instead of his mesh.
+extern SM64_LIB_FN void sm64_mario_tick_pose( int32_t marioId, const struct SM64MarioInputs *inputs, struct SM64MarioState *outState, struct SM64MarioPose *outPose );
+extern SM64_LIB_FN void sm64_mario_anim_tick_pose( int32_t marioId, uint32_t stateFlags, struct SM64AnimInfo* animInfo, struct SM64MarioPose *outPose, int16_t rot[3] );
+// The bind pose mesh is shared by all Marios: each part in its own space, with the render state it was first drawn with.
+// Parts are appended the first time any Mario draws them. Copies the triangles added since outBuffers->numTrianglesUsed,
+// outBuffers must have room for SM64_MARIO_BIND_POSE_MAX_TRIANGLES.
+extern SM64_LIB_FN void sm64_mario_update_bind_pose( struct SM64MarioGeometryBuffers *outBuffers );
 extern SM64_LIB_FN void sm64_mario_delete( int32_t marioId );
+// Snapshots a Mario's simulation state into a buffer of sm64_mario_saved_state_size() bytes, to rewind
+// him later with sm64_mario_restore_state, e.g. to replay inputs for client-side prediction.
+// A saved state can only be restored into the Mario it was saved from.
+extern SM64_LIB_FN uint32_t sm64_mario_saved_state_size( void );
+extern SM64_LIB_FN void sm64_mario_save_state( int32_t marioId, void *outBuffer );
+extern SM64_LIB_FN void sm64_mario_restore_state( int32_t marioId, const void *buffer );
+// Drops the sounds requested by Marios ticked on the calling thread while set, for ticks being replayed.
+extern SM64_LIB_FN void sm64_set_sounds_muted( uint8_t muted );
 
 extern SM64_LIB_FN void sm64_set_mario_action(int32_t marioId, uint32_t action);
 extern SM64_LIB_FN void sm64_set_mario_action_arg(int32_t marioId, uint32_t action, uint32_t actionArg);
@@ -150,6 +196,8 @@ extern SM64_LIB_FN bool sm64_mario_attack(int32_t marioId, float x, float y, flo
 extern SM64_LIB_FN uint32_t sm64_surface_object_create( const struct SM64SurfaceObject *surfaceObject );
 extern SM64_LIB_FN void sm64_surface_object_move( uint32_t objectId, const struct SM64ObjectTransform *transform );
 extern SM64_LIB_FN void sm64_surface_object_delete( uint32_t objectId );
+extern SM64_LIB_FN uint32_t sm64_surface_object_count( void );
+extern SM64_LIB_FN uint32_t sm64_surface_count( void );
 
 extern SM64_LIB_FN void sm64_seq_player_play_sequence(uint8_t player, uint8_t seqId, uint16_t arg2);
 extern SM64_LIB_FN void sm64_play_music(uint8_t player, uint16_t seqArgs, uint16_t fadeTimer);
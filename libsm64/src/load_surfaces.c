@@ -24,6 +24,20 @@ static struct Surface *s_static_surface_list = NULL;
 
 static uint32_t s_surface_object_count = 0;
 static struct LoadedSurfaceObject *s_surface_object_list = NULL;
+static uint32_t s_live_surface_object_count = 0;
+static uint32_t s_object_surface_count = 0;
+
+struct SurfaceGridCell
+{
+    uint32_t count;
+    uint32_t capacity;
+    struct SurfaceGridEntry *entries;
+};
+
+static struct SurfaceGridCell s_surface_grid[ SURFACE_GRID_SIZE * SURFACE_GRID_SIZE ];
+static uint32_t s_surface_grid_entry_count = 0;
+static s32 s_surface_grid_min_cell_y = 0;
+static s32 s_surface_grid_max_cell_y = 0;
 
 #define CONVERT_ANGLE( x ) ((s16)( -(x) / 180.0f * 32768.0f ))
 
@@ -194,6 +208,11 @@ static void engine_surface_from_lib_surface( struct Surface *surface, const stru
     s16 hasForce = surface_has_force(type);
     s16 flags = 0; // surf_has_no_cam_collision(type);
 
+    // set here like the original read_surface_data, so collision queries never write to surfaces
+    if (nx < -0.707 || nx > 0.707) {
+        flags |= SURFACE_FLAG_X_PROJECTION;
+    }
+
     surface->room = 0;
     surface->type = type;
     surface->flags = (s8) flags;
@@ -208,6 +227,122 @@ static void engine_surface_from_lib_surface( struct Surface *surface, const stru
     surface->isValid = 1;
 }
 
+static struct SurfaceGridCell *grid_cell_at( s32 cellX, s32 cellY )
+{
+    return &s_surface_grid[ (cellY & (SURFACE_GRID_SIZE - 1)) * SURFACE_GRID_SIZE + (cellX & (SURFACE_GRID_SIZE - 1)) ];
+}
+
+static void grid_surface_bounds( const struct Surface *surf, struct SurfaceGridEntry *out )
+{
+    s32 minX = surf->vertex1[0];
+    s32 maxX = surf->vertex1[0];
+
+    if( surf->vertex2[0] < minX ) minX = surf->vertex2[0];
+    if( surf->vertex3[0] < minX ) minX = surf->vertex3[0];
+    if( surf->vertex2[0] > maxX ) maxX = surf->vertex2[0];
+    if( surf->vertex3[0] > maxX ) maxX = surf->vertex3[0];
+
+    out->minCellX = SURFACE_GRID_CELL_COORD( minX );
+    out->maxCellX = SURFACE_GRID_CELL_COORD( maxX );
+    out->minCellY = SURFACE_GRID_CELL_COORD( surf->lowerY );
+    out->maxCellY = SURFACE_GRID_CELL_COORD( surf->upperY );
+}
+
+// Surfaces wider or taller than the grid land in every bucket of that axis once.
+static s32 grid_clamp_span( s32 minCell, s32 maxCell )
+{
+    if( maxCell - minCell >= SURFACE_GRID_SIZE )
+        return minCell + SURFACE_GRID_SIZE - 1;
+    return maxCell;
+}
+
+static void grid_add_surface( struct Surface *surf )
+{
+    if( !surf->isValid )
+        return;
+
+    struct SurfaceGridEntry entry;
+    entry.surf = surf;
+    grid_surface_bounds( surf, &entry );
+
+    if( s_surface_grid_entry_count == 0 || entry.minCellY < s_surface_grid_min_cell_y )
+        s_surface_grid_min_cell_y = entry.minCellY;
+    if( s_surface_grid_entry_count == 0 || entry.maxCellY > s_surface_grid_max_cell_y )
+        s_surface_grid_max_cell_y = entry.maxCellY;
+    s_surface_grid_entry_count++;
+
+    s32 lastX = grid_clamp_span( entry.minCellX, entry.maxCellX );
+    s32 lastY = grid_clamp_span( entry.minCellY, entry.maxCellY );
+
+    for( s32 cy = entry.minCellY; cy <= lastY; ++cy )
+    for( s32 cx = entry.minCellX; cx <= lastX; ++cx )
+    {
+        struct SurfaceGridCell *cell = grid_cell_at( cx, cy );
+        if( cell->count == cell->capacity )
+        {
+            cell->capacity = cell->capacity ? cell->capacity * 2 : 16;
+            cell->entries = realloc( cell->entries, cell->capacity * sizeof( struct SurfaceGridEntry ));
+        }
+        cell->entries[ cell->count++ ] = entry;
+    }
+}
+
+static void grid_remove_surface( struct Surface *surf )
+{
+    if( !surf->isValid )
+        return;
+
+    struct SurfaceGridEntry bounds;
+    grid_surface_bounds( surf, &bounds );
+
+    s32 lastX = grid_clamp_span( bounds.minCellX, bounds.maxCellX );
+    s32 lastY = grid_clamp_span( bounds.minCellY, bounds.maxCellY );
+
+    for( s32 cy = bounds.minCellY; cy <= lastY; ++cy )
+    for( s32 cx = bounds.minCellX; cx <= lastX; ++cx )
+    {
+        struct SurfaceGridCell *cell = grid_cell_at( cx, cy );
+        for( uint32_t i = 0; i < cell->count; ++i )
+        {
+            if( cell->entries[i].surf == surf )
+            {
+                cell->entries[i] = cell->entries[ --cell->count ];
+                break;
+            }
+        }
+    }
+
+    s_surface_grid_entry_count--;
+}
+
+static void grid_clear( void )
+{
+    for( int i = 0; i < SURFACE_GRID_SIZE * SURFACE_GRID_SIZE; ++i )
+    {
+        free( s_surface_grid[i].entries );
+        s_surface_grid[i].entries = NULL;
+        s_surface_grid[i].count = 0;
+        s_surface_grid[i].capacity = 0;
+    }
+
+    s_surface_grid_entry_count = 0;
+}
+
+struct SurfaceGridEntry *loaded_surface_grid_get_cell( s32 cellX, s32 cellY, uint32_t *outCount )
+{
+    struct SurfaceGridCell *cell = grid_cell_at( cellX, cellY );
+    *outCount = cell->count;
+    return cell->entries;
+}
+
+bool loaded_surface_grid_get_row_range( s32 *outMinCellY, s32 *outMaxCellY )
+{
+    // The range only ever grows while surfaces are loaded, which keeps it conservative.
+    *outMinCellY = s_surface_grid_min_cell_y;
+    *outMaxCellY = s_surface_grid_max_cell_y;
+    return s_surface_grid_entry_count > 0;
+}
+
 uint32_t loaded_surface_iter_group_count( void )
 {
     return 1 + s_surface_object_count;
@@ -232,13 +367,20 @@ struct Surface *loaded_surface_iter_get_at_index( uint32_t groupIndex, uint32_t
 void surfaces_load_static( const struct SM64Surface *surfaceArray, uint32_t numSurfaces )
 {
     if( s_static_surface_list != NULL )
+    {
+        for( int i = 0; i < s_static_surface_count; ++i )
+            grid_remove_surface( &s_static_surface_list[i] );
         free( s_static_surface_list );
+    }
 
     s_static_surface_count = numSurfaces;
     s_static_surface_list = malloc( sizeof( struct Surface ) * numSurfaces );
 
     for( int i = 0; i < numSurfaces; ++i )
+    {
         engine_surface_from_lib_surface( &s_static_surface_list[i], &surfaceArray[i], NULL );
+        grid_add_surface( &s_static_surface_list[i] );
+    }
 }
 
 uint32_t surfaces_load_object( const struct SM64SurfaceObject *surfaceObject )
@@ -275,7 +417,13 @@ uint32_t surfaces_load_object( const struct SM64SurfaceObject *surfaceObject )
 
     obj->engineSurfaces = malloc( obj->surfaceCount * sizeof( struct Surface ));
     for( int i = 0; i < obj->surfaceCount; ++i )
+    {
         engine_surface_from_lib_surface( &obj->engineSurfaces[i], &obj->libSurfaces[i], obj->transform );
+        grid_add_surface( &obj->engineSurfaces[i] );
+    }
+
+    s_live_surface_object_count++;
+    s_object_surface_count += obj->surfaceCount;
 
     return idx;
 }
@@ -288,6 +436,12 @@ void surfaces_unload_object( uint32_t objId )
         return;
     }
 
+    for( int i = 0; i < s_surface_object_list[objId].surfaceCount; ++i )
+        grid_remove_surface( &s_surface_object_list[objId].engineSurfaces[i] );
+
+    s_live_surface_object_count--;
+    s_object_surface_count -= s_surface_object_list[objId].surfaceCount;
+
     free( s_surface_object_list[objId].transform );
     free( s_surface_object_list[objId].libSurfaces );
     free( s_surface_object_list[objId].engineSurfaces );
@@ -310,7 +464,9 @@ void surface_object_update_transform( uint32_t objId, const struct SM64ObjectTra
     for( int i = 0; i < s_surface_object_list[objId].surfaceCount; ++i )
     {
         struct LoadedSurfaceObject *obj = &s_surface_object_list[objId];
+        grid_remove_surface( &obj->engineSurfaces[i] );
         engine_surface_from_lib_surface( &obj->engineSurfaces[i], &obj->libSurfaces[i], obj->transform );
+        grid_add_surface( &obj->engineSurfaces[i] );
     }
 }
 
@@ -322,6 +478,16 @@ struct SurfaceObjectTransform *surfaces_object_get_transform_ptr( uint32_t objId
     return s_surface_object_list[objId].transform;
 }
 
+uint32_t surfaces_count_objects( void )
+{
+    return s_live_surface_object_count;
+}
+
+uint32_t surfaces_count_total( void )
+{
+    return s_static_surface_count + s_object_surface_count;
+}
+
 void surfaces_unload_all( void )
 {
     free( s_static_surface_list );
@@ -334,4 +500,6 @@ void surfaces_unload_all( void )
     free( s_surface_object_list );
     s_surface_object_count = 0;
     s_surface_object_list = NULL;
+
+    grid_clear();
 }
@@ -3,13 +3,34 @@
 #include "decomp/include/types.h"
 #include "libsm64.h"
 
+// libsm64: Surfaces are bucketed into a uniform grid over the X/Y plane so collision queries
+// only visit nearby cells. The game maps are side-on tile maps, so unlike the original
+// game (which partitions X/Z) the vertical axis is the one worth splitting.
+// The grid wraps around, so cells far apart may share a bucket: entries keep their
+// unwrapped cell bounds, which queries use to skip aliases and visit each surface once.
+#define SURFACE_GRID_CELL_SHIFT 8
+#define SURFACE_GRID_SIZE 64
+#define SURFACE_GRID_CELL_COORD( x ) ((s32)(x) >> SURFACE_GRID_CELL_SHIFT)
+
+struct SurfaceGridEntry
+{
+    struct Surface *surf;
+    s32 minCellX, minCellY;
+    s32 maxCellX, maxCellY;
+};
+
 extern uint32_t loaded_surface_iter_group_count( void );
 extern uint32_t loaded_surface_iter_group_size( uint32_t groupIndex );
 extern struct Surface *loaded_surface_iter_get_at_index( uint32_t groupIndex, uint32_t surfaceIndex );
 
+extern struct SurfaceGridEntry *loaded_surface_grid_get_cell( s32 cellX, s32 cellY, uint32_t *outCount );
+extern bool loaded_surface_grid_get_row_range( s32 *outMinCellY, s32 *outMaxCellY );
+
 extern void surfaces_load_static( const struct SM64Surface *surfaceArray, uint32_t numSurfaces );
 extern uint32_t surfaces_load_object( const struct SM64SurfaceObject *surfaceObject );
 extern void surface_object_update_transform( uint32_t objId, const struct SM64ObjectTransform *newTransform );
 extern struct SurfaceObjectTransform *surfaces_object_get_transform_ptr( uint32_t objId );
+extern uint32_t surfaces_count_objects( void );
+extern uint32_t surfaces_count_total( void );
 extern void surfaces_unload_object( uint32_t objId );
 extern void surfaces_unload_all( void );
\ No newline at end of file
@@ -0,0 +1,244 @@
+// Micro-benchmark for the surface collision queries Mario runs every step.
+//
+// Builds a procedural DDRace-like tile map, loads the per-tile surface objects
+// that 64 Marios would stream in around themselves (same layout as
+// CMarioCore::addBlock / loadNewBlocks) and times find_floor, find_ceil and
+// find_wall_collisions with the linear surface scan and with the surface grid.
+// Both paths must return identical results; a mismatch fails the run.
+//
+// Build: cmake --build <dir> --target sm64_collision_bench
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "../src/libsm64.h"
+#include "../src/load_surfaces.h"
+#include "../src/decomp/include/surface_terrains.h"
+#include "../src/decomp/engine/surface_collision.h"
+
+#include "ns_clock.h"
+
+#define MAP_WIDTH 600
+#define MAP_HEIGHT 200
+#define NUM_MARIOS 64
+#define MAX_BLOCKS_PER_MARIO 128
+#define NUM_ITERATIONS 200
+#define TILE_SCALE 0.75f
+
+static uint8_t s_tiles[MAP_HEIGHT][MAP_WIDTH];
+static uint32_t s_rand_state = 0x12345678;
+
+static uint32_t bench_rand( void )
+{
+    s_rand_state ^= s_rand_state << 13;
+    s_rand_state ^= s_rand_state >> 17;
+    s_rand_state ^= s_rand_state << 5;
+    return s_rand_state;
+}
+
+static int is_solid( int x, int y )
+{
+    if( x < 0 || y < 0 || x >= MAP_WIDTH || y >= MAP_HEIGHT )
+        return 1;
+    return s_tiles[y][x];
+}
+
+static void generate_map( void )
+{
+    memset( s_tiles, 0, sizeof( s_tiles ));
+
+    for( int x = 0; x < MAP_WIDTH; ++x )
+    for( int y = MAP_HEIGHT - 4; y < MAP_HEIGHT; ++y )
+        s_tiles[y][x] = 1;
+
+    // platforms, pillars and ceilings like a typical race map
+    for( int i = 0; i < MAP_WIDTH * 2; ++i )
+    {
+        int w = 1 + bench_rand() % 12;
+        int h = 1 + bench_rand() % 4;
+        if( bench_rand() % 4 == 0 ) { int t = w; w = h; h = t * 2; }
+        int x0 = bench_rand() % MAP_WIDTH;
+        int y0 = bench_rand() % MAP_HEIGHT;
+        for( int y = y0; y < y0 + h && y < MAP_HEIGHT; ++y )
+        for( int x = x0; x < x0 + w && x < MAP_WIDTH; ++x )
+            s_tiles[y][x] = 1;
+    }
+}
+
+static void set_face( struct SM64Surface *surf, int v[3][3] )
+{
+    surf->type = SURFACE_DEFAULT;
+    surf->force = 0;
+    surf->terrain = TERRAIN_STONE;
+    memcpy( surf->vertices, v, sizeof( surf->vertices ));
+}
+
+// Mirrors CMarioCore::addBlock: one surface object per solid tile with only its exposed faces.
+static int add_block( int x, int y, int *count )
+{
+    if( *count >= MAX_BLOCKS_PER_MARIO ) return 0;
+    if( !is_solid( x, y )) return 0;
+
+    const int t = (int)( 32 / TILE_SCALE );
+    const int d = (int)( 64 / TILE_SCALE );
+    struct SM64Surface surfaces[8];
+    struct SM64SurfaceObject obj;
+    memset( &obj.transform, 0, sizeof( obj.transform ));
+    obj.transform.position[0] = x * 32 / TILE_SCALE;
+    obj.transform.position[1] = ( -y * 32 - 16 ) / TILE_SCALE;
+    obj.surfaceCount = 0;
+    obj.surfaces = surfaces;
+
+    if( !is_solid( x, y - 1 ))
+    {
+        int a[3][3] = {{ t, t, d }, { 0, t, -d }, { 0, t, d }};
+        int b[3][3] = {{ 0, t, -d }, { t, t, d }, { t, t, -d }};
+        set_face( &surfaces[obj.surfaceCount++], a );
+        set_face( &surfaces[obj.surfaceCount++], b );
+    }
+    if( !is_solid( x - 1, y ))
+    {
+        int a[3][3] = {{ 0, 0, -d }, { 0, t, d }, { 0, t, -d }};
+        int b[3][3] = {{ 0, t, d }, { 0, 0, -d }, { 0, 0, d }};
+        set_face( &surfaces[obj.surfaceCount++], a );
+        set_face( &surfaces[obj.surfaceCount++], b );
+    }
+    if( !is_solid( x + 1, y ))
+    {
+        int a[3][3] = {{ t, 0, d }, { t, t, -d }, { t, t, d }};
+        int b[3][3] = {{ t, t, -d }, { t, 0, d }, { t, 0, -d }};
+        set_face( &surfaces[obj.surfaceCount++], a );
+        set_face( &surfaces[obj.surfaceCount++], b );
+    }
+    if( !is_solid( x, y + 1 ))
+    {
+        int a[3][3] = {{ 0, 0, d }, { 0, 0, -d }, { t, 0, d }};
+        int b[3][3] = {{ t, 0, -d }, { t, 0, d }, { 0, 0, -d }};
+        set_face( &surfaces[obj.surfaceCount++], a );
+        set_face( &surfaces[obj.surfaceCount++], b );
+    }
+
+    if( obj.surfaceCount )
+    {
+        surfaces_load_object( &obj );
+        (*count)++;
+    }
+    return 1;
+}
+
+static void load_mario_window( int x, int y )
+{
+    int count = 0;
+    for( int xadd = -7; xadd <= 7; ++xadd )
+    {
+        for( int yadd = 0; y + yadd <= MAP_HEIGHT; ++yadd )
+            if( add_block( x + xadd, y + yadd, &count )) break;
+
+        for( int yadd = 6; yadd >= 0; --yadd )
+            add_block( x + xadd, y - yadd, &count );
+    }
+}
+
+static void load_static_floor( void )
+{
+    int width = MAP_WIDTH / 2 * 32 / TILE_SCALE;
+    int y = ( MAP_HEIGHT + 205 ) * 32 / -TILE_SCALE;
+    struct SM64Surface surfaces[2];
+    int a[3][3] = {{ width * 2 + 400 * 32, y, 128 }, { -400 * 32, y, -128 }, { -400 * 32, y, 128 }};
+    int b[3][3] = {{ -400 * 32, y, -128 }, { width * 2 + 400 * 32, y, 128 }, { width * 2 + 400 * 32, y, -128 }};
+    set_face( &surfaces[0], a );
+    set_face( &surfaces[1], b );
+    surfaces_load_static( surfaces, 2 );
+}
+
+struct QueryResult
+{
+    float floorHeight;
+    float ceilHeight;
+    float wallX[2];
+    float wallZ[2];
+    int numWalls[2];
+};
+
+static float s_mario_pos[NUM_MARIOS][2];
+
+static uint64_t run_queries( struct QueryResult *results )
+{
+    uint64_t start = ns_clock();
+
+    for( int it = 0; it < NUM_ITERATIONS; ++it )
+    for( int i = 0; i < NUM_MARIOS; ++i )
+    {
+        struct Surface *surf;
+        struct QueryResult *res = &results[i];
+        float x = s_mario_pos[i][0] + ( it % 16 ) * 4.0f;
+        float y = s_mario_pos[i][1];
+
+        // same query mix as one step of perform_ground_step / perform_air_step
+        for( int w = 0; w < 2; ++w )
+        {
+            struct WallCollisionData data;
+            data.x = x;
+            data.y = y;
+            data.z = 0.0f;
+            data.offsetY = w ? 60.0f : 30.0f;
+            data.radius = w ? 50.0f : 24.0f;
+            res->numWalls[w] = find_wall_collisions( &data );
+            res->wallX[w] = data.x;
+            res->wallZ[w] = data.z;
+        }
+        res->ceilHeight = find_ceil( x, y + 80.0f, 0.0f, &surf );
+        res->floorHeight = find_floor( x, y + 100.0f, 0.0f, &surf );
+    }
+
+    return ns_clock() - start;
+}
+
+int main( void )
+{
+    generate_map();
+    load_static_floor();
+
+    for( int i = 0; i < NUM_MARIOS; ++i )
+    {
+        int tx, ty;
+        do
+        {
+            tx = 8 + bench_rand() % ( MAP_WIDTH - 16 );
+            ty = 8 + bench_rand() % ( MAP_HEIGHT - 16 );
+        }
+        while( is_solid( tx, ty ));
+
+        load_mario_window( tx, ty );
+        s_mario_pos[i][0] = ( tx * 32 + 16 ) / TILE_SCALE;
+        s_mario_pos[i][1] = ( -ty * 32 - 16 ) / TILE_SCALE;
+    }
+
+    uint32_t surfaceCount = 0;
+    for( uint32_t i = 0; i < loaded_surface_iter_group_count(); ++i )
+        surfaceCount += loaded_surface_iter_group_size( i );
+
+    static struct QueryResult linearResults[NUM_MARIOS], gridResults[NUM_MARIOS];
+
+    surface_collision_set_use_grid( 0 );
+    uint64_t linearNs = run_queries( linearResults );
+    surface_collision_set_use_grid( 1 );
+    uint64_t gridNs = run_queries( gridResults );
+
+    int mismatches = 0;
+    for( int i = 0; i < NUM_MARIOS; ++i )
+        if( memcmp( &linearResults[i], &gridResults[i], sizeof( struct QueryResult )) != 0 )
+            mismatches++;
+
+    const double queries = (double)NUM_ITERATIONS * NUM_MARIOS * 4;
+    printf( "%d marios, %u surface groups, %u surfaces\n", NUM_MARIOS, loaded_surface_iter_group_count(), surfaceCount );
+    printf( "linear: %8.1f ns/query\n", linearNs / queries );
+    printf( "grid:   %8.1f ns/query (%.1fx)\n", gridNs / queries, (double)linearNs / gridNs );
+    printf( "mismatches: %d\n", mismatches );
+
+    surfaces_unload_all();
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+// Checks the surface grid against the linear surface scan for surfaces further from
+// Mario than the grid is tall, where rows of the walk wrap onto the same buckets.
+//
+// Build: cmake --build <dir> --target sm64_collision_test
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/libsm64.h"
+#include "../src/load_surfaces.h"
+#include "../src/decomp/include/surface_terrains.h"
+#include "../src/decomp/engine/surface_collision.h"
+
+// more than the SURFACE_GRID_SIZE rows the grid wraps around after
+#define FAR_DISTANCE 20000
+
+static int s_failures = 0;
+
+static void set_quad( struct SM64Surface *surfaces, int x0, int x1, int y, int facingUp )
+{
+    int a[3][3] = {{ x1, y, 128 }, { x0, y, -128 }, { x0, y, 128 }};
+    int b[3][3] = {{ x0, y, -128 }, { x1, y, 128 }, { x1, y, -128 }};
+    for( int i = 0; i < 2; ++i )
+    {
+        surfaces[i].type = SURFACE_DEFAULT;
+        surfaces[i].force = 0;
+        surfaces[i].terrain = TERRAIN_STONE;
+        memcpy( surfaces[i].vertices, i ? b : a, sizeof( a ));
+        if( !facingUp )
+        {
+            // swapping two vertices flips the normal
+            memcpy( surfaces[i].vertices[1], i ? b[2] : a[2], sizeof( a[0] ));
+            memcpy( surfaces[i].vertices[2], i ? b[1] : a[1], sizeof( a[0] ));
+        }
+    }
+}
+
+static void expect_height( const char *name, float height, float expected )
+{
+    if( height != expected )
+    {
+        printf( "%s: got %.1f, expected %.1f\n", name, height, expected );
+        s_failures++;
+    }
+}
+
+static void check_queries( const char *path, float x, float y, float expectedFloor, float expectedCeil )
+{
+    struct Surface *surf;
+    char name[64];
+
+    snprintf( name, sizeof( name ), "%s floor at x=%.0f", path, x );
+    expect_height( name, find_floor( x, y, 0.0f, &surf ), expectedFloor );
+    snprintf( name, sizeof( name ), "%s ceil at x=%.0f", path, x );
+    expect_height( name, find_ceil( x, y, 0.0f, &surf ), expectedCeil );
+}
+
+int main( void )
+{
+    struct SM64Surface surfaces[8];
+
+    // far floor and ceiling under and over x in [0, 512)
+    set_quad( &surfaces[0], 0, 512, -FAR_DISTANCE, 1 );
+    set_quad( &surfaces[2], 0, 512, FAR_DISTANCE, 0 );
+    // near floor and ceiling over x in [2048, 2560), exactly SURFACE_GRID_SIZE rows away from the far
+    // ones so they share their buckets, but in a different column
+    set_quad( &surfaces[4], 2048, 2560, -FAR_DISTANCE + ( SURFACE_GRID_SIZE << SURFACE_GRID_CELL_SHIFT ), 1 );
+    set_quad( &surfaces[6], 2048, 2560, FAR_DISTANCE - ( SURFACE_GRID_SIZE << SURFACE_GRID_CELL_SHIFT ), 0 );
+    surfaces_load_static( surfaces, 8 );
+
+    const float nearFloor = -FAR_DISTANCE + ( SURFACE_GRID_SIZE << SURFACE_GRID_CELL_SHIFT );
+    const float nearCeil = FAR_DISTANCE - ( SURFACE_GRID_SIZE << SURFACE_GRID_CELL_SHIFT );
+
+    for( int useGrid = 0; useGrid <= 1; ++useGrid )
+    {
+        const char *path = useGrid ? "grid" : "linear";
+        surface_collision_set_use_grid( useGrid );
+        check_queries( path, 256.0f, 0.0f, -FAR_DISTANCE, FAR_DISTANCE );
+        check_queries( path, 2304.0f, 0.0f, nearFloor, nearCeil );
+        // no surfaces over or under this column at all
+        check_queries( path, 1280.0f, 0.0f, FLOOR_LOWER_LIMIT, CELL_HEIGHT_LIMIT );
+    }
+
+    surfaces_unload_all();
+
+    printf( s_failures ? "%d failures\n" : "all passed\n", s_failures );
+    return s_failures == 0 ? 0 : 1;
+}
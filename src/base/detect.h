@@ -177,6 +177,12 @@
 #define CONF_ARCH_ENDIAN_LITTLE 1
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONF_SIMD_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CONF_SIMD_NEON 1
+#endif
+
 #ifndef CONF_FAMILY_STRING
 #define CONF_FAMILY_STRING "unknown"
 #endif
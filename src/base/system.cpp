@@ -152,6 +152,30 @@ void net_buffer_init(NETSOCKET_BUFFER *buffer);
 void net_buffer_reinit(NETSOCKET_BUFFER *buffer);
 void net_buffer_simple(NETSOCKET_BUFFER *buffer, char **buf, int *size);
 
+#ifdef CONF_PLATFORM_LINUX
+/* datagrams for one address family, sent with a single sendmmsg */
+typedef struct
+{
+	int count;
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	char sockaddrs[VLEN][128];
+} NETSOCKET_SEND_BATCH;
+
+typedef struct
+{
+	int active;
+	NETSOCKET_SEND_BATCH ipv4;
+	NETSOCKET_SEND_BATCH ipv6;
+} NETSOCKET_SEND_QUEUE;
+#else
+typedef struct
+{
+	int active;
+} NETSOCKET_SEND_QUEUE;
+#endif
+
 struct NETSOCKET_INTERNAL
 {
 	int type;
@@ -160,6 +184,7 @@ struct NETSOCKET_INTERNAL
 	int web_ipv4sock;
 
 	NETSOCKET_BUFFER buffer;
+	NETSOCKET_SEND_QUEUE *send_queue;
 };
 static NETSOCKET_INTERNAL invalid_socket = {NETTYPE_INVALID, -1, -1, -1};
 
@@ -1423,6 +1448,7 @@ static int priv_net_close_all_sockets(NETSOCKET sock)
 		sock->type &= ~NETTYPE_IPV6;
 	}
 
+	free(sock->send_queue);
 	free(sock);
 	return 0;
 }
@@ -1595,6 +1621,44 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static void priv_net_send_batch_flush(int fd, NETSOCKET_SEND_BATCH *batch)
+{
+	int pos = 0;
+	while(pos < batch->count)
+	{
+		int sent = sendmmsg(fd, batch->msgs + pos, batch->count - pos, 0);
+		network_stats.send_syscalls++;
+		/* skip a datagram that failed like a failed sendto would */
+		pos += sent > 0 ? sent : 1;
+	}
+	batch->count = 0;
+}
+#endif
+
+static int priv_net_udp_sendto(NETSOCKET sock, int fd, const void *data, int size, const struct sockaddr *sa, int sa_len)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_queue && sock->send_queue->active)
+	{
+		NETSOCKET_SEND_BATCH *batch = fd == sock->ipv4sock ? &sock->send_queue->ipv4 : &sock->send_queue->ipv6;
+		if(batch->count == VLEN || (size > PACKETSIZE && batch->count > 0))
+			priv_net_send_batch_flush(fd, batch);
+		if(size <= PACKETSIZE)
+		{
+			int i = batch->count++;
+			mem_copy(batch->bufs[i], data, size);
+			mem_copy(batch->sockaddrs[i], sa, sa_len);
+			batch->iovecs[i].iov_len = size;
+			batch->msgs[i].msg_hdr.msg_namelen = sa_len;
+			return size;
+		}
+	}
+#endif
+	network_stats.send_syscalls++;
+	return sendto(fd, (const char *)data, size, 0, sa, sa_len);
+}
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
@@ -1614,7 +1678,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 			else
 				netaddr_to_sockaddr_in(addr, &sa);
 
-			d = sendto((int)sock->ipv4sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			d = priv_net_udp_sendto(sock, sock->ipv4sock, data, size, (struct sockaddr *)&sa, sizeof(sa));
 		}
 		else
 			dbg_msg("net", "can't send ipv4 traffic to this socket");
@@ -1652,7 +1716,7 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 			else
 				netaddr_to_sockaddr_in6(addr, &sa);
 
-			d = sendto((int)sock->ipv6sock, (const char *)data, size, 0, (struct sockaddr *)&sa, sizeof(sa));
+			d = priv_net_udp_sendto(sock, sock->ipv6sock, data, size, (struct sockaddr *)&sa, sizeof(sa));
 		}
 		else
 			dbg_msg("net", "can't send ipv6 traffic to this socket");
@@ -1678,6 +1742,46 @@ int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size
 	return d;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static void priv_net_send_batch_init(NETSOCKET_SEND_BATCH *batch)
+{
+	mem_zero(batch, sizeof(*batch));
+	for(int i = 0; i < VLEN; ++i)
+	{
+		batch->iovecs[i].iov_base = batch->bufs[i];
+		batch->msgs[i].msg_hdr.msg_iov = &(batch->iovecs[i]);
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+		batch->msgs[i].msg_hdr.msg_name = &(batch->sockaddrs[i]);
+	}
+}
+#endif
+
+void net_udp_batch_begin(NETSOCKET sock)
+{
+	if(!sock->send_queue)
+	{
+		sock->send_queue = (NETSOCKET_SEND_QUEUE *)malloc(sizeof(*sock->send_queue));
+#if defined(CONF_PLATFORM_LINUX)
+		priv_net_send_batch_init(&sock->send_queue->ipv4);
+		priv_net_send_batch_init(&sock->send_queue->ipv6);
+#endif
+	}
+	sock->send_queue->active = 1;
+}
+
+void net_udp_batch_end(NETSOCKET sock)
+{
+	if(!sock->send_queue || !sock->send_queue->active)
+		return;
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock->send_queue->ipv4.count > 0)
+		priv_net_send_batch_flush(sock->ipv4sock, &sock->send_queue->ipv4);
+	if(sock->send_queue->ipv6.count > 0)
+		priv_net_send_batch_flush(sock->ipv6sock, &sock->send_queue->ipv6);
+#endif
+	sock->send_queue->active = 0;
+}
+
 void net_buffer_init(NETSOCKET_BUFFER *buffer)
 {
 #if defined(CONF_PLATFORM_LINUX)
@@ -1733,6 +1837,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv4sock, sock->buffer.msgs, VLEN, 0, NULL);
 			sock->buffer.pos = 0;
+			network_stats.recv_syscalls++;
 		}
 	}
 
@@ -1743,6 +1848,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 			net_buffer_reinit(&sock->buffer);
 			sock->buffer.size = recvmmsg(sock->ipv6sock, sock->buffer.msgs, VLEN, 0, NULL);
 			sock->buffer.pos = 0;
+			network_stats.recv_syscalls++;
 		}
 	}
 
@@ -1762,6 +1868,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		socklen_t fromlen = sizeof(struct sockaddr_in);
 		bytes = recvfrom(sock->ipv4sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
 		*data = (unsigned char *)sock->buffer.buf;
+		network_stats.recv_syscalls++;
 	}
 
 	if(bytes <= 0 && sock->ipv6sock >= 0)
@@ -1769,6 +1876,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 		socklen_t fromlen = sizeof(struct sockaddr_in6);
 		bytes = recvfrom(sock->ipv6sock, sock->buffer.buf, sizeof(sock->buffer.buf), 0, (struct sockaddr *)&sockaddrbuf, &fromlen);
 		*data = (unsigned char *)sock->buffer.buf;
+		network_stats.recv_syscalls++;
 	}
 #endif
 
@@ -1800,6 +1908,7 @@ int net_udp_recv(NETSOCKET sock, NETADDR *addr, unsigned char **data)
 
 int net_udp_close(NETSOCKET sock)
 {
+	net_udp_batch_end(sock);
 	return priv_net_close_all_sockets(sock);
 }
 
@@ -970,6 +970,31 @@ NETSOCKET net_udp_create(NETADDR bindaddr);
  */
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size);
 
+/**
+ * Starts queueing the packets sent over an UDP socket instead of sending
+ * each one right away.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to queue the packets of.
+ *
+ * @remark Until @link net_udp_batch_end @endlink is called, @link net_udp_send @endlink
+ * returns the packet size without knowing whether sending it will succeed.
+ * @remark Only Linux queues packets, other platforms keep sending them
+ * one by one.
+ */
+void net_udp_batch_begin(NETSOCKET sock);
+
+/**
+ * Sends the packets queued since @link net_udp_batch_begin @endlink with as
+ * few system calls as possible and stops queueing.
+ *
+ * @ingroup Network-UDP
+ *
+ * @param sock Socket to send the packets of.
+ */
+void net_udp_batch_end(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
@@ -2022,6 +2047,8 @@ typedef struct
 	uint64_t sent_bytes;
 	uint64_t recv_packets;
 	uint64_t recv_bytes;
+	uint64_t send_syscalls;
+	uint64_t recv_syscalls;
 } NETSTATS;
 
 void net_stats(NETSTATS *stats);
@@ -1134,9 +1134,9 @@ bool CCommandProcessorFragment_OpenGL::RunCommand(const CCommandBuffer::SCommand
 	case CCommandBuffer::CMD_RENDER_QUAD_CONTAINER_EX: Cmd_RenderQuadContainerEx(static_cast<const CCommandBuffer::SCommand_RenderQuadContainerEx *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_RENDER_QUAD_CONTAINER_SPRITE_MULTIPLE: Cmd_RenderQuadContainerAsSpriteMultiple(static_cast<const CCommandBuffer::SCommand_RenderQuadContainerAsSpriteMultiple *>(pBaseCommand)); break;
 	case CCommandBuffer::CMD_MARIO_FIRST_INIT: Cmd_FirstInitMario(static_cast<const CCommandBuffer::SCommand_FirstInitMario *>(pBaseCommand)); break;
-	case CCommandBuffer::CMD_MARIO_INIT: Cmd_InitMario(static_cast<const CCommandBuffer::SCommand_InitMario *>(pBaseCommand)); break;
-	case CCommandBuffer::CMD_MARIO_DESTROY: Cmd_DestroyMario(static_cast<const CCommandBuffer::SCommand_DestroyMario *>(pBaseCommand)); break;
-	case CCommandBuffer::CMD_MARIO_UPDATE_AND_RENDER: Cmd_UpdateAndRenderMario(static_cast<const CCommandBuffer::SCommand_UpdateAndRenderMario *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_MARIO_RENDER: Cmd_RenderMarios(static_cast<const CCommandBuffer::SCommand_RenderMarios *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_MARIO_UPLOAD_BIND_POSE: Cmd_UploadMarioBindPose(static_cast<const CCommandBuffer::SCommand_UploadMarioBindPose *>(pBaseCommand)); break;
+	case CCommandBuffer::CMD_MARIO_RENDER_POSES: Cmd_RenderMarioPoses(static_cast<const CCommandBuffer::SCommand_RenderMarioPoses *>(pBaseCommand)); break;
 	default: return false;
 	}
 
@@ -2343,11 +2343,12 @@ void CCommandProcessorFragment_OpenGL2::Cmd_RenderTileLayer(const CCommandBuffer
 
 // mario
 
-GLuint shader_compile( const char *shaderContents, size_t shaderContentsLength, GLenum shaderType )
+GLuint shader_compile( const char *shaderContents, size_t shaderContentsLength, GLenum shaderType, int version = 130, const char *defines = "" )
 {
-    const GLchar *shaderDefine = shaderType == GL_VERTEX_SHADER 
-        ? "\n#version 130\n#define VERTEX  \n#define v2f out\n" 
-        : "\n#version 130\n#define FRAGMENT\n#define v2f in \n";
+    char shaderDefine[256];
+    str_format( shaderDefine, sizeof( shaderDefine ), shaderType == GL_VERTEX_SHADER
+        ? "\n#version %d\n#define VERTEX  \n#define v2f out\n%s"
+        : "\n#version %d\n#define FRAGMENT\n#define v2f in \n%s", version, defines );
 
     const GLchar *shaderStrings[2] = { shaderDefine, shaderContents };
     GLint shaderStringLengths[2] = { (GLint)strlen( shaderDefine ), (GLint)shaderContentsLength };
@@ -2373,6 +2374,24 @@ GLuint shader_compile( const char *shaderContents, size_t shaderContentsLength,
     return shader;
 }
 
+static GLuint mario_program_link(const char *shaderCode, int version, const char *defines)
+{
+	GLuint vert = shader_compile(shaderCode, strlen(shaderCode), GL_VERTEX_SHADER, version, defines);
+	GLuint frag = shader_compile(shaderCode, strlen(shaderCode), GL_FRAGMENT_SHADER, version, defines);
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vert);
+	glAttachShader(program, frag);
+
+	const GLchar *attribs[] = {"position", "normal", "color", "uv", "part"};
+	for (int i=6; i<11; i++) glBindAttribLocation(program, i, attribs[i-6]);
+
+	glLinkProgram(program);
+	glDetachShader(program, vert);
+	glDetachShader(program, frag);
+	return program;
+}
+
 void CCommandProcessorFragment_OpenGL2::Cmd_FirstInitMario(const CCommandBuffer::SCommand_FirstInitMario *pCommand)
 {
 	uint32_t *shader = pCommand->m_ShaderHandle;
@@ -2380,19 +2399,93 @@ void CCommandProcessorFragment_OpenGL2::Cmd_FirstInitMario(const CCommandBuffer:
 	uint8_t *marioTexture = pCommand->m_Texture;
 	const char *shaderCode = pCommand->m_ShaderCode;
 
-	GLuint vert = shader_compile(shaderCode, strlen(shaderCode), GL_VERTEX_SHADER);
-	GLuint frag = shader_compile(shaderCode, strlen(shaderCode), GL_FRAGMENT_SHADER);
-
-	*shader = glCreateProgram();
-	glAttachShader(*shader, vert);
-	glAttachShader(*shader, frag);
+	*shader = mario_program_link(shaderCode, 130, "");
+
+	m_MarioViewLocation = glGetUniformLocation(*shader, "view");
+	m_MarioProjectionLocation = glGetUniformLocation(*shader, "projection");
+	m_MarioTextureLocation = glGetUniformLocation(*shader, "marioTex");
+	m_MarioWingCapLocation = glGetUniformLocation(*shader, "wingCap");
+	m_MarioMetalCapLocation = glGetUniformLocation(*shader, "metalCap");
+	m_MarioModelLocation = glGetUniformLocation(*shader, "model");
+	m_MarioNormalMatrixLocation = glGetUniformLocation(*shader, "normalMatrix");
+	m_MarioCustomColorsLocation = glGetUniformLocation(*shader, "customColors");
+	m_MarioBodyColorLocation = glGetUniformLocation(*shader, "bodyColor");
+	m_MarioFeetColorLocation = glGetUniformLocation(*shader, "feetColor");
+
+	// interleaved vertices, see GL_SMarioVertex
+	glGenVertexArrays(1, &m_MarioVertexArray);
+	glBindVertexArray(m_MarioVertexArray);
+	glGenBuffers(1, &m_MarioRingBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_MarioRingBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GL_SMarioVertex) * MARIO_RING_VERTICES, NULL, GL_STREAM_DRAW);
+	m_MarioRingOffset = 0;
+	auto &&SetMarioVertexAttribs = []() {
+		glEnableVertexAttribArray(6);
+		glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(GL_SMarioVertex), (void *)offsetof(GL_SMarioVertex, m_Pos));
+		glEnableVertexAttribArray(7);
+		glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(GL_SMarioVertex), (void *)offsetof(GL_SMarioVertex, m_Normal));
+		glEnableVertexAttribArray(8);
+		glVertexAttribPointer(8, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GL_SMarioVertex), (void *)offsetof(GL_SMarioVertex, m_Color));
+		glEnableVertexAttribArray(9);
+		glVertexAttribPointer(9, 2, GL_FLOAT, GL_FALSE, sizeof(GL_SMarioVertex), (void *)offsetof(GL_SMarioVertex, m_Tex));
+	};
+	SetMarioVertexAttribs();
+
+	// the bind pose for GPU skinning, with room for all of it since it only grows
+	glGenVertexArrays(1, &m_MarioBindPoseVertexArray);
+	glBindVertexArray(m_MarioBindPoseVertexArray);
+	glGenBuffers(1, &m_MarioBindPoseBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_MarioBindPoseBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GL_SMarioVertex) * 3 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES, NULL, GL_STATIC_DRAW);
+	SetMarioVertexAttribs();
+	m_MarioBindPoseVertices = 0;
+
+	// the part of each bind pose vertex, for the instanced draws
+	m_vMarioBindPoseParts.assign(3 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES, MARIO_NO_PART);
+	m_NumMarioBindPoseParts = 0;
+	glGenBuffers(1, &m_MarioBindPosePartBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_MarioBindPosePartBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(uint16_t) * m_vMarioBindPoseParts.size(), m_vMarioBindPoseParts.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(10);
+	glVertexAttribPointer(10, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(uint16_t), (void *)0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	const GLchar *attribs[] = {"position", "normal", "color", "uv"};
-	for (int i=6; i<10; i++) glBindAttribLocation(*shader, i, attribs[i-6]);
+	// the instanced draws need uniform buffers and gl_InstanceID, without them every part is its own draw
+	m_MarioPoseProgram = 0;
+#ifndef BACKEND_AS_OPENGL_ES
+	if(GLEW_VERSION_3_1)
+	{
+		GLint MaxBlockSize = 0;
+		glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &MaxBlockSize);
+		m_MarioPoseMaxVec4s = minimum(MaxBlockSize, 64 * 1024) / 16;
+
+		char aDefines[128];
+		str_format(aDefines, sizeof(aDefines), "#define POSE_BATCH\n#define POSE_VEC4S %d\n", m_MarioPoseMaxVec4s);
+		m_MarioPoseProgram = mario_program_link(shaderCode, 140, aDefines);
+		GLint Linked = GL_FALSE;
+		glGetProgramiv(m_MarioPoseProgram, GL_LINK_STATUS, &Linked);
+		if(Linked == GL_FALSE)
+		{
+			dbg_msg("libsm64", "posed Marios are drawn part by part, the instanced shader failed to link");
+			glDeleteProgram(m_MarioPoseProgram);
+			m_MarioPoseProgram = 0;
+		}
+	}
+#endif
+	if(m_MarioPoseProgram != 0)
+	{
+		m_MarioPoseViewLocation = glGetUniformLocation(m_MarioPoseProgram, "view");
+		m_MarioPoseProjectionLocation = glGetUniformLocation(m_MarioPoseProgram, "projection");
+		m_MarioPoseTextureLocation = glGetUniformLocation(m_MarioPoseProgram, "marioTex");
+		m_MarioPoseNumPartsLocation = glGetUniformLocation(m_MarioPoseProgram, "numParts");
+		glUniformBlockBinding(m_MarioPoseProgram, glGetUniformBlockIndex(m_MarioPoseProgram, "MarioPoses"), 0);
 
-	glLinkProgram(*shader);
-	glDetachShader(*shader, vert);
-	glDetachShader(*shader, frag);
+		glGenBuffers(1, &m_MarioPoseUniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_MarioPoseUniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(float) * 4 * m_MarioPoseMaxVec4s, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
 
 	// initialize texture
 	glGenTextures(1, texture);
@@ -2406,96 +2499,231 @@ void CCommandProcessorFragment_OpenGL2::Cmd_FirstInitMario(const CCommandBuffer:
 	//dbg_msg("libsm64", "texture & shader: %d %d", *texture, *shader);
 }
 
-void CCommandProcessorFragment_OpenGL2::Cmd_InitMario(const CCommandBuffer::SCommand_InitMario *pCommand)
+void CCommandProcessorFragment_OpenGL2::Cmd_RenderMarios(const CCommandBuffer::SCommand_RenderMarios *pCommand)
 {
-	CMarioMesh *mesh = pCommand->m_Mesh;
-	SM64MarioGeometryBuffers *geometry = pCommand->m_Geometry;
-
-	glGenVertexArrays( 1, &mesh->vao );
-	glBindVertexArray( mesh->vao );
+	const CCommandBuffer::SState &State = pCommand->m_State;
+	uint32_t *shader = pCommand->m_ShaderHandle;
+	uint32_t *texture = pCommand->m_TextureHandle;
 
-	#define X( loc, buff, arr, type ) do { \
-		glGenBuffers( 1, &buff ); \
-		glBindBuffer( GL_ARRAY_BUFFER, buff ); \
-		glBufferData( GL_ARRAY_BUFFER, sizeof( type ) * 3 * SM64_GEO_MAX_TRIANGLES, arr, GL_DYNAMIC_DRAW ); \
-		glEnableVertexAttribArray( loc ); \
-		glVertexAttribPointer( loc, sizeof( type ) / sizeof( float ), GL_FLOAT, GL_FALSE, sizeof( type ), NULL ); \
-	} while( 0 )
+	// upload all Marios at once, nothing after the ring offset is used by the GPU since the last orphaning
+	const int NumVertices = pCommand->m_NumVertices;
+	glBindBuffer(GL_ARRAY_BUFFER, m_MarioRingBuffer);
+	if(m_MarioRingOffset + NumVertices > MARIO_RING_VERTICES)
+	{
+		glBufferData(GL_ARRAY_BUFFER, sizeof(GL_SMarioVertex) * MARIO_RING_VERTICES, NULL, GL_STREAM_DRAW);
+		m_MarioRingOffset = 0;
+	}
+	void *pMapped = glMapBufferRange(GL_ARRAY_BUFFER, sizeof(GL_SMarioVertex) * m_MarioRingOffset, sizeof(GL_SMarioVertex) * NumVertices, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if(pMapped)
+	{
+		mem_copy(pMapped, pCommand->m_pVertices, sizeof(GL_SMarioVertex) * NumVertices);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	const int FirstVertex = m_MarioRingOffset;
+	m_MarioRingOffset += NumVertices;
+	if(!pMapped)
+		return;
 
-		X( 6, mesh->position_buffer, geometry->position,     VEC3 );
-		X( 7, mesh->normal_buffer,   geometry->normal,       VEC3 );
-		X( 8, mesh->color_buffer,    geometry->color,        VEC3 );
-		X( 9, mesh->uv_buffer,       geometry->uv,           VEC2 );
+	BeginMarioDraw(State, shader, texture, false);
+	glBindVertexArray(m_MarioVertexArray);
 
-	#undef X
+	int MetalCap = -1;
+	for(int i = 0; i < pCommand->m_NumDraws; i++)
+	{
+		const CCommandBuffer::SMarioDraw &Draw = pCommand->m_pDraws[i];
+		const int First = FirstVertex + Draw.m_FirstVertex;
+		int Count = Draw.m_NumVertices;
+		if(Draw.m_CapFlag & MARIO_WING_CAP)
+		{
+			// skip the white rectangles from the wings (hacky solution because glBlend stuff does nothing)
+			Count -= 24;
+			glUniform1i(m_MarioWingCapLocation, 1);
+			glDrawArrays(GL_TRIANGLES, First + Count, 24);
+			glUniform1i(m_MarioWingCapLocation, 0);
+		}
+		const int WantedMetalCap = (Draw.m_CapFlag & MARIO_METAL_CAP) ? 1 : 0;
+		if(WantedMetalCap != MetalCap)
+		{
+			glUniform1i(m_MarioMetalCapLocation, WantedMetalCap);
+			MetalCap = WantedMetalCap;
+		}
+		glDrawArrays(GL_TRIANGLES, First, Count);
+	}
 
+	glUseProgram(0);
 	glBindVertexArray(0);
+
+	glDisable(GL_DEPTH_TEST);
 }
 
-void CCommandProcessorFragment_OpenGL2::Cmd_DestroyMario(const CCommandBuffer::SCommand_DestroyMario *pCommand)
+void CCommandProcessorFragment_OpenGL2::BeginMarioDraw(const CCommandBuffer::SState &State, uint32_t *pShader, uint32_t *pTexture, bool Instanced)
 {
-	CMarioMesh *mesh = pCommand->m_Mesh;
+	// the screen mapping of the state, with the depth range widened to avoid mario model from getting clipped
+	const float Left = State.m_ScreenTL.x, Right = State.m_ScreenBR.x;
+	const float Bottom = State.m_ScreenBR.y, Top = State.m_ScreenTL.y;
+	const float nearZ = -1000.f, farZ = 10000.f;
+	const GLfloat projection[16] = {
+		2.0f / (Right - Left), 0, 0, 0,
+		0, 2.0f / (Top - Bottom), 0, 0,
+		0, 0, -2.0f / (farZ - nearZ), 0,
+		-(Right + Left) / (Right - Left), -(Top + Bottom) / (Top - Bottom), -(farZ + nearZ) / (farZ - nearZ), 1};
+	const GLfloat view[16] = {
+		1, 0, 0, 0,
+		0, 1, 0, 0,
+		0, 0, 1, 0,
+		0, 0, 0, 1};
 
-	glDeleteVertexArrays(1, &mesh->vao);
-	glDeleteBuffers(1, &mesh->position_buffer);
-	glDeleteBuffers(1, &mesh->normal_buffer);
-	glDeleteBuffers(1, &mesh->color_buffer);
-	glDeleteBuffers(1, &mesh->uv_buffer);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, *pTexture);
+	if(Instanced)
+	{
+		glUseProgram(m_MarioPoseProgram);
+		glUniformMatrix4fv(m_MarioPoseViewLocation, 1, GL_FALSE, view);
+		glUniformMatrix4fv(m_MarioPoseProjectionLocation, 1, GL_FALSE, projection);
+		glUniform1i(m_MarioPoseTextureLocation, 0);
+		return;
+	}
+
+	glUseProgram(*pShader);
+	glUniformMatrix4fv(m_MarioViewLocation, 1, GL_FALSE, view);
+	glUniformMatrix4fv(m_MarioProjectionLocation, 1, GL_FALSE, projection);
+	glUniform1i(m_MarioTextureLocation, 0);
+	glUniform1i(m_MarioWingCapLocation, 0);
+
+	// the streamed vertices are in world space already
+	glUniformMatrix4fv(m_MarioModelLocation, 1, GL_FALSE, view);
+	const GLfloat identity3[9] = {
+		1, 0, 0,
+		0, 1, 0,
+		0, 0, 1};
+	glUniformMatrix3fv(m_MarioNormalMatrixLocation, 1, GL_FALSE, identity3);
+	glUniform1i(m_MarioCustomColorsLocation, 0);
 }
 
-void CCommandProcessorFragment_OpenGL2::Cmd_UpdateAndRenderMario(const CCommandBuffer::SCommand_UpdateAndRenderMario *pCommand)
+void CCommandProcessorFragment_OpenGL2::Cmd_UploadMarioBindPose(const CCommandBuffer::SCommand_UploadMarioBindPose *pCommand)
 {
-	CMarioMesh *mesh = pCommand->m_Mesh;
-	SM64MarioGeometryBuffers *geometry = pCommand->m_Geometry;
-	uint32_t cap = pCommand->m_CapFlag;
-	uint32_t *shader = pCommand->m_ShaderHandle;
-	uint32_t *texture = pCommand->m_TextureHandle;
-	uint16_t *indices = pCommand->m_Indices;
-
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->position_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VEC3) * 3 * SM64_GEO_MAX_TRIANGLES, geometry->position, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->normal_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VEC3) * 3 * SM64_GEO_MAX_TRIANGLES, geometry->normal, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->color_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VEC3) * 3 * SM64_GEO_MAX_TRIANGLES, geometry->color, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, mesh->uv_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VEC2) * 3 * SM64_GEO_MAX_TRIANGLES, geometry->uv, GL_DYNAMIC_DRAW);
+	if(pCommand->m_FirstVertex + pCommand->m_NumVertices > 3 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES)
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_MarioBindPoseBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, sizeof(GL_SMarioVertex) * pCommand->m_FirstVertex, sizeof(GL_SMarioVertex) * pCommand->m_NumVertices, pCommand->m_pVertices);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_MarioBindPoseVertices = maximum(m_MarioBindPoseVertices, pCommand->m_FirstVertex + pCommand->m_NumVertices);
+}
 
-	GLfloat view[16], projection[16];
-	glGetFloatv(GL_PROJECTION_MATRIX, projection);
-	glGetFloatv(GL_MODELVIEW_MATRIX, view);
+bool CCommandProcessorFragment_OpenGL2::RenderMarioPosesInstanced(const CCommandBuffer::SCommand_RenderMarioPoses *pCommand)
+{
+	// the parts drawn for the first time get their index
+	for(int p = 0; p < pCommand->m_NumParts; p++)
+	{
+		const CCommandBuffer::SMarioPartDraw &Part = pCommand->m_pParts[p];
+		if(Part.m_FirstVertex + Part.m_NumVertices > m_MarioBindPoseVertices || m_vMarioBindPoseParts[Part.m_FirstVertex] != MARIO_NO_PART)
+			continue;
+		std::fill_n(m_vMarioBindPoseParts.begin() + Part.m_FirstVertex, Part.m_NumVertices, (uint16_t)m_NumMarioBindPoseParts++);
+		glBindBuffer(GL_ARRAY_BUFFER, m_MarioBindPosePartBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(uint16_t) * Part.m_FirstVertex, sizeof(uint16_t) * Part.m_NumVertices, m_vMarioBindPoseParts.data() + Part.m_FirstVertex);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
-	// adjust farZ and nearZ in projection matrix to avoid mario model from getting clipped
-	float nearZ = -1000.f, farZ = 10000.f;
-	float fan = farZ + nearZ;
-	float fsn = farZ - nearZ;
-	projection[10] = -2.0f / fsn;
-	projection[14] = -fan / fsn;
+	// per Mario: his caps and colors in 3 vec4, then the transform of every part of the bind pose
+	const int MarioVec4s = 3 + 4 * m_NumMarioBindPoseParts;
+	const int MaxMarios = m_MarioPoseMaxVec4s / MarioVec4s;
+	if(MaxMarios == 0)
+		return false;
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthMask(GL_TRUE);
+	BeginMarioDraw(pCommand->m_State, pCommand->m_ShaderHandle, pCommand->m_TextureHandle, true);
+	glUniform1i(m_MarioPoseNumPartsLocation, m_NumMarioBindPoseParts);
+	glBindVertexArray(m_MarioBindPoseVertexArray);
+	glBindBuffer(GL_UNIFORM_BUFFER, m_MarioPoseUniformBuffer);
 
-	glUseProgram(*shader);
-	glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, *texture);
-    glBindVertexArray(mesh->vao);
-	glUniformMatrix4fv(glGetUniformLocation(*shader, "view"), 1, GL_FALSE, (GLfloat*)view);
-	glUniformMatrix4fv(glGetUniformLocation(*shader, "projection"), 1, GL_FALSE, (GLfloat*)projection);
-	glUniform1i(glGetUniformLocation(*shader, "marioTex"), 0);
+	for(int First = 0; First < pCommand->m_NumMarios; First += MaxMarios)
+	{
+		const int NumMarios = minimum(MaxMarios, pCommand->m_NumMarios - First);
+		// the parts a Mario doesn't draw stay zero, which the shader collapses
+		m_vMarioPoseUniforms.assign((size_t)4 * MarioVec4s * NumMarios, 0.0f);
+		for(int i = 0; i < NumMarios; i++)
+		{
+			const CCommandBuffer::SMarioPoseDraw &Mario = pCommand->m_pMarios[First + i];
+			float *pMario = m_vMarioPoseUniforms.data() + (size_t)4 * MarioVec4s * i;
+			pMario[0] = (Mario.m_CapFlag & MARIO_METAL_CAP) ? 1.0f : 0.0f;
+			pMario[1] = Mario.m_CustomColors ? 1.0f : 0.0f;
+			pMario[4] = Mario.m_BodyColor.r;
+			pMario[5] = Mario.m_BodyColor.g;
+			pMario[6] = Mario.m_BodyColor.b;
+			pMario[8] = Mario.m_FeetColor.r;
+			pMario[9] = Mario.m_FeetColor.g;
+			pMario[10] = Mario.m_FeetColor.b;
+			for(int p = Mario.m_FirstPart; p < Mario.m_FirstPart + Mario.m_NumParts; p++)
+			{
+				const CCommandBuffer::SMarioPartDraw &Part = pCommand->m_pParts[p];
+				if(Part.m_FirstVertex + Part.m_NumVertices > m_MarioBindPoseVertices)
+					continue;
+				float *pPart = pMario + 4 * (3 + 4 * m_vMarioBindPoseParts[Part.m_FirstVertex]);
+				mem_copy(pPart, Part.m_aTransform, sizeof(Part.m_aTransform));
+				// the transform is affine, the unused w of its first column says how the part is drawn
+				pPart[3] = Part.m_WingCap ? 2.0f : 1.0f;
+			}
+		}
 
-	uint32_t triangleSize = geometry->numTrianglesUsed*3;
-	if (cap & MARIO_WING_CAP)
+		// orphaned for every draw, the bound range always has the size of the uniform block
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(float) * 4 * m_MarioPoseMaxVec4s, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(float) * m_vMarioPoseUniforms.size(), m_vMarioPoseUniforms.data());
+		glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_MarioPoseUniformBuffer);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, m_MarioBindPoseVertices, NumMarios);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glUseProgram(0);
+	glBindVertexArray(0);
+
+	glDisable(GL_DEPTH_TEST);
+	return true;
+}
+
+void CCommandProcessorFragment_OpenGL2::Cmd_RenderMarioPoses(const CCommandBuffer::SCommand_RenderMarioPoses *pCommand)
+{
+	if(m_MarioPoseProgram != 0 && RenderMarioPosesInstanced(pCommand))
+		return;
+
+	BeginMarioDraw(pCommand->m_State, pCommand->m_ShaderHandle, pCommand->m_TextureHandle, false);
+	glBindVertexArray(m_MarioBindPoseVertexArray);
+
+	for(int i = 0; i < pCommand->m_NumMarios; i++)
 	{
-		// skip the white rectangles from the wings (hacky solution because glBlend stuff does nothing)
-		triangleSize = geometry->numTrianglesUsed*3-24;
-		glUniform1i(glGetUniformLocation(*shader, "wingCap"), 1);
-		glDrawElements(GL_TRIANGLES, 24, GL_UNSIGNED_SHORT, indices + triangleSize);
+		const CCommandBuffer::SMarioPoseDraw &Mario = pCommand->m_pMarios[i];
+		glUniform1i(m_MarioMetalCapLocation, (Mario.m_CapFlag & MARIO_METAL_CAP) ? 1 : 0);
+		glUniform1i(m_MarioCustomColorsLocation, Mario.m_CustomColors ? 1 : 0);
+		glUniform3f(m_MarioBodyColorLocation, Mario.m_BodyColor.r, Mario.m_BodyColor.g, Mario.m_BodyColor.b);
+		glUniform3f(m_MarioFeetColorLocation, Mario.m_FeetColor.r, Mario.m_FeetColor.g, Mario.m_FeetColor.b);
+
+		bool WingCap = false;
+		for(int p = Mario.m_FirstPart; p < Mario.m_FirstPart + Mario.m_NumParts; p++)
+		{
+			const CCommandBuffer::SMarioPartDraw &Part = pCommand->m_pParts[p];
+			if(Part.m_WingCap != WingCap)
+			{
+				glUniform1i(m_MarioWingCapLocation, Part.m_WingCap ? 1 : 0);
+				WingCap = Part.m_WingCap;
+			}
+
+			// the normals are lit like libsm64's, which are transformed without the flip to the world's Y down
+			const float *pM = Part.m_aTransform;
+			const GLfloat normalMatrix[9] = {
+				pM[0], -pM[1], pM[2],
+				pM[4], -pM[5], pM[6],
+				pM[8], -pM[9], pM[10]};
+			glUniformMatrix4fv(m_MarioModelLocation, 1, GL_FALSE, pM);
+			glUniformMatrix3fv(m_MarioNormalMatrixLocation, 1, GL_FALSE, normalMatrix);
+			glDrawArrays(GL_TRIANGLES, Part.m_FirstVertex, Part.m_NumVertices);
+		}
+		if(WingCap)
+			glUniform1i(m_MarioWingCapLocation, 0);
 	}
-	glUniform1i(glGetUniformLocation(*shader, "wingCap"), 0);
-	glUniform1i(glGetUniformLocation(*shader, "metalCap"), (cap & MARIO_METAL_CAP) ? 1 : 0);
 
-    glDrawElements(GL_TRIANGLES, triangleSize, GL_UNSIGNED_SHORT, indices);
 	glUseProgram(0);
 	glBindVertexArray(0);
 
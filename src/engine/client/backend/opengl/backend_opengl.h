@@ -126,9 +126,9 @@ protected:
 
 	// mario
 	virtual void Cmd_FirstInitMario(const CCommandBuffer::SCommand_FirstInitMario *pCommand) { dbg_assert(false, "Call of unsupported Cmd_FirstInitMario"); }
-	virtual void Cmd_InitMario(const CCommandBuffer::SCommand_InitMario *pCommand) { dbg_assert(false, "Call of unsupported Cmd_InitMario"); }
-	virtual void Cmd_DestroyMario(const CCommandBuffer::SCommand_DestroyMario *pCommand) { dbg_assert(false, "Call of unsupported Cmd_DestroyMario"); }
-	virtual void Cmd_UpdateAndRenderMario(const CCommandBuffer::SCommand_UpdateAndRenderMario *pCommand) { dbg_assert(false, "Call of unsupported Cmd_UpdateAndRenderMario"); }
+	virtual void Cmd_RenderMarios(const CCommandBuffer::SCommand_RenderMarios *pCommand) { dbg_assert(false, "Call of unsupported Cmd_RenderMarios"); }
+	virtual void Cmd_UploadMarioBindPose(const CCommandBuffer::SCommand_UploadMarioBindPose *pCommand) { dbg_assert(false, "Call of unsupported Cmd_UploadMarioBindPose"); }
+	virtual void Cmd_RenderMarioPoses(const CCommandBuffer::SCommand_RenderMarioPoses *pCommand) { dbg_assert(false, "Call of unsupported Cmd_RenderMarioPoses"); }
 
 public:
 	CCommandProcessorFragment_OpenGL();
@@ -200,15 +200,59 @@ protected:
 
 	// mario
 	void Cmd_FirstInitMario(const CCommandBuffer::SCommand_FirstInitMario *pCommand) override;
-	void Cmd_InitMario(const CCommandBuffer::SCommand_InitMario *pCommand) override;
-	void Cmd_DestroyMario(const CCommandBuffer::SCommand_DestroyMario *pCommand) override;
-	void Cmd_UpdateAndRenderMario(const CCommandBuffer::SCommand_UpdateAndRenderMario *pCommand) override;
+	void Cmd_RenderMarios(const CCommandBuffer::SCommand_RenderMarios *pCommand) override;
+	void Cmd_UploadMarioBindPose(const CCommandBuffer::SCommand_UploadMarioBindPose *pCommand) override;
+	void Cmd_RenderMarioPoses(const CCommandBuffer::SCommand_RenderMarioPoses *pCommand) override;
+	bool RenderMarioPosesInstanced(const CCommandBuffer::SCommand_RenderMarioPoses *pCommand);
+	void BeginMarioDraw(const CCommandBuffer::SState &State, uint32_t *pShader, uint32_t *pTexture, bool Instanced);
 #endif
 
 	CGLSLTileProgram *m_pTileProgram;
 	CGLSLTileProgram *m_pTileProgramTextured;
 	CGLSLPrimitiveProgram *m_pPrimitive3DProgram;
 	CGLSLPrimitiveProgram *m_pPrimitive3DProgramTextured;
+
+	// all Marios are streamed through one ring buffer, it's orphaned when it wraps
+	enum
+	{
+		MARIO_RING_VERTICES = 64 * 3 * SM64_GEO_MAX_TRIANGLES,
+	};
+	TWGLuint m_MarioVertexArray = 0;
+	TWGLuint m_MarioRingBuffer = 0;
+	int m_MarioRingOffset = 0; // in vertices
+	TWGLint m_MarioViewLocation = -1;
+	TWGLint m_MarioProjectionLocation = -1;
+	TWGLint m_MarioTextureLocation = -1;
+	TWGLint m_MarioWingCapLocation = -1;
+	TWGLint m_MarioMetalCapLocation = -1;
+
+	// GPU skinning: the bind pose is a static buffer that only grows, each part is drawn with its own transform
+	TWGLuint m_MarioBindPoseVertexArray = 0;
+	TWGLuint m_MarioBindPoseBuffer = 0;
+	TWGLint m_MarioModelLocation = -1;
+	TWGLint m_MarioNormalMatrixLocation = -1;
+	TWGLint m_MarioCustomColorsLocation = -1;
+	TWGLint m_MarioBodyColorLocation = -1;
+	TWGLint m_MarioFeetColorLocation = -1;
+	int m_MarioBindPoseVertices = 0;
+
+	// with uniform buffers, the posed Marios of a command are one instanced draw of the whole bind pose. every vertex has
+	// the index of its part, which a part gets the first time it's drawn. the parts a Mario doesn't draw collapse to a point
+	enum
+	{
+		MARIO_NO_PART = 0xffff,
+	};
+	TWGLuint m_MarioPoseProgram = 0;
+	TWGLuint m_MarioBindPosePartBuffer = 0;
+	TWGLuint m_MarioPoseUniformBuffer = 0;
+	TWGLint m_MarioPoseViewLocation = -1;
+	TWGLint m_MarioPoseProjectionLocation = -1;
+	TWGLint m_MarioPoseTextureLocation = -1;
+	TWGLint m_MarioPoseNumPartsLocation = -1;
+	int m_MarioPoseMaxVec4s = 0;
+	std::vector<uint16_t> m_vMarioBindPoseParts;
+	int m_NumMarioBindPoseParts = 0;
+	std::vector<float> m_vMarioPoseUniforms;
 };
 
 class CCommandProcessorFragment_OpenGL3 : public CCommandProcessorFragment_OpenGL2
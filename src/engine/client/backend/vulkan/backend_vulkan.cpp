@@ -41,6 +41,10 @@
 #include <vulkan/vk_platform.h>
 #include <vulkan/vulkan_core.h>
 
+extern "C" {
+#include <decomp/include/sm64shared.h>
+}
+
 #ifndef VK_API_VERSION_MAJOR
 #define VK_API_VERSION_MAJOR VK_VERSION_MAJOR
 #define VK_API_VERSION_MINOR VK_VERSION_MINOR
@@ -701,6 +705,34 @@ class CCommandProcessorFragment_Vulkan : public CCommandProcessorFragment_GLBase
 		float m_aPos[4 * 2];
 	};
 
+	struct SUniformMarioGPos
+	{
+		float m_aProjection[4 * 4];
+	};
+
+	struct SUniformMarioFragParams
+	{
+		int32_t m_WingCap;
+		int32_t m_MetalCap;
+	};
+
+	struct SUniformMarioPoseGPos
+	{
+		float m_aProjModel[4 * 4];
+		float m_aNormalMatrix[4 * 3];
+	};
+
+	struct SUniformMarioPoseParams
+	{
+		int32_t m_WingCap;
+		int32_t m_MetalCap;
+		uint32_t m_BodyColor; // RGBA8, no custom colors if the alpha is 0
+		uint32_t m_FeetColor;
+	};
+
+	// 128 bytes is the smallest maxPushConstantsSize a device can have
+	static_assert(sizeof(SUniformMarioPoseGPos) + sizeof(SUniformMarioPoseParams) <= 128);
+
 	struct SUniformGTextPos
 	{
 		float m_aPos[4 * 2];
@@ -961,6 +993,9 @@ class CCommandProcessorFragment_Vulkan : public CCommandProcessorFragment_GLBase
 private:
 	std::vector<VkImageView> m_vSwapChainImageViewList;
 	std::vector<SSwapChainMultiSampleImage> m_vSwapChainMultiSamplingImages;
+	// only Marios are depth tested, everything else ignores the depth buffer
+	std::vector<SSwapChainMultiSampleImage> m_vSwapChainDepthImages;
+	VkFormat m_VKDepthFormat = VK_FORMAT_UNDEFINED;
 	std::vector<VkFramebuffer> m_vFramebufferList;
 	std::vector<VkCommandBuffer> m_vMainDrawCommandBuffers;
 
@@ -1022,6 +1057,15 @@ private:
 	SPipelineContainer m_SpriteMultiPushPipeline;
 	SPipelineContainer m_QuadPipeline;
 	SPipelineContainer m_QuadPushPipeline;
+	SPipelineContainer m_MarioPipeline;
+	SPipelineContainer m_MarioPosePipeline;
+
+	// uploaded by CMD_MARIO_FIRST_INIT, not part of the texture slots of the frontend
+	CTexture m_MarioTexture;
+	// the bind pose of the posed Marios, each part is drawn with its transform in the push constants.
+	// it's only appended to, render threads only draw the parts that were uploaded before their command was filled
+	SMemoryBlock<s_VertexBufferCacheID> m_MarioBindPoseMem{};
+	int m_MarioBindPoseVertices = 0;
 
 	std::vector<VkPipeline> m_vLastPipeline;
 
@@ -1071,6 +1115,9 @@ private:
 
 		bool m_ClearColorInRenderThread = false;
 
+		// the Mario bind pose vertices that were uploaded when the command was filled
+		int m_MarioBindPoseVertices = 0;
+
 		bool m_HasDynamicState = false;
 		VkViewport m_Viewport;
 		VkRect2D m_Scissor;
@@ -1229,6 +1276,11 @@ protected:
 		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_RENDER_QUAD_CONTAINER_EX)] = {true, [this](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) { Cmd_RenderQuadContainerEx_FillExecuteBuffer(ExecBuffer, static_cast<const CCommandBuffer::SCommand_RenderQuadContainerEx *>(pBaseCommand)); }, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_RenderQuadContainerEx(static_cast<const CCommandBuffer::SCommand_RenderQuadContainerEx *>(pBaseCommand), ExecBuffer); return true; }};
 		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_RENDER_QUAD_CONTAINER_SPRITE_MULTIPLE)] = {true, [this](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) { Cmd_RenderQuadContainerAsSpriteMultiple_FillExecuteBuffer(ExecBuffer, static_cast<const CCommandBuffer::SCommand_RenderQuadContainerAsSpriteMultiple *>(pBaseCommand)); }, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_RenderQuadContainerAsSpriteMultiple(static_cast<const CCommandBuffer::SCommand_RenderQuadContainerAsSpriteMultiple *>(pBaseCommand), ExecBuffer); return true; }};
 
+		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_MARIO_FIRST_INIT)] = {false, [](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) {}, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_FirstInitMario(static_cast<const CCommandBuffer::SCommand_FirstInitMario *>(pBaseCommand)); return true; }};
+		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_MARIO_RENDER)] = {true, [this](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) { Cmd_RenderMarios_FillExecuteBuffer(ExecBuffer, static_cast<const CCommandBuffer::SCommand_RenderMarios *>(pBaseCommand)); }, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_RenderMarios(static_cast<const CCommandBuffer::SCommand_RenderMarios *>(pBaseCommand), ExecBuffer); return true; }};
+		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_MARIO_UPLOAD_BIND_POSE)] = {false, [](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) {}, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_UploadMarioBindPose(static_cast<const CCommandBuffer::SCommand_UploadMarioBindPose *>(pBaseCommand)); return true; }};
+		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_MARIO_RENDER_POSES)] = {true, [this](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) { Cmd_RenderMarioPoses_FillExecuteBuffer(ExecBuffer, static_cast<const CCommandBuffer::SCommand_RenderMarioPoses *>(pBaseCommand)); }, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_RenderMarioPoses(static_cast<const CCommandBuffer::SCommand_RenderMarioPoses *>(pBaseCommand), ExecBuffer); return true; }};
+
 		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_SWAP)] = {false, [](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) {}, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_Swap(static_cast<const CCommandBuffer::SCommand_Swap *>(pBaseCommand)); return true; }};
 		m_aCommandCallbacks[CommandBufferCMDOff(CCommandBuffer::CMD_FINISH)] = {false, [](SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand *pBaseCommand) {}, [this](const CCommandBuffer::SCommand *pBaseCommand, SRenderCommandExecuteBuffer &ExecBuffer) { Cmd_Finish(static_cast<const CCommandBuffer::SCommand_Finish *>(pBaseCommand)); return true; }};
 
@@ -2339,9 +2391,14 @@ protected:
 		RenderPassInfo.renderArea.offset = {0, 0};
 		RenderPassInfo.renderArea.extent = m_VKSwapImgAndViewportExtent.m_SwapImageViewport;
 
-		VkClearValue ClearColorVal = {{{m_aClearColor[0], m_aClearColor[1], m_aClearColor[2], m_aClearColor[3]}}};
-		RenderPassInfo.clearValueCount = 1;
-		RenderPassInfo.pClearValues = &ClearColorVal;
+		// the clear values are indexed by attachment, the depth attachment is always the last one
+		std::array<VkClearValue, 3> aClearValues;
+		for(auto &ClearValue : aClearValues)
+			ClearValue.color = {{m_aClearColor[0], m_aClearColor[1], m_aClearColor[2], m_aClearColor[3]}};
+		const size_t DepthAttachmentIndex = HasMultiSampling() ? 2 : 1;
+		aClearValues[DepthAttachmentIndex].depthStencil = {1.0f, 0};
+		RenderPassInfo.clearValueCount = DepthAttachmentIndex + 1;
+		RenderPassInfo.pClearValues = aClearValues.data();
 
 		vkCmdBeginRenderPass(CommandBuffer, &RenderPassInfo, m_ThreadCount > 1 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
@@ -2745,14 +2802,14 @@ protected:
 		return m_aSamplers[SamplerType];
 	}
 
-	VkImageView CreateImageView(VkImage Image, VkFormat Format, VkImageViewType ViewType, size_t Depth, size_t MipMapLevelCount)
+	VkImageView CreateImageView(VkImage Image, VkFormat Format, VkImageViewType ViewType, size_t Depth, size_t MipMapLevelCount, VkImageAspectFlags AspectMask = VK_IMAGE_ASPECT_COLOR_BIT)
 	{
 		VkImageViewCreateInfo ViewCreateInfo{};
 		ViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		ViewCreateInfo.image = Image;
 		ViewCreateInfo.viewType = ViewType;
 		ViewCreateInfo.format = Format;
-		ViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		ViewCreateInfo.subresourceRange.aspectMask = AspectMask;
 		ViewCreateInfo.subresourceRange.baseMipLevel = 0;
 		ViewCreateInfo.subresourceRange.levelCount = MipMapLevelCount;
 		ViewCreateInfo.subresourceRange.baseArrayLayer = 0;
@@ -2781,7 +2838,7 @@ protected:
 		ImageInfo.tiling = Tiling;
 		ImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		ImageInfo.usage = ImageUsage;
-		ImageInfo.samples = (ImageUsage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) == 0 ? VK_SAMPLE_COUNT_1_BIT : GetSampleCount();
+		ImageInfo.samples = (ImageUsage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) == 0 ? VK_SAMPLE_COUNT_1_BIT : GetSampleCount();
 		ImageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 		if(vkCreateImage(m_VKDevice, &ImageInfo, nullptr, &Image) != VK_SUCCESS)
@@ -4201,6 +4258,40 @@ public:
 		m_vSwapChainMultiSamplingImages.clear();
 	}
 
+	VkFormat GetDepthFormat()
+	{
+		// D16 is always supported, but the Mario depth range is large
+		VkFormatProperties FormatProperties;
+		vkGetPhysicalDeviceFormatProperties(m_VKGPU, VK_FORMAT_D32_SFLOAT, &FormatProperties);
+		if(FormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+			return VK_FORMAT_D32_SFLOAT;
+		return VK_FORMAT_D16_UNORM;
+	}
+
+	bool CreateDepthImageAttachments()
+	{
+		m_VKDepthFormat = GetDepthFormat();
+		m_vSwapChainDepthImages.resize(m_SwapChainImageCount);
+		for(size_t i = 0; i < m_SwapChainImageCount; ++i)
+		{
+			CreateImage(m_VKSwapImgAndViewportExtent.m_SwapImageViewport.width, m_VKSwapImgAndViewportExtent.m_SwapImageViewport.height, 1, 1, m_VKDepthFormat, VK_IMAGE_TILING_OPTIMAL, m_vSwapChainDepthImages[i].m_Image, m_vSwapChainDepthImages[i].m_ImgMem, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+			m_vSwapChainDepthImages[i].m_ImgView = CreateImageView(m_vSwapChainDepthImages[i].m_Image, m_VKDepthFormat, VK_IMAGE_VIEW_TYPE_2D, 1, 1, VK_IMAGE_ASPECT_DEPTH_BIT);
+		}
+
+		return true;
+	}
+
+	void DestroyDepthImageAttachments()
+	{
+		for(auto &DepthImage : m_vSwapChainDepthImages)
+		{
+			vkDestroyImage(m_VKDevice, DepthImage.m_Image, nullptr);
+			vkDestroyImageView(m_VKDevice, DepthImage.m_ImgView, nullptr);
+			FreeImageMemBlock(DepthImage.m_ImgMem);
+		}
+		m_vSwapChainDepthImages.clear();
+	}
+
 	bool CreateRenderPass(bool ClearAttachs)
 	{
 		bool HasMultiSamplingTargets = HasMultiSampling();
@@ -4224,6 +4315,16 @@ public:
 		ColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		ColorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+		VkAttachmentDescription DepthAttachment{};
+		DepthAttachment.format = m_VKDepthFormat;
+		DepthAttachment.samples = GetSampleCount();
+		DepthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		DepthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		DepthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		DepthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		DepthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 		VkAttachmentReference MultiSamplingColorAttachmentRef{};
 		MultiSamplingColorAttachmentRef.attachment = 0;
 		MultiSamplingColorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
@@ -4232,27 +4333,33 @@ public:
 		ColorAttachmentRef.attachment = HasMultiSamplingTargets ? 1 : 0;
 		ColorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+		VkAttachmentReference DepthAttachmentRef{};
+		DepthAttachmentRef.attachment = HasMultiSamplingTargets ? 2 : 1;
+		DepthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 		VkSubpassDescription Subpass{};
 		Subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		Subpass.colorAttachmentCount = 1;
 		Subpass.pColorAttachments = HasMultiSamplingTargets ? &MultiSamplingColorAttachmentRef : &ColorAttachmentRef;
 		Subpass.pResolveAttachments = HasMultiSamplingTargets ? &ColorAttachmentRef : nullptr;
+		Subpass.pDepthStencilAttachment = &DepthAttachmentRef;
 
-		std::array<VkAttachmentDescription, 2> aAttachments;
+		std::array<VkAttachmentDescription, 3> aAttachments;
 		aAttachments[0] = MultiSamplingColorAttachment;
 		aAttachments[1] = ColorAttachment;
+		aAttachments[2] = DepthAttachment;
 
 		VkSubpassDependency Dependency{};
 		Dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		Dependency.dstSubpass = 0;
-		Dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		Dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 		Dependency.srcAccessMask = 0;
-		Dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		Dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		Dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		Dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 		VkRenderPassCreateInfo CreateRenderPassInfo{};
 		CreateRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		CreateRenderPassInfo.attachmentCount = HasMultiSamplingTargets ? 2 : 1;
+		CreateRenderPassInfo.attachmentCount = HasMultiSamplingTargets ? 3 : 2;
 		CreateRenderPassInfo.pAttachments = HasMultiSamplingTargets ? aAttachments.data() : aAttachments.data() + 1;
 		CreateRenderPassInfo.subpassCount = 1;
 		CreateRenderPassInfo.pSubpasses = &Subpass;
@@ -4279,9 +4386,10 @@ public:
 
 		for(size_t i = 0; i < m_SwapChainImageCount; i++)
 		{
-			std::array<VkImageView, 2> aAttachments = {
+			std::array<VkImageView, 3> aAttachments = {
 				m_vSwapChainMultiSamplingImages[i].m_ImgView,
-				m_vSwapChainImageViewList[i]};
+				m_vSwapChainImageViewList[i],
+				m_vSwapChainDepthImages[i].m_ImgView};
 
 			bool HasMultiSamplingTargets = HasMultiSampling();
 
@@ -4495,7 +4603,7 @@ public:
 	template<bool ForceRequireDescriptors, size_t ArraySize, size_t DescrArraySize, size_t PushArraySize>
 	bool CreateGraphicsPipeline(const char *pVertName, const char *pFragName, SPipelineContainer &PipeContainer, uint32_t Stride, std::array<VkVertexInputAttributeDescription, ArraySize> &aInputAttr,
 		std::array<VkDescriptorSetLayout, DescrArraySize> &aSetLayouts, std::array<VkPushConstantRange, PushArraySize> &aPushConstants, EVulkanBackendTextureModes TexMode,
-		EVulkanBackendBlendModes BlendMode, EVulkanBackendClipModes DynamicMode, bool IsLinePrim = false)
+		EVulkanBackendBlendModes BlendMode, EVulkanBackendClipModes DynamicMode, bool IsLinePrim = false, bool IsDepthTested = false)
 	{
 		VkPipelineShaderStageCreateInfo aShaderStages[2];
 		SShaderModule Module;
@@ -4528,6 +4636,14 @@ public:
 		GetStandardPipelineInfo(InputAssembly, Viewport, Scissor, ViewportState, Rasterizer, Multisampling, ColorBlendAttachment, ColorBlending);
 		InputAssembly.topology = IsLinePrim ? VK_PRIMITIVE_TOPOLOGY_LINE_LIST : VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
+		VkPipelineDepthStencilStateCreateInfo DepthStencil{};
+		DepthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		DepthStencil.depthTestEnable = IsDepthTested ? VK_TRUE : VK_FALSE;
+		DepthStencil.depthWriteEnable = IsDepthTested ? VK_TRUE : VK_FALSE;
+		DepthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+		DepthStencil.depthBoundsTestEnable = VK_FALSE;
+		DepthStencil.stencilTestEnable = VK_FALSE;
+
 		VkPipelineLayoutCreateInfo PipelineLayoutInfo{};
 		PipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		PipelineLayoutInfo.setLayoutCount = (HasSampler || ForceRequireDescriptors) ? aSetLayouts.size() : 0;
@@ -4555,6 +4671,7 @@ public:
 		PipelineInfo.pRasterizationState = &Rasterizer;
 		PipelineInfo.pMultisampleState = &Multisampling;
 		PipelineInfo.pColorBlendState = &ColorBlending;
+		PipelineInfo.pDepthStencilState = &DepthStencil;
 		PipelineInfo.layout = PipeLayout;
 		PipelineInfo.renderPass = m_VKRenderPass;
 		PipelineInfo.subpass = 0;
@@ -4650,6 +4767,46 @@ public:
 		return Ret;
 	}
 
+	bool CreateMarioGraphicsPipelineImpl(const char *pVertName, const char *pFragName, SPipelineContainer &PipeContainer, EVulkanBackendClipModes DynamicMode, bool Pose)
+	{
+		std::array<VkVertexInputAttributeDescription, 4> aAttributeDescriptions = {};
+
+		aAttributeDescriptions[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(GL_SMarioVertex, m_Pos)};
+		aAttributeDescriptions[1] = {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(GL_SMarioVertex, m_Normal)};
+		aAttributeDescriptions[2] = {2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GL_SMarioVertex, m_Color)};
+		aAttributeDescriptions[3] = {3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(GL_SMarioVertex, m_Tex)};
+
+		std::array<VkDescriptorSetLayout, 1> aSetLayouts = {m_StandardTexturedDescriptorSetLayout};
+
+		std::array<VkPushConstantRange, 2> aPushConstants{};
+		if(Pose)
+		{
+			// the vertex shader also reads the custom colors of the fragment parameters
+			aPushConstants[0] = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(SUniformMarioPoseGPos)};
+			aPushConstants[1] = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioPoseGPos), sizeof(SUniformMarioPoseParams)};
+		}
+		else
+		{
+			aPushConstants[0] = {VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(SUniformMarioGPos)};
+			aPushConstants[1] = {VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioGPos), sizeof(SUniformMarioFragParams)};
+		}
+
+		return CreateGraphicsPipeline<false>(pVertName, pFragName, PipeContainer, sizeof(GL_SMarioVertex), aAttributeDescriptions, aSetLayouts, aPushConstants, VULKAN_BACKEND_TEXTURE_MODE_TEXTURED, VULKAN_BACKEND_BLEND_MODE_NONE, DynamicMode, false, true);
+	}
+
+	bool CreateMarioGraphicsPipeline(const char *pVertName, const char *pFragName, SPipelineContainer &PipeContainer, bool Pose)
+	{
+		bool Ret = true;
+
+		// Mario is opaque, only the clip mode varies
+		for(size_t j = 0; j < VULKAN_BACKEND_CLIP_MODE_COUNT; ++j)
+		{
+			Ret &= CreateMarioGraphicsPipelineImpl(pVertName, pFragName, PipeContainer, EVulkanBackendClipModes(j), Pose);
+		}
+
+		return Ret;
+	}
+
 	bool CreateTextDescriptorSetLayout()
 	{
 		VkDescriptorSetLayoutBinding SamplerLayoutBinding{};
@@ -5239,11 +5396,14 @@ public:
 		m_SpriteMultiPushPipeline.Destroy(m_VKDevice);
 		m_QuadPipeline.Destroy(m_VKDevice);
 		m_QuadPushPipeline.Destroy(m_VKDevice);
+		m_MarioPipeline.Destroy(m_VKDevice);
+		m_MarioPosePipeline.Destroy(m_VKDevice);
 
 		DestroyFramebuffers();
 
 		DestroyRenderPass();
 
+		DestroyDepthImageAttachments();
 		DestroyMultiSamplerImageAttachments();
 
 		DestroyImageViews();
@@ -5262,6 +5422,13 @@ public:
 			if(m_SwapchainCreated)
 				CleanupVulkanSwapChain(true);
 
+			DestroyTexture(m_MarioTexture);
+			m_MarioTexture = {};
+			if(m_MarioBindPoseMem.m_Buffer != VK_NULL_HANDLE)
+				FreeVertexMemBlock(m_MarioBindPoseMem);
+			m_MarioBindPoseMem = {};
+			m_MarioBindPoseVertices = 0;
+
 			// clean all images, buffers, buffer containers
 			for(auto &Texture : m_vTextures)
 			{
@@ -5653,8 +5820,11 @@ public:
 
 	bool CreateNewTexturedStandardDescriptorSets(size_t TextureSlot, size_t DescrIndex)
 	{
-		auto &Texture = m_vTextures[TextureSlot];
+		return CreateNewTexturedStandardDescriptorSets(m_vTextures[TextureSlot], DescrIndex);
+	}
 
+	bool CreateNewTexturedStandardDescriptorSets(CTexture &Texture, size_t DescrIndex)
+	{
 		auto &DescrSet = Texture.m_aVKStandardTexturedDescrSets[DescrIndex];
 
 		VkDescriptorSetAllocateInfo DesAllocInfo{};
@@ -5852,6 +6022,9 @@ public:
 			return -1;
 		}
 
+		if(!CreateDepthImageAttachments())
+			return -1;
+
 		m_LastPresentedSwapChainImageIndex = std::numeric_limits<decltype(m_LastPresentedSwapChainImageIndex)>::max();
 
 		if(!CreateRenderPass(true))
@@ -5926,6 +6099,12 @@ public:
 		if(!CreateQuadPushGraphicsPipeline<true>("shader/vulkan/quad_push_textured.vert.spv", "shader/vulkan/quad_push_textured.frag.spv"))
 			return -1;
 
+		if(!CreateMarioGraphicsPipeline("shader/vulkan/mario.vert.spv", "shader/vulkan/mario.frag.spv", m_MarioPipeline, false))
+			return -1;
+
+		if(!CreateMarioGraphicsPipeline("shader/vulkan/mario_pose.vert.spv", "shader/vulkan/mario_pose.frag.spv", m_MarioPosePipeline, true))
+			return -1;
+
 		m_SwapchainCreated = true;
 		return 0;
 	}
@@ -6571,6 +6750,233 @@ public:
 		RenderStandard<CCommandBuffer::SVertexTex3DStream, true>(ExecBuffer, pCommand->m_State, pCommand->m_PrimType, pCommand->m_pVertices, pCommand->m_PrimCount);
 	}
 
+	void Cmd_FirstInitMario(const CCommandBuffer::SCommand_FirstInitMario *pCommand)
+	{
+		// the GLSL code of the command is for the OpenGL backends, the Mario pipeline is created with the others
+		if(m_MarioTexture.m_Img != VK_NULL_HANDLE)
+			return;
+
+		CreateTextureImage(0, m_MarioTexture.m_Img, m_MarioTexture.m_ImgMem, pCommand->m_Texture, VK_FORMAT_R8G8B8A8_UNORM, SM64_TEXTURE_WIDTH, SM64_TEXTURE_HEIGHT, 1, 4, 1);
+		m_MarioTexture.m_ImgView = CreateTextureImageView(m_MarioTexture.m_Img, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_VIEW_TYPE_2D, 1, 1);
+		m_MarioTexture.m_aSamplers[1] = GetTextureSampler(SUPPORTED_SAMPLER_TYPE_CLAMP_TO_EDGE);
+		m_MarioTexture.m_Width = SM64_TEXTURE_WIDTH;
+		m_MarioTexture.m_Height = SM64_TEXTURE_HEIGHT;
+
+		CreateNewTexturedStandardDescriptorSets(m_MarioTexture, 1);
+
+		// room for the whole bind pose, it's never reallocated
+		m_MarioBindPoseMem = GetVertexBuffer(sizeof(GL_SMarioVertex) * 3 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES);
+		m_MarioBindPoseVertices = 0;
+	}
+
+	void Cmd_RenderMarios_FillExecuteBuffer(SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand_RenderMarios *pCommand)
+	{
+		ExecBuffer.m_aDescriptors[0] = m_MarioTexture.m_aVKStandardTexturedDescrSets[1];
+
+		// the wing cap is an extra draw
+		size_t DrawCalls = pCommand->m_NumDraws;
+		for(int i = 0; i < pCommand->m_NumDraws; ++i)
+		{
+			if(pCommand->m_pDraws[i].m_CapFlag & MARIO_WING_CAP)
+				++DrawCalls;
+		}
+		ExecBuffer.m_EstimatedRenderCallCount = DrawCalls;
+
+		ExecBufferFillDynamicStates(pCommand->m_State, ExecBuffer);
+	}
+
+	void Cmd_RenderMarios(const CCommandBuffer::SCommand_RenderMarios *pCommand, SRenderCommandExecuteBuffer &ExecBuffer)
+	{
+		if(m_MarioTexture.m_Img == VK_NULL_HANDLE || pCommand->m_NumVertices == 0)
+			return;
+
+		const CCommandBuffer::SState &State = pCommand->m_State;
+
+		// the screen mapping of the state, with a depth range that fits the whole mario model
+		const float Left = State.m_ScreenTL.x, Right = State.m_ScreenBR.x;
+		const float Top = State.m_ScreenTL.y, Bottom = State.m_ScreenBR.y;
+		const float NearZ = -1000.f, FarZ = 10000.f;
+		SUniformMarioGPos VertexPushConstants = {{
+			// column 1
+			2.f / (Right - Left), 0, 0, 0,
+			// column 2
+			0, 2.f / (Bottom - Top), 0, 0,
+			// column 3
+			0, 0, -1.f / (FarZ - NearZ), 0,
+			// column 4
+			-(Right + Left) / (Right - Left), -(Bottom + Top) / (Bottom - Top), -NearZ / (FarZ - NearZ), 1}};
+
+		size_t DynamicIndex = GetDynamicModeIndexFromExecBuffer(ExecBuffer);
+		auto &PipeLayout = GetPipeLayout(m_MarioPipeline, true, VULKAN_BACKEND_BLEND_MODE_NONE, DynamicIndex);
+		auto &PipeLine = GetPipeline(m_MarioPipeline, true, VULKAN_BACKEND_BLEND_MODE_NONE, DynamicIndex);
+
+		auto &CommandBuffer = GetGraphicCommandBuffer(ExecBuffer.m_ThreadIndex);
+
+		BindPipeline(ExecBuffer.m_ThreadIndex, CommandBuffer, ExecBuffer, PipeLine, State);
+
+		// all Marios go into the streamed vertex memory of the current frame at once
+		VkBuffer VKBuffer;
+		SDeviceMemoryBlock VKBufferMem;
+		size_t BufferOff = 0;
+		CreateStreamVertexBuffer(ExecBuffer.m_ThreadIndex, VKBuffer, VKBufferMem, BufferOff, pCommand->m_pVertices, sizeof(GL_SMarioVertex) * pCommand->m_NumVertices);
+
+		std::array<VkBuffer, 1> aVertexBuffers = {VKBuffer};
+		std::array<VkDeviceSize, 1> aOffsets = {(VkDeviceSize)BufferOff};
+		vkCmdBindVertexBuffers(CommandBuffer, 0, 1, aVertexBuffers.data(), aOffsets.data());
+
+		vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipeLayout, 0, 1, &ExecBuffer.m_aDescriptors[0].m_Descriptor, 0, nullptr);
+
+		vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(SUniformMarioGPos), &VertexPushConstants);
+
+		SUniformMarioFragParams FragPushConstants = {0, 0};
+		vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioGPos), sizeof(SUniformMarioFragParams), &FragPushConstants);
+
+		for(int i = 0; i < pCommand->m_NumDraws; ++i)
+		{
+			const CCommandBuffer::SMarioDraw &Draw = pCommand->m_pDraws[i];
+			// the metal cap drops the vertex colors like the OpenGL Mario shader
+			const int32_t MetalCap = (Draw.m_CapFlag & MARIO_METAL_CAP) ? 1 : 0;
+			if(MetalCap != FragPushConstants.m_MetalCap)
+			{
+				FragPushConstants.m_MetalCap = MetalCap;
+				vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioGPos), sizeof(SUniformMarioFragParams), &FragPushConstants);
+			}
+			uint32_t Count = Draw.m_NumVertices;
+			if(Draw.m_CapFlag & MARIO_WING_CAP)
+			{
+				// the last 24 vertices are the wings, drawn without their white rectangles
+				Count -= 24;
+				FragPushConstants.m_WingCap = 1;
+				vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioGPos), sizeof(SUniformMarioFragParams), &FragPushConstants);
+				vkCmdDraw(CommandBuffer, 24, 1, Draw.m_FirstVertex + Count, 0);
+				FragPushConstants.m_WingCap = 0;
+				vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioGPos), sizeof(SUniformMarioFragParams), &FragPushConstants);
+			}
+			vkCmdDraw(CommandBuffer, Count, 1, Draw.m_FirstVertex, 0);
+		}
+	}
+
+	void Cmd_UploadMarioBindPose(const CCommandBuffer::SCommand_UploadMarioBindPose *pCommand)
+	{
+		if(m_MarioBindPoseMem.m_Buffer == VK_NULL_HANDLE || pCommand->m_FirstVertex + pCommand->m_NumVertices > 3 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES)
+			return;
+		// frames in flight might still draw the uploaded vertices, only append
+		if(pCommand->m_FirstVertex < m_MarioBindPoseVertices)
+			return;
+
+		const VkDeviceSize Offset = m_MarioBindPoseMem.m_HeapData.m_OffsetToAlign + sizeof(GL_SMarioVertex) * pCommand->m_FirstVertex;
+		const VkDeviceSize DataSize = sizeof(GL_SMarioVertex) * pCommand->m_NumVertices;
+		auto StagingBuffer = GetStagingBuffer(pCommand->m_pVertices, DataSize);
+		MemoryBarrier(m_MarioBindPoseMem.m_Buffer, Offset, DataSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, true);
+		CopyBuffer(StagingBuffer.m_Buffer, m_MarioBindPoseMem.m_Buffer, StagingBuffer.m_HeapData.m_OffsetToAlign, Offset, DataSize);
+		MemoryBarrier(m_MarioBindPoseMem.m_Buffer, Offset, DataSize, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, false);
+		UploadAndFreeStagingMemBlock(StagingBuffer);
+
+		m_MarioBindPoseVertices = pCommand->m_FirstVertex + pCommand->m_NumVertices;
+	}
+
+	void Cmd_RenderMarioPoses_FillExecuteBuffer(SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand_RenderMarioPoses *pCommand)
+	{
+		ExecBuffer.m_aDescriptors[0] = m_MarioTexture.m_aVKStandardTexturedDescrSets[1];
+		ExecBuffer.m_EstimatedRenderCallCount = pCommand->m_NumParts;
+		// filled on the main thread in command order, so parts uploaded after this command aren't drawn
+		ExecBuffer.m_MarioBindPoseVertices = m_MarioBindPoseVertices;
+
+		ExecBufferFillDynamicStates(pCommand->m_State, ExecBuffer);
+	}
+
+	static uint32_t PackMarioColor(const ColorRGBA &Color)
+	{
+		return (uint32_t)round_to_int(Color.r * 255.0f) | ((uint32_t)round_to_int(Color.g * 255.0f) << 8) | ((uint32_t)round_to_int(Color.b * 255.0f) << 16) | (255u << 24);
+	}
+
+	void Cmd_RenderMarioPoses(const CCommandBuffer::SCommand_RenderMarioPoses *pCommand, SRenderCommandExecuteBuffer &ExecBuffer)
+	{
+		if(m_MarioTexture.m_Img == VK_NULL_HANDLE || m_MarioBindPoseMem.m_Buffer == VK_NULL_HANDLE || pCommand->m_NumParts == 0)
+			return;
+
+		const CCommandBuffer::SState &State = pCommand->m_State;
+
+		// the screen mapping of the state, like Cmd_RenderMarios
+		const float Left = State.m_ScreenTL.x, Right = State.m_ScreenBR.x;
+		const float Top = State.m_ScreenTL.y, Bottom = State.m_ScreenBR.y;
+		const float NearZ = -1000.f, FarZ = 10000.f;
+		const float aProjection[4 * 4] = {
+			// column 1
+			2.f / (Right - Left), 0, 0, 0,
+			// column 2
+			0, 2.f / (Bottom - Top), 0, 0,
+			// column 3
+			0, 0, -1.f / (FarZ - NearZ), 0,
+			// column 4
+			-(Right + Left) / (Right - Left), -(Bottom + Top) / (Bottom - Top), -NearZ / (FarZ - NearZ), 1};
+
+		size_t DynamicIndex = GetDynamicModeIndexFromExecBuffer(ExecBuffer);
+		auto &PipeLayout = GetPipeLayout(m_MarioPosePipeline, true, VULKAN_BACKEND_BLEND_MODE_NONE, DynamicIndex);
+		auto &PipeLine = GetPipeline(m_MarioPosePipeline, true, VULKAN_BACKEND_BLEND_MODE_NONE, DynamicIndex);
+
+		auto &CommandBuffer = GetGraphicCommandBuffer(ExecBuffer.m_ThreadIndex);
+
+		BindPipeline(ExecBuffer.m_ThreadIndex, CommandBuffer, ExecBuffer, PipeLine, State);
+
+		std::array<VkBuffer, 1> aVertexBuffers = {m_MarioBindPoseMem.m_Buffer};
+		std::array<VkDeviceSize, 1> aOffsets = {(VkDeviceSize)m_MarioBindPoseMem.m_HeapData.m_OffsetToAlign};
+		vkCmdBindVertexBuffers(CommandBuffer, 0, 1, aVertexBuffers.data(), aOffsets.data());
+
+		vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipeLayout, 0, 1, &ExecBuffer.m_aDescriptors[0].m_Descriptor, 0, nullptr);
+
+		const int BindPoseVertices = ExecBuffer.m_MarioBindPoseVertices;
+		for(int i = 0; i < pCommand->m_NumMarios; ++i)
+		{
+			const CCommandBuffer::SMarioPoseDraw &Mario = pCommand->m_pMarios[i];
+			SUniformMarioPoseParams Params;
+			Params.m_WingCap = 0;
+			Params.m_MetalCap = (Mario.m_CapFlag & MARIO_METAL_CAP) ? 1 : 0;
+			Params.m_BodyColor = Mario.m_CustomColors ? PackMarioColor(Mario.m_BodyColor) : 0;
+			Params.m_FeetColor = Mario.m_CustomColors ? PackMarioColor(Mario.m_FeetColor) : 0;
+			vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioPoseGPos), sizeof(SUniformMarioPoseParams), &Params);
+
+			for(int p = Mario.m_FirstPart; p < Mario.m_FirstPart + Mario.m_NumParts; ++p)
+			{
+				const CCommandBuffer::SMarioPartDraw &Part = pCommand->m_pParts[p];
+				if(Part.m_FirstVertex + Part.m_NumVertices > BindPoseVertices)
+					continue;
+
+				// the wings are drawn without the white rectangles around the feathers
+				const int32_t WingCap = Part.m_WingCap ? 1 : 0;
+				if(WingCap != Params.m_WingCap)
+				{
+					Params.m_WingCap = WingCap;
+					vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(SUniformMarioPoseGPos), sizeof(SUniformMarioPoseParams), &Params);
+				}
+
+				SUniformMarioPoseGPos PosConstants;
+				const float *pM = Part.m_aTransform;
+				for(int Column = 0; Column < 4; ++Column)
+				{
+					for(int Row = 0; Row < 4; ++Row)
+					{
+						float Sum = 0;
+						for(int k = 0; k < 4; ++k)
+							Sum += aProjection[k * 4 + Row] * pM[Column * 4 + k];
+						PosConstants.m_aProjModel[Column * 4 + Row] = Sum;
+					}
+				}
+				// the normals are lit like libsm64's, which are transformed without the flip to the world's Y down
+				for(int Column = 0; Column < 3; ++Column)
+				{
+					PosConstants.m_aNormalMatrix[Column * 4 + 0] = pM[Column * 4 + 0];
+					PosConstants.m_aNormalMatrix[Column * 4 + 1] = -pM[Column * 4 + 1];
+					PosConstants.m_aNormalMatrix[Column * 4 + 2] = pM[Column * 4 + 2];
+					PosConstants.m_aNormalMatrix[Column * 4 + 3] = 0;
+				}
+				vkCmdPushConstants(CommandBuffer, PipeLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(SUniformMarioPoseGPos), &PosConstants);
+
+				vkCmdDraw(CommandBuffer, Part.m_NumVertices, 1, Part.m_FirstVertex, 0);
+			}
+		}
+	}
+
 	void Cmd_Update_Viewport_FillExecuteBuffer(SRenderCommandExecuteBuffer &ExecBuffer, const CCommandBuffer::SCommand_Update_Viewport *pCommand)
 	{
 		ExecBuffer.m_EstimatedRenderCallCount = 0;
@@ -992,7 +992,7 @@ void *CClient::SnapGetItem(int SnapID, int Index, CSnapItem *pItem) const
 	dbg_assert(SnapID >= 0 && SnapID < NUM_SNAPSHOT_TYPES, "invalid SnapID");
 	CSnapshotItem *pSnapshotItem = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItem(Index);
 	pItem->m_DataSize = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItemSize(Index);
-	pItem->m_Type = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItemType(Index);
+	pItem->m_Type = m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->GetItemType(Index, m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltIndex);
 	pItem->m_ID = pSnapshotItem->ID();
 	return (void *)pSnapshotItem->Data();
 }
@@ -1022,7 +1022,7 @@ void *CClient::SnapFindItem(int SnapID, int Type, int ID) const
 	if(!m_aapSnapshots[g_Config.m_ClDummy][SnapID])
 		return 0x0;
 
-	return m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->FindItem(Type, ID);
+	return m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltSnap->FindItem(Type, ID, m_aapSnapshots[g_Config.m_ClDummy][SnapID]->m_pAltIndex);
 }
 
 int CClient::SnapNumItems(int SnapID) const
@@ -1114,7 +1114,7 @@ void CClient::DebugRender()
 		{
 			if(m_SnapshotDelta.GetDataRate(i) && m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT])
 			{
-				int Type = m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT]->m_pAltSnap->GetExternalItemType(i);
+				int Type = m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT]->m_pAltSnap->GetExternalItemType(i, m_aapSnapshots[g_Config.m_ClDummy][IClient::SNAP_CURRENT]->m_pAltIndex);
 				if(Type == UUID_INVALID)
 				{
 					str_format(aBuffer, sizeof(aBuffer), "%5d %20s: %8d %8d %8d", i, "Unknown UUID", m_SnapshotDelta.GetDataRate(i) / 8, m_SnapshotDelta.GetDataUpdates(i),
@@ -2278,12 +2278,16 @@ int CClient::UnpackAndValidateSnapshot(CSnapshot *pFrom, CSnapshot *pTo)
 	Builder.Init();
 	CNetObjHandler *pNetObjHandler = GameClient()->GetNetObjHandler();
 
+	// extended item types are looked up by key for every item
+	CSnapshotIndexBuffer FromIndex;
+	FromIndex.Get()->Build(pFrom);
+
 	int Num = pFrom->NumItems();
 	for(int Index = 0; Index < Num; Index++)
 	{
 		CSnapshotItem *pFromItem = pFrom->GetItem(Index);
 		const int FromItemSize = pFrom->GetItemSize(Index);
-		const int ItemType = pFrom->GetItemType(Index);
+		const int ItemType = pFrom->GetItemType(Index, FromIndex.Get());
 		void *pData = pFromItem->Data();
 		Unpacker.Reset(pData, FromItemSize);
 
@@ -2620,6 +2624,7 @@ void CClient::OnDemoPlayerSnapshot(void *pData, int Size)
 	std::swap(m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV], m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]);
 	mem_copy(m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pSnap, pData, Size);
 	mem_copy(m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap, pAltSnapBuffer, AltSnapSize);
+	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltIndex->Build(m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap);
 
 	GameClient()->OnNewSnapshot();
 }
@@ -3940,12 +3945,16 @@ const char *CClient::DemoPlayer_Play(const char *pFilename, int StorageType)
 
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pSnap = (CSnapshot *)m_aaapDemorecSnapshotData[SNAP_CURRENT][0];
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap = (CSnapshot *)m_aaapDemorecSnapshotData[SNAP_CURRENT][1];
+	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltIndex = m_aDemorecSnapshotIndices[SNAP_CURRENT].Get();
+	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltIndex->Build(m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_pAltSnap);
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_SnapSize = 0;
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_AltSnapSize = 0;
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_CURRENT]->m_Tick = -1;
 
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pSnap = (CSnapshot *)m_aaapDemorecSnapshotData[SNAP_PREV][0];
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pAltSnap = (CSnapshot *)m_aaapDemorecSnapshotData[SNAP_PREV][1];
+	m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pAltIndex = m_aDemorecSnapshotIndices[SNAP_PREV].Get();
+	m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pAltIndex->Build(m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_pAltSnap);
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_SnapSize = 0;
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_AltSnapSize = 0;
 	m_aapSnapshots[g_Config.m_ClDummy][SNAP_PREV]->m_Tick = -1;
@@ -27,6 +27,10 @@
 
 #include "graphics_threaded.h"
 
+extern "C" {
+	#include <decomp/include/sm64shared.h>
+}
+
 class CSemaphore;
 
 static CVideoMode g_aFakeModes[] = {
@@ -3268,58 +3272,222 @@ void CGraphics_Threaded::firstInitMario(uint32_t* shader, uint32_t* texture, uin
 	WaitForIdle();
 }
 
-void CGraphics_Threaded::initMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry)
+// interleaves libsm64's separate position, normal, color and uv arrays
+static void FillMarioVertices(GL_SMarioVertex *pVertex, const SM64MarioGeometryBuffers *pGeometry, int FirstVertex, int NumVertices)
+{
+	for(int v = FirstVertex; v < FirstVertex + NumVertices; v++, pVertex++)
+	{
+		pVertex->m_Pos = vec3(pGeometry->position[v * 3], pGeometry->position[v * 3 + 1], pGeometry->position[v * 3 + 2]);
+		pVertex->m_Normal = vec3(pGeometry->normal[v * 3], pGeometry->normal[v * 3 + 1], pGeometry->normal[v * 3 + 2]);
+		pVertex->m_Color = GL_SColor(
+			round_to_int(clamp(pGeometry->color[v * 3], 0.0f, 1.0f) * 255.0f),
+			round_to_int(clamp(pGeometry->color[v * 3 + 1], 0.0f, 1.0f) * 255.0f),
+			round_to_int(clamp(pGeometry->color[v * 3 + 2], 0.0f, 1.0f) * 255.0f),
+			255);
+		pVertex->m_Tex = GL_STexCoord(pGeometry->uv[v * 2], pGeometry->uv[v * 2 + 1]);
+	}
+}
+
+void CGraphics_Threaded::AddMarioBatch(const CMarioRenderInfo *pMarios, int NumMarios, int NumVertices, uint32_t *pShader, uint32_t *pTexture)
 {
-	CCommandBuffer::SCommand_InitMario Cmd;
-	Cmd.m_Mesh = mesh;
-	Cmd.m_Geometry = geometry;
+	CCommandBuffer::SCommand_RenderMarios Cmd;
+	Cmd.m_State = m_State;
+	Cmd.m_NumVertices = NumVertices;
+	Cmd.m_NumDraws = NumMarios;
+	Cmd.m_ShaderHandle = pShader;
+	Cmd.m_TextureHandle = pTexture;
+
+	// the vertices are interleaved while copying, the backend uploads them with a single copy
+	const size_t DataSize = NumVertices * sizeof(GL_SMarioVertex) + NumMarios * sizeof(CCommandBuffer::SMarioDraw);
+	auto &&FillData = [&](void *pData) {
+		if(pData == 0x0)
+			return false;
+		Cmd.m_pVertices = (GL_SMarioVertex *)pData;
+		Cmd.m_pDraws = (CCommandBuffer::SMarioDraw *)(Cmd.m_pVertices + NumVertices);
+
+		GL_SMarioVertex *pVertex = Cmd.m_pVertices;
+		for(int i = 0; i < NumMarios; i++)
+		{
+			const SM64MarioGeometryBuffers *pGeometry = pMarios[i].m_pGeometry;
+			const int NumMarioVertices = pGeometry->numTrianglesUsed * 3;
+			Cmd.m_pDraws[i].m_FirstVertex = pVertex - Cmd.m_pVertices;
+			Cmd.m_pDraws[i].m_NumVertices = NumMarioVertices;
+			Cmd.m_pDraws[i].m_CapFlag = pMarios[i].m_CapFlag;
+			FillMarioVertices(pVertex, pGeometry, 0, NumMarioVertices);
+			pVertex += NumMarioVertices;
+		}
+		return true;
+	};
+
+	if(!FillData(AllocCommandBufferData(DataSize)))
+		return;
 
+	// check if we have enough free memory in the commandbuffer
 	if(!AddCmd(
-		   Cmd, [] { return true; }, "failed to add initMario command"))
+		   Cmd, [&] {
+			   if(!FillData(m_pCommandBuffer->AllocData(DataSize)))
+			   {
+				   dbg_msg("graphics", "failed to allocate data for the mario vertices");
+				   return false;
+			   }
+			   return true;
+		   },
+		   "failed to add renderMarios command"))
 	{
 		return;
 	}
 
-	// wait
-	KickCommandBuffer();
-	WaitForIdle();
+	m_pCommandBuffer->AddRenderCalls(NumMarios);
 }
 
-void CGraphics_Threaded::destroyMario(CMarioMesh* mesh)
+void CGraphics_Threaded::renderMarios(const CMarioRenderInfo* marios, int numMarios, uint32_t* shader, uint32_t* texture)
 {
-	CCommandBuffer::SCommand_DestroyMario Cmd;
-	Cmd.m_Mesh = mesh;
+	// as many Marios per command as fit into half of the data buffer, that is about 14 at Mario's usual triangle count
+	const int MaxBatchVertices = CMD_BUFFER_DATA_BUFFER_SIZE / 2 / sizeof(GL_SMarioVertex);
+	int First = 0;
+	while(First < numMarios)
+	{
+		int Last = First;
+		int NumVertices = 0;
+		while(Last < numMarios)
+		{
+			const int NumMarioVertices = marios[Last].m_pGeometry->numTrianglesUsed * 3;
+			if(Last > First && NumVertices + NumMarioVertices > MaxBatchVertices)
+				break;
+			NumVertices += NumMarioVertices;
+			Last++;
+		}
+		AddMarioBatch(marios + First, Last - First, NumVertices, shader, texture);
+		First = Last;
+	}
+}
+
+void CGraphics_Threaded::uploadMarioBindPose(const SM64MarioGeometryBuffers* bindPose, int firstTriangle)
+{
+	CCommandBuffer::SCommand_UploadMarioBindPose Cmd;
+	Cmd.m_FirstVertex = firstTriangle * 3;
+	Cmd.m_NumVertices = (bindPose->numTrianglesUsed - firstTriangle) * 3;
+	if(Cmd.m_NumVertices <= 0)
+		return;
+
+	const size_t DataSize = Cmd.m_NumVertices * sizeof(GL_SMarioVertex);
+	auto &&FillData = [&](void *pData) {
+		if(pData == 0x0)
+			return false;
+		Cmd.m_pVertices = (GL_SMarioVertex *)pData;
+		FillMarioVertices(Cmd.m_pVertices, bindPose, Cmd.m_FirstVertex, Cmd.m_NumVertices);
+		return true;
+	};
+
+	if(!FillData(AllocCommandBufferData(DataSize)))
+		return;
 
 	if(!AddCmd(
-		   Cmd, [] { return true; }, "failed to add destroyMario command"))
+		   Cmd, [&] {
+			   if(!FillData(m_pCommandBuffer->AllocData(DataSize)))
+			   {
+				   dbg_msg("graphics", "failed to allocate data for the mario bind pose");
+				   return false;
+			   }
+			   return true;
+		   },
+		   "failed to add uploadMarioBindPose command"))
 	{
 		return;
 	}
-
-	// wait
-	KickCommandBuffer();
-	WaitForIdle();
 }
 
-void CGraphics_Threaded::updateAndRenderMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry, uint32_t capFlag, uint32_t* shader, uint32_t* texture, uint16_t* indices)
+void CGraphics_Threaded::AddMarioPoseBatch(const CMarioPoseRenderInfo *pMarios, int NumMarios, int NumParts, uint32_t *pShader, uint32_t *pTexture)
 {
-	CCommandBuffer::SCommand_UpdateAndRenderMario Cmd;
-	Cmd.m_Mesh = mesh;
-	Cmd.m_Geometry = geometry;
-	Cmd.m_CapFlag = capFlag;
-	Cmd.m_ShaderHandle = shader;
-	Cmd.m_TextureHandle = texture;
-	Cmd.m_Indices = indices;
+	CCommandBuffer::SCommand_RenderMarioPoses Cmd;
+	Cmd.m_State = m_State;
+	Cmd.m_NumMarios = NumMarios;
+	Cmd.m_NumParts = NumParts;
+	Cmd.m_ShaderHandle = pShader;
+	Cmd.m_TextureHandle = pTexture;
+
+	const size_t DataSize = NumMarios * sizeof(CCommandBuffer::SMarioPoseDraw) + NumParts * sizeof(CCommandBuffer::SMarioPartDraw);
+	auto &&FillData = [&](void *pData) {
+		if(pData == 0x0)
+			return false;
+		Cmd.m_pParts = (CCommandBuffer::SMarioPartDraw *)pData;
+		Cmd.m_pMarios = (CCommandBuffer::SMarioPoseDraw *)(Cmd.m_pParts + NumParts);
+
+		CCommandBuffer::SMarioPartDraw *pPart = Cmd.m_pParts;
+		for(int i = 0; i < NumMarios; i++)
+		{
+			const CMarioPoseRenderInfo &Info = pMarios[i];
+			CCommandBuffer::SMarioPoseDraw &Mario = Cmd.m_pMarios[i];
+			Mario.m_FirstPart = pPart - Cmd.m_pParts;
+			Mario.m_CapFlag = Info.m_CapFlag;
+			Mario.m_CustomColors = Info.m_CustomColors;
+			Mario.m_BodyColor = Info.m_BodyColor;
+			Mario.m_FeetColor = Info.m_FeetColor;
+
+			// like in the whole mesh, the parts of the last 8 triangles drawn are the wings
+			int NumTriangles = 0;
+			for(int p = 0; p < Info.m_pPose->numPartsUsed; p++)
+				NumTriangles += Info.m_pPose->parts[p].numTriangles;
+			const int FirstWingTriangle = (Info.m_CapFlag & MARIO_WING_CAP) ? NumTriangles - 8 : NumTriangles;
+
+			int Triangles = 0;
+			for(int p = 0; p < Info.m_pPose->numPartsUsed; p++)
+			{
+				const SM64MarioPart &Part = Info.m_pPose->parts[p];
+				if(Part.numTriangles == 0)
+					continue;
+				mem_copy(pPart->m_aTransform, Part.transform, sizeof(pPart->m_aTransform));
+				pPart->m_FirstVertex = Part.firstTriangle * 3;
+				pPart->m_NumVertices = Part.numTriangles * 3;
+				pPart->m_WingCap = Triangles >= FirstWingTriangle;
+				Triangles += Part.numTriangles;
+				pPart++;
+			}
+			Mario.m_NumParts = pPart - Cmd.m_pParts - Mario.m_FirstPart;
+		}
+		Cmd.m_NumParts = pPart - Cmd.m_pParts;
+		return true;
+	};
+
+	if(!FillData(AllocCommandBufferData(DataSize)))
+		return;
 
 	if(!AddCmd(
-		   Cmd, [] { return true; }, "failed to add updateAndRenderMario command"))
+		   Cmd, [&] {
+			   if(!FillData(m_pCommandBuffer->AllocData(DataSize)))
+			   {
+				   dbg_msg("graphics", "failed to allocate data for the mario poses");
+				   return false;
+			   }
+			   return true;
+		   },
+		   "failed to add renderMarioPoses command"))
 	{
 		return;
 	}
 
-	// wait
-	KickCommandBuffer();
-	WaitForIdle();
+	m_pCommandBuffer->AddRenderCalls(Cmd.m_NumParts);
+}
+
+void CGraphics_Threaded::renderMarioPoses(const CMarioPoseRenderInfo* marios, int numMarios, uint32_t* shader, uint32_t* texture)
+{
+	const int MaxBatchParts = CMD_BUFFER_DATA_BUFFER_SIZE / 2 / sizeof(CCommandBuffer::SMarioPartDraw);
+	int First = 0;
+	while(First < numMarios)
+	{
+		int Last = First;
+		int NumParts = 0;
+		while(Last < numMarios)
+		{
+			const int NumMarioParts = marios[Last].m_pPose->numPartsUsed;
+			if(Last > First && NumParts + NumMarioParts > MaxBatchParts)
+				break;
+			NumParts += NumMarioParts;
+			Last++;
+		}
+		AddMarioPoseBatch(marios + First, Last - First, NumParts, shader, texture);
+		First = Last;
+	}
 }
 
 extern IEngineGraphics *CreateEngineGraphicsThreaded()
@@ -139,9 +139,9 @@ public:
 
 		// mario
 		CMD_MARIO_FIRST_INIT,
-		CMD_MARIO_INIT,
-		CMD_MARIO_DESTROY,
-		CMD_MARIO_UPDATE_AND_RENDER,
+		CMD_MARIO_RENDER,
+		CMD_MARIO_UPLOAD_BIND_POSE,
+		CMD_MARIO_RENDER_POSES,
 
 		CMD_COUNT,
 	};
@@ -647,34 +647,67 @@ public:
 		const char *m_ShaderCode;
 	};
 
-	struct SCommand_InitMario : public CCommandBuffer::SCommand
+	struct SMarioDraw
 	{
-		SCommand_InitMario() :
-			SCommand(CMD_MARIO_INIT) {}
+		int m_FirstVertex;
+		int m_NumVertices;
+		uint32_t m_CapFlag;
+	};
+
+	struct SCommand_RenderMarios : public CCommandBuffer::SCommand
+	{
+		SCommand_RenderMarios() :
+			SCommand(CMD_MARIO_RENDER) {}
 
-		CMarioMesh *m_Mesh;
-		SM64MarioGeometryBuffers *m_Geometry;
+		SState m_State;
+		GL_SMarioVertex *m_pVertices; // in the command buffer's data
+		int m_NumVertices;
+		SMarioDraw *m_pDraws;
+		int m_NumDraws;
+		uint32_t *m_ShaderHandle;
+		uint32_t *m_TextureHandle;
 	};
 
-	struct SCommand_DestroyMario : public CCommandBuffer::SCommand
+	struct SCommand_UploadMarioBindPose : public CCommandBuffer::SCommand
 	{
-		SCommand_DestroyMario() :
-			SCommand(CMD_MARIO_DESTROY) {}
+		SCommand_UploadMarioBindPose() :
+			SCommand(CMD_MARIO_UPLOAD_BIND_POSE) {}
 
-		CMarioMesh *m_Mesh;
+		GL_SMarioVertex *m_pVertices; // in the command buffer's data
+		int m_FirstVertex; // the bind pose only grows, the vertices before it were uploaded already
+		int m_NumVertices;
 	};
 
-	struct SCommand_UpdateAndRenderMario : public CCommandBuffer::SCommand
+	struct SMarioPartDraw
 	{
-		SCommand_UpdateAndRenderMario() :
-			SCommand(CMD_MARIO_UPDATE_AND_RENDER) {}
+		float m_aTransform[16]; // column-major, from the part's space in the bind pose to world space
+		int m_FirstVertex;
+		int m_NumVertices;
+		bool m_WingCap; // the wings are drawn without the white rectangles around the feathers
+	};
 
-		CMarioMesh *m_Mesh;
-		SM64MarioGeometryBuffers *m_Geometry;
+	struct SMarioPoseDraw
+	{
+		int m_FirstPart;
+		int m_NumParts;
 		uint32_t m_CapFlag;
+		bool m_CustomColors;
+		ColorRGBA m_BodyColor;
+		ColorRGBA m_FeetColor;
+	};
+
+	struct SCommand_RenderMarioPoses : public CCommandBuffer::SCommand
+	{
+		SCommand_RenderMarioPoses() :
+			SCommand(CMD_MARIO_RENDER_POSES) {}
+
+		SState m_State;
+		SMarioPoseDraw *m_pMarios; // in the command buffer's data
+		int m_NumMarios;
+		SMarioPartDraw *m_pParts;
+		int m_NumParts;
 		uint32_t *m_ShaderHandle;
 		uint32_t *m_TextureHandle;
-		uint16_t *m_Indices;
 	};
 
 	//
@@ -820,9 +853,7 @@ public:
 
 	// mario
 	virtual void firstInitMario(uint32_t* shader, uint32_t* texture, uint8_t* marioTexture, const char *shaderCode) {}
-	virtual void initMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry) {}
-	virtual void destroyMario(CMarioMesh* mesh) {}
-	virtual void updateAndRenderMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry, uint32_t capFlag, uint32_t* shader, uint32_t* texture, uint16_t* indices) {}
+	virtual void renderMarios(const CMarioRenderInfo* marios, int numMarios, uint32_t* shader, uint32_t* texture) {}
 };
 
 class CGraphics_Threaded : public IEngineGraphics
@@ -983,6 +1014,9 @@ class CGraphics_Threaded : public IEngineGraphics
 
 	void KickCommandBuffer();
 
+	void AddMarioBatch(const CMarioRenderInfo *pMarios, int NumMarios, int NumVertices, uint32_t *pShader, uint32_t *pTexture);
+	void AddMarioPoseBatch(const CMarioPoseRenderInfo *pMarios, int NumMarios, int NumParts, uint32_t *pShader, uint32_t *pTexture);
+
 	void AddBackEndWarningIfExists();
 
 	void AdjustViewport(bool SendViewportChangeToBackend);
@@ -1367,9 +1401,9 @@ public:
 
 	// mario
 	void firstInitMario(uint32_t* shader, uint32_t* texture, uint8_t* marioTexture, const char *shaderCode) override;
-	void initMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry) override;
-	void destroyMario(CMarioMesh* mesh) override;
-	void updateAndRenderMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry, uint32_t capFlag, uint32_t* shader, uint32_t* texture, uint16_t* indices) override;
+	void renderMarios(const CMarioRenderInfo* marios, int numMarios, uint32_t* shader, uint32_t* texture) override;
+	void uploadMarioBindPose(const SM64MarioGeometryBuffers* bindPose, int firstTriangle) override;
+	void renderMarioPoses(const CMarioPoseRenderInfo* marios, int numMarios, uint32_t* shader, uint32_t* texture) override;
 };
 
 extern IGraphicsBackend *CreateGraphicsBackend();
@@ -9,6 +9,7 @@
 
 #include <engine/shared/config.h>
 #include <mutex>
+#include <vector>
 
 #include "SDL.h"
 
@@ -82,6 +83,17 @@ static int m_NextVoice = 0;
 static int *m_pMixBuffer = 0; // buffer only used by the thread callback function
 static uint32_t m_MaxFrames = 0;
 
+// the stream is pulled by the mixer and resampled to the mixing rate
+static std::mutex s_StreamLock;
+static ISound::FStreamCallback s_pfnStreamCallback = nullptr;
+static void *s_pStreamUser = nullptr;
+static int s_StreamChannel = 0;
+static unsigned s_StreamStep = 0; // source frames per mixed frame, 16.16 fixed point
+static unsigned s_StreamPhase = 0; // position after the first carried frame, 16.16 fixed point
+static short s_aStreamCarry[2 * 2] = {0}; // source frames the next mix still interpolates from
+static int s_NumStreamCarry = 1;
+static std::vector<short> s_vStreamFrames;
+
 static const void *s_pWVBuffer = 0x0;
 static int s_WVBufferPosition = 0;
 static int s_WVBufferSize = 0;
@@ -96,6 +108,40 @@ static int IntAbs(int i)
 	return i;
 }
 
+static void MixStream(unsigned Frames)
+{
+	std::lock_guard<std::mutex> Lock(s_StreamLock);
+	if(!s_pfnStreamCallback || Frames == 0)
+		return;
+
+	// interpolation reads up to the frame after the last position, the next mix starts at the end position
+	const uint64_t LastPos = s_StreamPhase + (uint64_t)s_StreamStep * (Frames - 1);
+	const uint64_t EndPos = LastPos + s_StreamStep;
+	const unsigned EndFrame = EndPos >> 16;
+	const unsigned NumFrames = maximum<unsigned>((LastPos >> 16) + 2, EndFrame + 1);
+	if(NumFrames * 2 > s_vStreamFrames.size())
+		return;
+
+	short *pFrames = s_vStreamFrames.data();
+	mem_copy(pFrames, s_aStreamCarry, s_NumStreamCarry * 2 * sizeof(short));
+	s_pfnStreamCallback(pFrames + s_NumStreamCarry * 2, NumFrames - s_NumStreamCarry, s_pStreamUser);
+
+	const int Vol = m_aChannels[s_StreamChannel].m_Vol;
+	int *pOut = m_pMixBuffer;
+	uint64_t Pos = s_StreamPhase;
+	for(unsigned i = 0; i < Frames; i++, Pos += s_StreamStep)
+	{
+		const short *pA = &pFrames[(Pos >> 16) * 2];
+		const int Frac = Pos & 0xffff;
+		*pOut++ += (pA[0] + (int)(((int64_t)(pA[2] - pA[0]) * Frac) >> 16)) * Vol;
+		*pOut++ += (pA[1] + (int)(((int64_t)(pA[3] - pA[1]) * Frac) >> 16)) * Vol;
+	}
+
+	s_NumStreamCarry = NumFrames - EndFrame;
+	mem_copy(s_aStreamCarry, &pFrames[EndFrame * 2], s_NumStreamCarry * 2 * sizeof(short));
+	s_StreamPhase = EndPos & 0xffff;
+}
+
 static void Mix(short *pFinalOut, unsigned Frames)
 {
 	Frames = minimum(Frames, m_MaxFrames);
@@ -249,6 +295,9 @@ static void Mix(short *pFinalOut, unsigned Frames)
 	// release the lock
 	m_SoundLock.unlock();
 
+	// generating the stream can take a while, don't block the voices for it
+	MixStream(Frames);
+
 	// clamp accumulated values
 	for(unsigned i = 0; i < Frames * 2; i++)
 		pFinalOut[i] = clamp<int>(((m_pMixBuffer[i] * MasterVol) / 101) >> 8, std::numeric_limits<short>::min(), std::numeric_limits<short>::max());
@@ -957,6 +1006,20 @@ bool CSound::IsPlaying(int SampleID)
 	return std::any_of(std::begin(m_aVoices), std::end(m_aVoices), [pSample](const auto &Voice) { return Voice.m_pSample == pSample; });
 }
 
+void CSound::SetStream(int ChannelID, int Rate, FStreamCallback pfnCallback, void *pUser)
+{
+	std::lock_guard<std::mutex> Lock(s_StreamLock);
+	s_pfnStreamCallback = pfnCallback;
+	s_pStreamUser = pUser;
+	s_StreamChannel = ChannelID;
+	s_StreamStep = ((uint64_t)Rate << 16) / m_MixingRate;
+	s_StreamPhase = 0;
+	mem_zero(s_aStreamCarry, sizeof(s_aStreamCarry));
+	s_NumStreamCarry = 1;
+	// enough for the largest mix plus the carried frames
+	s_vStreamFrames.resize(pfnCallback ? ((uint64_t)m_MaxFrames * s_StreamStep / 65536 + 4) * 2 : 0);
+}
+
 ISoundMixFunc CSound::GetSoundMixFunc()
 {
 	return Mix;
@@ -61,6 +61,8 @@ public:
 	void StopVoice(CVoiceHandle Voice) override;
 	bool IsPlaying(int SampleID) override;
 
+	void SetStream(int ChannelID, int Rate, FStreamCallback pfnCallback, void *pUser) override;
+
 	ISoundMixFunc GetSoundMixFunc() override;
 	void PauseAudioDevice() override;
 	void UnpauseAudioDevice() override;
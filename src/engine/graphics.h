@@ -67,10 +67,20 @@ struct SGraphicTileTexureCoords
 	vec3 m_TexCoordBottomLeft;
 };
 
-struct CMarioMesh
+struct CMarioRenderInfo
 {
-	uint32_t position_buffer, normal_buffer, color_buffer, uv_buffer;
-	uint32_t vao;
+	const SM64MarioGeometryBuffers *m_pGeometry;
+	uint32_t m_CapFlag;
+};
+
+// a Mario drawn from the bind pose uploaded with IGraphics::uploadMarioBindPose, the pose's transforms are in world space
+struct CMarioPoseRenderInfo
+{
+	const SM64MarioPose *m_pPose;
+	uint32_t m_CapFlag;
+	bool m_CustomColors;
+	ColorRGBA m_BodyColor;
+	ColorRGBA m_FeetColor;
 };
 
 class CImageInfo
@@ -162,6 +172,14 @@ struct GL_SVertexTex3DStream
 	GL_STexCoord3D m_Tex;
 };
 
+struct GL_SMarioVertex
+{
+	vec3 m_Pos;
+	vec3 m_Normal;
+	GL_SColor m_Color;
+	GL_STexCoord m_Tex;
+};
+
 static constexpr size_t gs_GraphicsMaxQuadsRenderCount = 256;
 static constexpr size_t gs_GraphicsMaxParticlesRenderCount = 512;
 
@@ -523,9 +541,11 @@ public:
 
 	// mario
 	virtual void firstInitMario(uint32_t* shader, uint32_t* texture, uint8_t* marioTexture, const char *shaderCode) = 0;
-	virtual void initMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry) = 0;
-	virtual void destroyMario(CMarioMesh* mesh) = 0;
-	virtual void updateAndRenderMario(CMarioMesh* mesh, SM64MarioGeometryBuffers* geometry, uint32_t capFlag, uint32_t* shader, uint32_t* texture, uint16_t* indices) = 0;
+	// draws all Marios of the frame in as few commands as the command buffer allows, the geometry is copied
+	virtual void renderMarios(const CMarioRenderInfo* marios, int numMarios, uint32_t* shader, uint32_t* texture) = 0;
+	// GPU skinning: the bind pose mesh only grows and is uploaded once, each frame only the transforms of the Marios' parts are sent
+	virtual void uploadMarioBindPose(const SM64MarioGeometryBuffers* bindPose, int firstTriangle) = 0;
+	virtual void renderMarioPoses(const CMarioPoseRenderInfo* marios, int numMarios, uint32_t* shader, uint32_t* texture) = 0;
 
 protected:
 	inline CTextureHandle CreateTextureHandle(int Index)
@@ -20,6 +20,7 @@
 
 #include <game/version.h>
 
+#include <thread>
 #include <vector>
 
 #if defined(CONF_FAMILY_WINDOWS)
@@ -101,7 +102,8 @@ int main(int argc, const char **argv)
 	IKernel *pKernel = IKernel::Create();
 
 	// create the components
-	IEngine *pEngine = CreateEngine(GAME_NAME, pFutureConsoleLogger, 2);
+	// the job pool also ticks Marios in parallel, see CGameWorld::TickMarios
+	IEngine *pEngine = CreateEngine(GAME_NAME, pFutureConsoleLogger, maximum(2, (int)std::thread::hardware_concurrency()));
 	IEngineMap *pEngineMap = CreateEngineMap();
 	IGameServer *pGameServer = CreateGameServer();
 	IConsole *pConsole = CreateConsole(CFGFLAG_SERVER | CFGFLAG_ECON);
@@ -314,6 +314,15 @@ CServer::CServer()
 		m_aDemoRecorder[i] = CDemoRecorder(&m_SnapshotDelta, true);
 	m_aDemoRecorder[MAX_CLIENTS] = CDemoRecorder(&m_SnapshotDelta, false);
 
+	m_NumSnapshotTasks = 0;
+	m_NumSnapshotThreads = 0;
+	m_NumSnapshotDeltas = 0;
+	m_NumReusedSnapshotDeltas = 0;
+	m_NumReusedSnapshotCompressions = 0;
+	m_SnapshotDeltaBytes = 0;
+	mem_zero(&m_PrevNetworkStats, sizeof(m_PrevNetworkStats));
+	m_PrevNetworkStatsTick = 0;
+
 	m_TickSpeed = SERVER_TICK_SPEED;
 
 	m_pGameServer = 0;
@@ -882,10 +891,73 @@ void CServer::SendMsgRaw(int ClientID, const void *pData, int Size, int Flags)
 	m_NetServer.Send(&Packet);
 }
 
+class CSnapshotJob : public IJob
+{
+	CServer *m_pServer;
+	int m_Pass;
+
+	void Run() override
+	{
+		m_pServer->RunSnapshotTasks(m_Pass);
+		m_pServer->m_SnapshotTasksDone.Signal();
+	}
+
+public:
+	CSnapshotJob(CServer *pServer, int Pass) :
+		m_pServer(pServer), m_Pass(Pass)
+	{
+	}
+};
+
+void CServer::RunSnapshotTasks(int Pass)
+{
+	for(int i = m_NextSnapshotTask++; i < m_NumSnapshotTasks; i = m_NextSnapshotTask++)
+	{
+		CSnapshotTask &Task = m_aSnapshotTasks[i];
+		if(Pass == SNAPSHOT_PASS_DELTA && Task.m_DeltaTask == -1)
+		{
+			// create delta
+			CSnapshotDelta &Delta = m_aClients[Task.m_ClientID].m_Sixup ? m_SnapshotDeltaSixup : m_SnapshotDelta;
+			Task.m_vDelta.resize(CSnapshot::MAX_SIZE);
+			Task.m_DeltaSize = Delta.CreateDelta(Task.m_pDeltashot, Task.m_pSnapshot, Task.m_vDelta.data());
+			Task.m_DeltaHash = crc32(0, (const Bytef *)Task.m_vDelta.data(), Task.m_DeltaSize);
+		}
+		else if(Pass == SNAPSHOT_PASS_COMPRESS && Task.m_DeltaSize && Task.m_CompressedTask == -1)
+		{
+			// compress it
+			char aCompData[CSnapshot::MAX_SIZE];
+			Task.m_CompressedSize = CVariableInt::Compress(Task.m_vDelta.data(), Task.m_DeltaSize, aCompData, sizeof(aCompData));
+			Task.m_vCompressed.assign(aCompData, aCompData + Task.m_CompressedSize);
+		}
+	}
+}
+
+void CServer::RunSnapshotPass(int Pass)
+{
+	// the snapshot threads help if there are any
+	m_NextSnapshotTask = 0;
+	int NumJobs = minimum(m_NumSnapshotThreads, m_NumSnapshotTasks - 1);
+	for(int i = 0; i < NumJobs; i++)
+		m_SnapshotJobPool.Add(std::make_shared<CSnapshotJob>(this, Pass));
+	RunSnapshotTasks(Pass);
+	for(int i = 0; i < NumJobs; i++)
+		m_SnapshotTasksDone.Wait();
+}
+
+static bool SameSnapshot(const CSnapshot *pA, int SizeA, const CSnapshot *pB, int SizeB)
+{
+	return pA == pB || (SizeA == SizeB && mem_comp(pA, pB, SizeA) == 0);
+}
+
 void CServer::DoSnapshot()
 {
 	GameServer()->OnPreSnap();
 
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, false);
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, false);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
+
 	// create snapshot for demo recording
 	if(m_aDemoRecorder[MAX_CLIENTS].IsRecording())
 	{
@@ -901,6 +973,7 @@ void CServer::DoSnapshot()
 	}
 
 	// create snapshots for all clients
+	m_NumSnapshotTasks = 0;
 	for(int i = 0; i < MaxClients(); i++)
 	{
 		// client must be ingame to receive snapshots
@@ -946,70 +1019,133 @@ void CServer::DoSnapshot()
 
 			int DeltaTick = -1;
 			CSnapshot *pDeltashot = &s_EmptySnap;
+			int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
+			if(DeltashotSize >= 0)
+				DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+			else
 			{
-				int DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
-				else
-				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
-				}
+				// no acked package found, force client to recover rate
+				if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
+					m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
 			}
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			int DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+			CSnapshotTask &Task = m_aSnapshotTasks[m_NumSnapshotTasks++];
+			Task.m_ClientID = i;
+			Task.m_DeltaTick = DeltaTick;
+			Task.m_Crc = Crc;
+			Task.m_pSnapshot = m_aClients[i].m_Snapshots.m_pLast->m_pSnap;
+			Task.m_SnapshotSize = SnapshotSize;
+			Task.m_pDeltashot = pDeltashot;
+			Task.m_DeltashotSize = maximum(DeltashotSize, 0);
+		}
+	}
 
-			if(DeltaSize)
+	// clients that acked the same tick of the same snapshots, like spectators of the same player, get the same delta
+	for(int t = 0; t < m_NumSnapshotTasks; t++)
+	{
+		CSnapshotTask &Task = m_aSnapshotTasks[t];
+		Task.m_DeltaTask = -1;
+		Task.m_CompressedTask = -1;
+		for(int Other = 0; Other < t; Other++)
+		{
+			const CSnapshotTask &OtherTask = m_aSnapshotTasks[Other];
+			if(OtherTask.m_DeltaTask == -1 && OtherTask.m_DeltaTick == Task.m_DeltaTick && OtherTask.m_Crc == Task.m_Crc &&
+				m_aClients[OtherTask.m_ClientID].m_Sixup == m_aClients[Task.m_ClientID].m_Sixup &&
+				SameSnapshot(OtherTask.m_pSnapshot, OtherTask.m_SnapshotSize, Task.m_pSnapshot, Task.m_SnapshotSize) &&
+				SameSnapshot(OtherTask.m_pDeltashot, OtherTask.m_DeltashotSize, Task.m_pDeltashot, Task.m_DeltashotSize))
 			{
-				// compress it
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-
-				char aCompData[CSnapshot::MAX_SIZE];
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+				Task.m_DeltaTask = Other;
+				break;
+			}
+		}
+	}
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	RunSnapshotPass(SNAPSHOT_PASS_DELTA);
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
+	// different delta snapshots can still give the same delta, only compress it once
+	for(int t = 0; t < m_NumSnapshotTasks; t++)
+	{
+		CSnapshotTask &Task = m_aSnapshotTasks[t];
+		m_NumSnapshotDeltas++;
+		if(Task.m_DeltaTask != -1)
+		{
+			const CSnapshotTask &DeltaTask = m_aSnapshotTasks[Task.m_DeltaTask];
+			Task.m_DeltaSize = DeltaTask.m_DeltaSize;
+			Task.m_CompressedTask = DeltaTask.m_CompressedTask == -1 ? Task.m_DeltaTask : DeltaTask.m_CompressedTask;
+			m_NumReusedSnapshotDeltas++;
+			m_SnapshotDeltaBytes += Task.m_DeltaSize;
+			continue;
+		}
+		m_SnapshotDeltaBytes += Task.m_DeltaSize;
+		if(!Task.m_DeltaSize)
+			continue;
+		for(int Other = 0; Other < t; Other++)
+		{
+			const CSnapshotTask &OtherTask = m_aSnapshotTasks[Other];
+			if(OtherTask.m_DeltaTask == -1 && OtherTask.m_CompressedTask == -1 && OtherTask.m_DeltaSize == Task.m_DeltaSize && OtherTask.m_DeltaHash == Task.m_DeltaHash &&
+				mem_comp(OtherTask.m_vDelta.data(), Task.m_vDelta.data(), Task.m_DeltaSize) == 0)
+			{
+				Task.m_CompressedTask = Other;
+				m_NumReusedSnapshotCompressions++;
+				break;
 			}
-			else
+		}
+	}
+
+	RunSnapshotPass(SNAPSHOT_PASS_COMPRESS);
+
+	// send them in client order
+	for(int t = 0; t < m_NumSnapshotTasks; t++)
+	{
+		const CSnapshotTask &Task = m_aSnapshotTasks[t];
+		const CSnapshotTask &Compressed = Task.m_CompressedTask == -1 ? Task : m_aSnapshotTasks[Task.m_CompressedTask];
+		const int i = Task.m_ClientID;
+		const int DeltaTick = Task.m_DeltaTick;
+		const int Crc = Task.m_Crc;
+
+		if(Task.m_DeltaSize)
+		{
+			const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+			const int SnapshotSize = Compressed.m_CompressedSize;
+			const char *pCompData = Compressed.m_vCompressed.data();
+			int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+
+			for(int n = 0, Left = SnapshotSize; Left > 0; n++)
 			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				int Chunk = Left < MaxSize ? Left : MaxSize;
+				Left -= Chunk;
+
+				if(NumPackets == 1)
+				{
+					CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick - DeltaTick);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				}
+				else
+				{
+					CMsgPacker Msg(NETMSG_SNAP, true);
+					Msg.AddInt(m_CurrentGameTick);
+					Msg.AddInt(m_CurrentGameTick - DeltaTick);
+					Msg.AddInt(NumPackets);
+					Msg.AddInt(n);
+					Msg.AddInt(Crc);
+					Msg.AddInt(Chunk);
+					Msg.AddRaw(&pCompData[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				}
 			}
 		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+			Msg.AddInt(m_CurrentGameTick);
+			Msg.AddInt(m_CurrentGameTick - DeltaTick);
+			SendMsg(&Msg, MSGFLAG_FLUSH, i);
+		}
 	}
 
 	GameServer()->OnPostSnap();
@@ -2539,6 +2675,9 @@ int CServer::Run()
 		return -1;
 	}
 
+	m_NumSnapshotThreads = Config()->m_SvSnapshotThreads;
+	m_SnapshotJobPool.Init(m_NumSnapshotThreads);
+
 	if(Config()->m_SvSqliteFile[0] != '\0')
 	{
 		auto pSqliteConn = CreateSqliteConnection(Config()->m_SvSqliteFile, true);
@@ -2666,15 +2805,11 @@ int CServer::Run()
 		}
 		else
 		{
-			// Mario texture is 704x64 RGBA (it won't be used)
-			uint8_t *texture = (uint8_t*)malloc(4 * SM64_TEXTURE_WIDTH * SM64_TEXTURE_HEIGHT);
-
-			// load libsm64
+			// load libsm64. nothing is played or rendered on the server, so skip the audio thread and Mario's texture
 			sm64_global_terminate();
-			sm64_global_init(romBuffer, texture, [](const char *msg) {dbg_msg("libsm64", "%s", msg);});
+			sm64_global_init_headless(romBuffer, [](const char *msg) {dbg_msg("libsm64", "%s", msg);});
 			dbg_msg("libsm64", "Super Mario 64 US ROM loaded!");
 			free(romBuffer);
-			free(texture);
 		}
 	}
 
@@ -2838,6 +2973,9 @@ int CServer::Run()
 				}
 			}
 
+			// the snapshots and everything else sent until the wait are sent together
+			net_udp_batch_begin(m_NetServer.Socket());
+
 			// snap game
 			if(NewTicks)
 			{
@@ -2862,6 +3000,8 @@ int CServer::Run()
 			if(!NonActive)
 				PumpNetwork(PacketWaiting);
 
+			net_udp_batch_end(m_NetServer.Socket());
+
 			NonActive = true;
 
 			for(auto &Client : m_aClients)
@@ -3429,6 +3569,34 @@ void CServer::ConShowIps(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConSnapshotStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	char aBuf[256];
+	const double Deltas = maximum(pThis->m_NumSnapshotDeltas, (int64_t)1);
+	str_format(aBuf, sizeof(aBuf), "deltas=%" PRId64 " delta_bytes=%" PRId64 " reused_deltas=%" PRId64 " (%.1f%%) reused_compressions=%" PRId64 " (%.1f%%)",
+		pThis->m_NumSnapshotDeltas, pThis->m_SnapshotDeltaBytes,
+		pThis->m_NumReusedSnapshotDeltas, 100.0 * pThis->m_NumReusedSnapshotDeltas / Deltas,
+		pThis->m_NumReusedSnapshotCompressions, 100.0 * pThis->m_NumReusedSnapshotCompressions / Deltas);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+}
+
+void CServer::ConNetworkStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	NETSTATS Stats;
+	net_stats(&Stats);
+	const int Ticks = maximum(pThis->m_CurrentGameTick - pThis->m_PrevNetworkStatsTick, 1);
+	const NETSTATS &Prev = pThis->m_PrevNetworkStats;
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "per tick over %d ticks: sent packets=%.1f bytes=%.0f syscalls=%.1f, received packets=%.1f bytes=%.0f syscalls=%.1f",
+		Ticks, (double)(Stats.sent_packets - Prev.sent_packets) / Ticks, (double)(Stats.sent_bytes - Prev.sent_bytes) / Ticks, (double)(Stats.send_syscalls - Prev.send_syscalls) / Ticks,
+		(double)(Stats.recv_packets - Prev.recv_packets) / Ticks, (double)(Stats.recv_bytes - Prev.recv_bytes) / Ticks, (double)(Stats.recv_syscalls - Prev.recv_syscalls) / Ticks);
+	pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "server", aBuf);
+	pThis->m_PrevNetworkStats = Stats;
+	pThis->m_PrevNetworkStatsTick = pThis->m_CurrentGameTick;
+}
+
 void CServer::ConAddSqlServer(IConsole::IResult *pResult, void *pUserData)
 {
 	CServer *pSelf = (CServer *)pUserData;
@@ -3710,6 +3878,8 @@ void CServer::RegisterCommands()
 	Console()->Register("shutdown", "?r[reason]", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
+	Console()->Register("snapshot_stats", "", CFGFLAG_SERVER, ConSnapshotStats, this, "Show how many snapshot deltas were reused from clients with the same snapshots, and how many identical deltas weren't compressed again");
+	Console()->Register("network_stats", "", CFGFLAG_SERVER, ConNetworkStats, this, "Show packets, bytes and system calls per tick since the last call");
 
 	Console()->Register("record", "?s[file]", CFGFLAG_SERVER | CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
@@ -3771,6 +3941,7 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	m_SnapshotDeltaSixup.SetStaticsize(ItemType, Size);
 }
 
 CServer *CreateServer() { return new CServer(); }
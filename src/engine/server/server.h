@@ -4,6 +4,7 @@
 #define ENGINE_SERVER_SERVER_H
 
 #include <base/hash.h>
+#include <base/tl/threading.h>
 
 #include <engine/console.h>
 #include <engine/server.h>
@@ -11,12 +12,14 @@
 #include <engine/shared/demo.h>
 #include <engine/shared/econ.h>
 #include <engine/shared/fifo.h>
+#include <engine/shared/jobs.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
 #include <engine/shared/uuid_manager.h>
 
+#include <atomic>
 #include <list>
 #include <memory>
 #include <vector>
@@ -217,7 +220,52 @@ public:
 	int m_aIdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
+	CSnapshotDelta m_SnapshotDeltaSixup;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// a client's snapshot of this tick, built on the main thread. The delta is created and compressed
+	// by RunSnapshotTasks, possibly on the snapshot threads, then it's sent on the main thread in client order
+	class CSnapshotTask
+	{
+	public:
+		int m_ClientID;
+		int m_DeltaTick;
+		int m_Crc;
+		CSnapshot *m_pSnapshot;
+		int m_SnapshotSize;
+		CSnapshot *m_pDeltashot;
+		int m_DeltashotSize;
+		int m_DeltaSize; // 0 if nothing changed
+		unsigned m_DeltaHash;
+		std::vector<char> m_vDelta;
+		int m_DeltaTask; // an earlier task with the same snapshot and delta snapshot, its delta is used instead of creating one, -1 if none
+		int m_CompressedTask; // an earlier task whose compressed delta is sent instead of compressing this one, -1 if none
+		int m_CompressedSize;
+		std::vector<char> m_vCompressed;
+	};
+	enum
+	{
+		SNAPSHOT_PASS_DELTA = 0,
+		SNAPSHOT_PASS_COMPRESS,
+	};
+	CSnapshotTask m_aSnapshotTasks[MAX_CLIENTS];
+	int m_NumSnapshotTasks;
+	std::atomic<int> m_NextSnapshotTask;
+	CSemaphore m_SnapshotTasksDone;
+	CJobPool m_SnapshotJobPool;
+	int m_NumSnapshotThreads;
+
+	// clients with the same snapshot and delta snapshot get the same delta, it's only created once.
+	// other identical deltas are only compressed once
+	int64_t m_NumSnapshotDeltas;
+	int64_t m_NumReusedSnapshotDeltas;
+	int64_t m_NumReusedSnapshotCompressions;
+	int64_t m_SnapshotDeltaBytes;
+
+	// network stats when network_stats was last called
+	NETSTATS m_PrevNetworkStats;
+	int m_PrevNetworkStatsTick;
+
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -316,6 +364,8 @@ public:
 	int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID) override;
 
 	void DoSnapshot();
+	void RunSnapshotPass(int Pass);
+	void RunSnapshotTasks(int Pass);
 
 	static int NewClientCallback(int ClientID, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientID, void *pUser);
@@ -395,6 +445,8 @@ public:
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConShowIps(IConsole::IResult *pResult, void *pUser);
+	static void ConSnapshotStats(IConsole::IResult *pResult, void *pUser);
+	static void ConNetworkStats(IConsole::IResult *pResult, void *pUser);
 
 	static void ConAuthAdd(IConsole::IResult *pResult, void *pUser);
 	static void ConAuthAddHashed(IConsole::IResult *pResult, void *pUser);
@@ -6,6 +6,12 @@
 
 #include <iterator> // std::size
 
+#if defined(CONF_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i, int DstSize)
 {
@@ -65,7 +71,7 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 	return pSrc;
 }
 
-long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
+long CVariableInt::DecompressScalar(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
 {
 	dbg_assert(DstSize % sizeof(int) == 0, "invalid bounds");
 
@@ -85,7 +91,7 @@ long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int D
 	return (long)((unsigned char *)pDst - (unsigned char *)pDst_);
 }
 
-long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
+long CVariableInt::CompressScalar(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
 {
 	dbg_assert(SrcSize % sizeof(int) == 0, "invalid bounds");
 
@@ -103,3 +109,140 @@ long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int Dst
 	}
 	return (long)(pDst - (unsigned char *)pDst_);
 }
+
+// Snapshot deltas are mostly small numbers that fit into one byte. The vectorised versions handle
+// 8 of those at once and fall back to Pack/Unpack for the next 8 otherwise
+long CVariableInt::Decompress(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
+{
+	dbg_assert(DstSize % sizeof(int) == 0, "invalid bounds");
+
+	const unsigned char *pSrc = (unsigned char *)pSrc_;
+	const unsigned char *pSrcEnd = pSrc + SrcSize;
+	int *pDst = (int *)pDst_;
+	const int *pDstEnd = pDst + DstSize / sizeof(int);
+	while(pSrc < pSrcEnd)
+	{
+		int NumScalar = 1;
+#if defined(CONF_SIMD_SSE2)
+		if(pSrcEnd - pSrc >= 8 && pDstEnd - pDst >= 8)
+		{
+			__m128i Bytes = _mm_loadl_epi64((const __m128i *)pSrc);
+			if((_mm_movemask_epi8(Bytes) & 0xFF) == 0)
+			{
+				const __m128i Zero = _mm_setzero_si128();
+				__m128i Shorts = _mm_unpacklo_epi8(Bytes, Zero);
+				__m128i aInts[2] = {_mm_unpacklo_epi16(Shorts, Zero), _mm_unpackhi_epi16(Shorts, Zero)};
+				for(int i = 0; i < 2; i++)
+				{
+					__m128i Sign = _mm_srai_epi32(_mm_slli_epi32(aInts[i], 25), 31);
+					_mm_storeu_si128((__m128i *)(pDst + i * 4), _mm_xor_si128(_mm_and_si128(aInts[i], _mm_set1_epi32(0x3F)), Sign));
+				}
+				pSrc += 8;
+				pDst += 8;
+				continue;
+			}
+			NumScalar = 8;
+		}
+#elif defined(CONF_SIMD_NEON)
+		if(pSrcEnd - pSrc >= 8 && pDstEnd - pDst >= 8)
+		{
+			uint8x8_t Bytes = vld1_u8(pSrc);
+			if(vget_lane_u64(vreinterpret_u64_u8(vand_u8(Bytes, vdup_n_u8(0x80))), 0) == 0)
+			{
+				uint16x8_t Shorts = vmovl_u8(Bytes);
+				int32x4_t aInts[2] = {vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(Shorts))), vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(Shorts)))};
+				for(int i = 0; i < 2; i++)
+				{
+					int32x4_t Sign = vshrq_n_s32(vshlq_n_s32(aInts[i], 25), 31);
+					vst1q_s32(pDst + i * 4, veorq_s32(vandq_s32(aInts[i], vdupq_n_s32(0x3F)), Sign));
+				}
+				pSrc += 8;
+				pDst += 8;
+				continue;
+			}
+			NumScalar = 8;
+		}
+#endif
+		for(; NumScalar && pSrc < pSrcEnd; NumScalar--)
+		{
+			if(pDst >= pDstEnd)
+				return -1;
+			pSrc = CVariableInt::Unpack(pSrc, pDst, pSrcEnd - pSrc);
+			if(!pSrc)
+				return -1;
+			pDst++;
+		}
+	}
+	return (long)((unsigned char *)pDst - (unsigned char *)pDst_);
+}
+
+long CVariableInt::Compress(const void *pSrc_, int SrcSize, void *pDst_, int DstSize)
+{
+	dbg_assert(SrcSize % sizeof(int) == 0, "invalid bounds");
+
+	const int *pSrc = (int *)pSrc_;
+	unsigned char *pDst = (unsigned char *)pDst_;
+	const unsigned char *pDstEnd = pDst + DstSize;
+	SrcSize /= sizeof(int);
+	while(SrcSize)
+	{
+		int NumScalar = 1;
+#if defined(CONF_SIMD_SSE2)
+		if(SrcSize >= 8 && pDstEnd - pDst >= 8)
+		{
+			__m128i aInts[2] = {_mm_loadu_si128((const __m128i *)pSrc), _mm_loadu_si128((const __m128i *)(pSrc + 4))};
+			__m128i aSigns[2], aFolded[2];
+			for(int i = 0; i < 2; i++)
+			{
+				aSigns[i] = _mm_srai_epi32(aInts[i], 31);
+				aFolded[i] = _mm_xor_si128(aInts[i], aSigns[i]);
+			}
+			const __m128i Max = _mm_set1_epi32(0x3F);
+			if(_mm_movemask_epi8(_mm_or_si128(_mm_cmpgt_epi32(aFolded[0], Max), _mm_cmpgt_epi32(aFolded[1], Max))) == 0)
+			{
+				const __m128i SignBit = _mm_set1_epi32(0x40);
+				__m128i Shorts = _mm_packs_epi32(_mm_or_si128(aFolded[0], _mm_and_si128(aSigns[0], SignBit)), _mm_or_si128(aFolded[1], _mm_and_si128(aSigns[1], SignBit)));
+				_mm_storel_epi64((__m128i *)pDst, _mm_packus_epi16(Shorts, Shorts));
+				pSrc += 8;
+				pDst += 8;
+				SrcSize -= 8;
+				continue;
+			}
+			NumScalar = 8;
+		}
+#elif defined(CONF_SIMD_NEON)
+		if(SrcSize >= 8 && pDstEnd - pDst >= 8)
+		{
+			int32x4_t aInts[2] = {vld1q_s32(pSrc), vld1q_s32(pSrc + 4)};
+			int32x4_t aSigns[2], aFolded[2];
+			for(int i = 0; i < 2; i++)
+			{
+				aSigns[i] = vshrq_n_s32(aInts[i], 31);
+				aFolded[i] = veorq_s32(aInts[i], aSigns[i]);
+			}
+			const int32x4_t Max = vdupq_n_s32(0x3F);
+			uint16x4_t Large = vmovn_u32(vorrq_u32(vcgtq_s32(aFolded[0], Max), vcgtq_s32(aFolded[1], Max)));
+			if(vget_lane_u64(vreinterpret_u64_u16(Large), 0) == 0)
+			{
+				const int32x4_t SignBit = vdupq_n_s32(0x40);
+				int16x8_t Shorts = vcombine_s16(vmovn_s32(vorrq_s32(aFolded[0], vandq_s32(aSigns[0], SignBit))), vmovn_s32(vorrq_s32(aFolded[1], vandq_s32(aSigns[1], SignBit))));
+				vst1_u8(pDst, vmovn_u16(vreinterpretq_u16_s16(Shorts)));
+				pSrc += 8;
+				pDst += 8;
+				SrcSize -= 8;
+				continue;
+			}
+			NumScalar = 8;
+		}
+#endif
+		for(; NumScalar && SrcSize; NumScalar--)
+		{
+			pDst = CVariableInt::Pack(pDst, *pSrc, pDstEnd - pDst);
+			if(!pDst)
+				return -1;
+			SrcSize--;
+			pSrc++;
+		}
+	}
+	return (long)(pDst - (unsigned char *)pDst_);
+}
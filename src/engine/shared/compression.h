@@ -17,6 +17,9 @@ public:
 
 	static long Compress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
 	static long Decompress(const void *pSrc, int SrcSize, void *pDst, int DstSize);
+	// without SSE2/NEON, the results must be the same
+	static long CompressScalar(const void *pSrc, int SrcSize, void *pDst, int DstSize);
+	static long DecompressScalar(const void *pSrc, int SrcSize, void *pDst, int DstSize);
 };
 
 #endif
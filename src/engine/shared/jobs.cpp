@@ -3,20 +3,26 @@
 #include "jobs.h"
 
 #include <base/lock_scope.h>
+#include <base/math.h>
+
+// the worker running on this thread, if any
+static thread_local CJobPool *s_pWorkerPool = nullptr;
+static thread_local int s_WorkerIndex = -1;
 
 IJob::IJob() :
-	m_Status(STATE_PENDING)
+	m_Status(STATE_PENDING), m_Priority(PRIORITY_NORMAL)
 {
 }
 
 IJob::IJob(const IJob &Other) :
-	m_Status(STATE_PENDING)
+	m_Status(STATE_PENDING), m_Priority(Other.m_Priority)
 {
 }
 
 IJob &IJob::operator=(const IJob &Other)
 {
 	m_Status = STATE_PENDING;
+	m_Priority = Other.m_Priority;
 	return *this;
 }
 
@@ -27,15 +33,77 @@ int IJob::Status()
 	return m_Status.load();
 }
 
+// bounded MPMC queue, see https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+CJobPool::CInjectionQueue::CInjectionQueue()
+{
+	for(int i = 0; i < SIZE; i++)
+		m_aCells[i].m_Sequence.store(i, std::memory_order_relaxed);
+	m_PushPos.store(0, std::memory_order_relaxed);
+	m_PopPos.store(0, std::memory_order_relaxed);
+}
+
+bool CJobPool::CInjectionQueue::TryPush(std::shared_ptr<IJob> &pJob)
+{
+	size_t Pos = m_PushPos.load(std::memory_order_relaxed);
+	while(true)
+	{
+		CCell &Cell = m_aCells[Pos & (SIZE - 1)];
+		const size_t Sequence = Cell.m_Sequence.load(std::memory_order_acquire);
+		const intptr_t Diff = (intptr_t)Sequence - (intptr_t)Pos;
+		if(Diff == 0)
+		{
+			if(m_PushPos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				Cell.m_pJob = std::move(pJob);
+				Cell.m_Sequence.store(Pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if(Diff < 0)
+			return false; // full
+		else
+			Pos = m_PushPos.load(std::memory_order_relaxed);
+	}
+}
+
+bool CJobPool::CInjectionQueue::TryPop(std::shared_ptr<IJob> &pJob)
+{
+	size_t Pos = m_PopPos.load(std::memory_order_relaxed);
+	while(true)
+	{
+		CCell &Cell = m_aCells[Pos & (SIZE - 1)];
+		const size_t Sequence = Cell.m_Sequence.load(std::memory_order_acquire);
+		const intptr_t Diff = (intptr_t)Sequence - (intptr_t)(Pos + 1);
+		if(Diff == 0)
+		{
+			if(m_PopPos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				pJob = std::move(Cell.m_pJob);
+				Cell.m_Sequence.store(Pos + SIZE, std::memory_order_release);
+				return true;
+			}
+		}
+		else if(Diff < 0)
+		{
+			// a job being pushed right now has already been counted by the semaphore, wait for it
+			if(m_PushPos.load(std::memory_order_acquire) == Pos)
+				return false; // empty
+			thread_yield();
+			Pos = m_PopPos.load(std::memory_order_relaxed);
+		}
+		else
+			Pos = m_PopPos.load(std::memory_order_relaxed);
+	}
+}
+
 CJobPool::CJobPool()
 {
 	// empty the pool
-	m_NumThreads = 0;
 	m_Shutdown = false;
-	m_Lock = lock_create();
 	sphore_init(&m_Semaphore);
-	m_pFirstJob = 0;
-	m_pLastJob = 0;
+	m_OverflowLock = lock_create();
+	for(auto &NumOverflowed : m_aNumOverflowed)
+		NumOverflowed = 0;
 }
 
 CJobPool::~CJobPool()
@@ -48,65 +116,147 @@ CJobPool::~CJobPool()
 
 void CJobPool::WorkerThread(void *pUser)
 {
-	CJobPool *pPool = (CJobPool *)pUser;
+	CWorker *pWorker = (CWorker *)pUser;
+	CJobPool *pPool = pWorker->m_pPool;
+	s_pWorkerPool = pPool;
+	s_WorkerIndex = pWorker->m_Index;
 
 	while(!pPool->m_Shutdown)
 	{
-		std::shared_ptr<IJob> pJob = 0;
-
-		// fetch job from queue
+		// every added job signals once, so there is a job for every wakeup
 		sphore_wait(&pPool->m_Semaphore);
-		{
-			CLockScope ls(pPool->m_Lock);
-			if(pPool->m_pFirstJob)
-			{
-				pJob = pPool->m_pFirstJob;
-				pPool->m_pFirstJob = pPool->m_pFirstJob->m_pNext;
-				if(!pPool->m_pFirstJob)
-					pPool->m_pLastJob = 0;
-			}
-		}
+		std::shared_ptr<IJob> pJob = pPool->FindJob(pWorker);
 
 		// do the job if we have one
 		if(pJob)
 		{
 			RunBlocking(pJob.get());
 		}
+		else if(!pPool->m_Shutdown)
+		{
+			// another worker took our job and we don't see theirs yet, give the wakeup back
+			sphore_signal(&pPool->m_Semaphore);
+			thread_yield();
+		}
 	}
 }
 
+bool CJobPool::PopLocal(CWorker *pWorker, int Priority, std::shared_ptr<IJob> &pJob)
+{
+	if(pWorker->m_aNumQueued[Priority].load(std::memory_order_relaxed) == 0)
+		return false;
+	CLockScope ls(pWorker->m_Lock);
+	std::deque<std::shared_ptr<IJob>> &Queue = pWorker->m_aQueues[Priority];
+	if(Queue.empty())
+		return false;
+	// newest first, its data is most likely still in the cache
+	pJob = std::move(Queue.back());
+	Queue.pop_back();
+	pWorker->m_aNumQueued[Priority]--;
+	return true;
+}
+
+bool CJobPool::PopInjected(int Priority, std::shared_ptr<IJob> &pJob)
+{
+	if(m_aInjectionQueues[Priority].TryPop(pJob))
+		return true;
+	if(m_aNumOverflowed[Priority].load(std::memory_order_relaxed) == 0)
+		return false;
+	CLockScope ls(m_OverflowLock);
+	std::deque<std::shared_ptr<IJob>> &Queue = m_aOverflowQueues[Priority];
+	if(Queue.empty())
+		return false;
+	pJob = std::move(Queue.front());
+	Queue.pop_front();
+	m_aNumOverflowed[Priority]--;
+	return true;
+}
+
+bool CJobPool::Steal(CWorker *pThief, int Priority, std::shared_ptr<IJob> &pJob)
+{
+	const int NumWorkers = m_vpWorkers.size();
+	for(int i = 1; i < NumWorkers; i++)
+	{
+		CWorker *pVictim = m_vpWorkers[(pThief->m_Index + i) % NumWorkers].get();
+		if(pVictim->m_aNumQueued[Priority].load(std::memory_order_relaxed) == 0)
+			continue;
+		CLockScope ls(pVictim->m_Lock);
+		std::deque<std::shared_ptr<IJob>> &Queue = pVictim->m_aQueues[Priority];
+		if(Queue.empty())
+			continue;
+		// oldest first, the victim is still working on the newer ones' data
+		pJob = std::move(Queue.front());
+		Queue.pop_front();
+		pVictim->m_aNumQueued[Priority]--;
+		return true;
+	}
+	return false;
+}
+
+std::shared_ptr<IJob> CJobPool::FindJob(CWorker *pWorker)
+{
+	std::shared_ptr<IJob> pJob;
+	for(int Priority = 0; Priority < IJob::NUM_PRIORITIES; Priority++)
+	{
+		if(PopLocal(pWorker, Priority, pJob) || PopInjected(Priority, pJob) || Steal(pWorker, Priority, pJob))
+			return pJob;
+	}
+	return nullptr;
+}
+
 void CJobPool::Init(int NumThreads)
 {
-	// start threads
-	m_NumThreads = NumThreads > MAX_THREADS ? MAX_THREADS : NumThreads;
+	// create all workers before starting them, they steal from each other
 	for(int i = 0; i < NumThreads; i++)
-		m_apThreads[i] = thread_init(WorkerThread, this, "CJobPool worker");
+	{
+		auto pWorker = std::make_unique<CWorker>();
+		pWorker->m_pPool = this;
+		pWorker->m_Index = i;
+		pWorker->m_pThread = nullptr;
+		pWorker->m_Lock = lock_create();
+		for(auto &NumQueued : pWorker->m_aNumQueued)
+			NumQueued = 0;
+		m_vpWorkers.push_back(std::move(pWorker));
+	}
+
+	// start threads
+	for(auto &pWorker : m_vpWorkers)
+		pWorker->m_pThread = thread_init(WorkerThread, pWorker.get(), "CJobPool worker");
 }
 
 void CJobPool::Destroy()
 {
 	m_Shutdown = true;
-	for(int i = 0; i < m_NumThreads; i++)
+	for(size_t i = 0; i < m_vpWorkers.size(); i++)
 		sphore_signal(&m_Semaphore);
-	for(int i = 0; i < m_NumThreads; i++)
+	for(auto &pWorker : m_vpWorkers)
 	{
-		if(m_apThreads[i])
-			thread_wait(m_apThreads[i]);
+		if(pWorker->m_pThread)
+			thread_wait(pWorker->m_pThread);
 	}
-	lock_destroy(m_Lock);
+	for(auto &pWorker : m_vpWorkers)
+		lock_destroy(pWorker->m_Lock);
+	m_vpWorkers.clear();
+	lock_destroy(m_OverflowLock);
 	sphore_destroy(&m_Semaphore);
 }
 
 void CJobPool::Add(std::shared_ptr<IJob> pJob)
 {
+	const int Priority = clamp(pJob->m_Priority, 0, (int)IJob::NUM_PRIORITIES - 1);
+	if(s_pWorkerPool == this)
+	{
+		// added by one of our workers
+		CWorker *pWorker = m_vpWorkers[s_WorkerIndex].get();
+		CLockScope ls(pWorker->m_Lock);
+		pWorker->m_aQueues[Priority].push_back(std::move(pJob));
+		pWorker->m_aNumQueued[Priority]++;
+	}
+	else if(!m_aInjectionQueues[Priority].TryPush(pJob))
 	{
-		CLockScope ls(m_Lock);
-		// add job to queue
-		if(m_pLastJob)
-			m_pLastJob->m_pNext = pJob;
-		m_pLastJob = std::move(pJob);
-		if(!m_pFirstJob)
-			m_pFirstJob = m_pLastJob;
+		CLockScope ls(m_OverflowLock);
+		m_aOverflowQueues[Priority].push_back(std::move(pJob));
+		m_aNumOverflowed[Priority]++;
 	}
 
 	sphore_signal(&m_Semaphore);
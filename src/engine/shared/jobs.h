@@ -6,7 +6,9 @@
 #include <base/system.h>
 
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <vector>
 
 class CJobPool;
 
@@ -15,9 +17,8 @@ class IJob
 	friend CJobPool;
 
 private:
-	std::shared_ptr<IJob> m_pNext;
-
 	std::atomic<int> m_Status;
+	int m_Priority;
 	virtual void Run() = 0;
 
 public:
@@ -27,30 +28,77 @@ public:
 	virtual ~IJob();
 	int Status();
 
+	// must be set before the job is added
+	void SetPriority(int Priority) { m_Priority = Priority; }
+	int Priority() const { return m_Priority; }
+
 	enum
 	{
 		STATE_PENDING = 0,
 		STATE_RUNNING,
 		STATE_DONE
 	};
+
+	enum
+	{
+		PRIORITY_HIGH = 0, // someone is waiting for the result, runs before all normal jobs
+		PRIORITY_NORMAL,
+		NUM_PRIORITIES
+	};
 };
 
 class CJobPool
 {
-	enum
+	// lock-free queue of the jobs added from outside the pool, jobs that don't fit go to the overflow list
+	class CInjectionQueue
 	{
-		MAX_THREADS = 32
+		enum
+		{
+			SIZE = 1024
+		};
+
+		struct CCell
+		{
+			std::atomic<size_t> m_Sequence;
+			std::shared_ptr<IJob> m_pJob;
+		};
+		CCell m_aCells[SIZE];
+		alignas(64) std::atomic<size_t> m_PushPos;
+		alignas(64) std::atomic<size_t> m_PopPos;
+
+	public:
+		CInjectionQueue();
+		// only moves the job out on success
+		bool TryPush(std::shared_ptr<IJob> &pJob);
+		bool TryPop(std::shared_ptr<IJob> &pJob);
 	};
-	int m_NumThreads;
-	void *m_apThreads[MAX_THREADS];
+
+	// jobs added by a worker go to its own deque, other workers steal them from the front when idle
+	struct CWorker
+	{
+		CJobPool *m_pPool;
+		int m_Index;
+		void *m_pThread;
+
+		LOCK m_Lock;
+		std::deque<std::shared_ptr<IJob>> m_aQueues[IJob::NUM_PRIORITIES] GUARDED_BY(m_Lock);
+		std::atomic<int> m_aNumQueued[IJob::NUM_PRIORITIES];
+	};
+
+	std::vector<std::unique_ptr<CWorker>> m_vpWorkers;
 	std::atomic<bool> m_Shutdown;
 
-	LOCK m_Lock;
 	SEMAPHORE m_Semaphore;
-	std::shared_ptr<IJob> m_pFirstJob GUARDED_BY(m_Lock);
-	std::shared_ptr<IJob> m_pLastJob GUARDED_BY(m_Lock);
+	CInjectionQueue m_aInjectionQueues[IJob::NUM_PRIORITIES];
+	LOCK m_OverflowLock;
+	std::deque<std::shared_ptr<IJob>> m_aOverflowQueues[IJob::NUM_PRIORITIES] GUARDED_BY(m_OverflowLock);
+	std::atomic<int> m_aNumOverflowed[IJob::NUM_PRIORITIES];
 
-	static void WorkerThread(void *pUser) NO_THREAD_SAFETY_ANALYSIS;
+	static void WorkerThread(void *pUser);
+	std::shared_ptr<IJob> FindJob(CWorker *pWorker);
+	bool PopLocal(CWorker *pWorker, int Priority, std::shared_ptr<IJob> &pJob);
+	bool PopInjected(int Priority, std::shared_ptr<IJob> &pJob) REQUIRES(!m_OverflowLock);
+	bool Steal(CWorker *pThief, int Priority, std::shared_ptr<IJob> &pJob);
 
 public:
 	CJobPool();
@@ -58,7 +106,7 @@ public:
 
 	void Init(int NumThreads);
 	void Destroy();
-	void Add(std::shared_ptr<IJob> pJob) REQUIRES(!m_Lock);
+	void Add(std::shared_ptr<IJob> pJob) REQUIRES(!m_OverflowLock);
 	static void RunBlocking(IJob *pJob);
 };
 #endif
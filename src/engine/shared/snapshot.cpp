@@ -10,6 +10,12 @@
 #include <base/system.h>
 #include <game/generated/protocolglue.h>
 
+#if defined(CONF_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 // CSnapshot
 
 CSnapshotItem *CSnapshot::GetItem(int Index) const
@@ -24,20 +30,20 @@ int CSnapshot::GetItemSize(int Index) const
 	return (Offsets()[Index + 1] - Offsets()[Index]) - sizeof(CSnapshotItem);
 }
 
-int CSnapshot::GetItemType(int Index) const
+int CSnapshot::GetItemType(int Index, const CSnapshotIndex *pIndex) const
 {
 	int InternalType = GetItem(Index)->Type();
-	return GetExternalItemType(InternalType);
+	return GetExternalItemType(InternalType, pIndex);
 }
 
-int CSnapshot::GetExternalItemType(int InternalType) const
+int CSnapshot::GetExternalItemType(int InternalType, const CSnapshotIndex *pIndex) const
 {
 	if(InternalType < OFFSET_UUID_TYPE)
 	{
 		return InternalType;
 	}
 
-	int TypeItemIndex = GetItemIndex((0 << 16) | InternalType); // NETOBJTYPE_EX
+	int TypeItemIndex = GetItemIndex((0 << 16) | InternalType, pIndex); // NETOBJTYPE_EX
 	if(TypeItemIndex == -1 || GetItemSize(TypeItemIndex) < (int)sizeof(CUuid))
 	{
 		return InternalType;
@@ -50,9 +56,11 @@ int CSnapshot::GetExternalItemType(int InternalType) const
 	return g_UuidManager.LookupUuid(Uuid);
 }
 
-int CSnapshot::GetItemIndex(int Key) const
+int CSnapshot::GetItemIndex(int Key, const CSnapshotIndex *pIndex) const
 {
-	// TODO: OPT: this should not be a linear search. very bad
+	if(pIndex && pIndex->IsIndexed())
+		return pIndex->GetItemIndex(this, Key);
+
 	for(int i = 0; i < m_NumItems; i++)
 	{
 		if(GetItem(i)->Key() == Key)
@@ -61,7 +69,7 @@ int CSnapshot::GetItemIndex(int Key) const
 	return -1;
 }
 
-void *CSnapshot::FindItem(int Type, int ID) const
+void *CSnapshot::FindItem(int Type, int ID, const CSnapshotIndex *pIndex) const
 {
 	int InternalType = Type;
 	if(Type >= OFFSET_UUID)
@@ -71,10 +79,13 @@ void *CSnapshot::FindItem(int Type, int ID) const
 		for(int i = 0; i < (int)sizeof(CUuid) / 4; i++)
 			aTypeUuidItem[i] = bytes_be_to_int(&TypeUuid.m_aData[i * 4]);
 
+		// only the type items need to be checked if the index knows them
+		const bool UseExTypeItems = pIndex && pIndex->IsIndexed() && pIndex->NumExTypeItems() >= 0;
+		const int NumCandidates = UseExTypeItems ? pIndex->NumExTypeItems() : m_NumItems;
 		bool Found = false;
-		for(int i = 0; i < m_NumItems; i++)
+		for(int i = 0; i < NumCandidates; i++)
 		{
-			CSnapshotItem *pItem = GetItem(i);
+			CSnapshotItem *pItem = GetItem(UseExTypeItems ? pIndex->ExTypeItem(i) : i);
 			if(pItem->Type() == 0 && pItem->ID() >= OFFSET_UUID_TYPE) // NETOBJTYPE_EX
 			{
 				if(mem_comp(pItem->Data(), aTypeUuidItem, sizeof(CUuid)) == 0)
@@ -90,7 +101,7 @@ void *CSnapshot::FindItem(int Type, int ID) const
 			return nullptr;
 		}
 	}
-	int Index = GetItemIndex((InternalType << 16) | ID);
+	int Index = GetItemIndex((InternalType << 16) | ID, pIndex);
 	return Index < 0 ? nullptr : GetItem(Index)->Data();
 }
 
@@ -142,6 +153,82 @@ bool CSnapshot::IsValid(size_t ActualSize) const
 	return true;
 }
 
+// CSnapshotIndex
+
+unsigned CSnapshotIndex::Hash(int Key)
+{
+	// the type is in the upper and the ID in the lower bits, mix both into the upper bits
+	return (unsigned)Key * 0x9E3779B1u;
+}
+
+int CSnapshotIndex::NumSlots(int NumItems)
+{
+	if(NumItems > MAX_ITEMS)
+		return 0;
+	int NumSlots = 16;
+	while(NumSlots < NumItems * 2)
+		NumSlots *= 2;
+	return NumSlots;
+}
+
+int CSnapshotIndex::TotalSize(int NumItems)
+{
+	const int Slots = NumSlots(NumItems);
+	return sizeof(CSnapshotIndex) + (Slots > 1 ? Slots - 1 : 0) * sizeof(short);
+}
+
+void CSnapshotIndex::Build(const CSnapshot *pSnap)
+{
+	m_NumExTypeItems = 0;
+	m_NumSlots = NumSlots(pSnap->NumItems());
+	if(!m_NumSlots)
+		return;
+
+	for(int i = 0; i < m_NumSlots; i++)
+		m_aSlots[i] = -1;
+
+	const unsigned Mask = m_NumSlots - 1;
+	for(int i = 0; i < pSnap->NumItems(); i++)
+	{
+		const CSnapshotItem *pItem = pSnap->GetItem(i);
+		const int Key = pItem->Key();
+		unsigned Slot = Hash(Key) >> 16 & Mask;
+		while(true)
+		{
+			if(m_aSlots[Slot] == -1)
+			{
+				m_aSlots[Slot] = i;
+				break;
+			}
+			// keep the first item with a key like the linear search does
+			if(pSnap->GetItem(m_aSlots[Slot])->Key() == Key)
+				break;
+			Slot = (Slot + 1) & Mask;
+		}
+
+		if(pItem->Type() == 0 && pItem->ID() >= CSnapshot::OFFSET_UUID_TYPE && m_NumExTypeItems >= 0) // NETOBJTYPE_EX
+		{
+			if(m_NumExTypeItems < MAX_EX_TYPE_ITEMS)
+				m_aExTypeItems[m_NumExTypeItems++] = i;
+			else
+				m_NumExTypeItems = -1;
+		}
+	}
+}
+
+int CSnapshotIndex::GetItemIndex(const CSnapshot *pSnap, int Key) const
+{
+	const unsigned Mask = m_NumSlots - 1;
+	unsigned Slot = Hash(Key) >> 16 & Mask;
+	while(m_aSlots[Slot] != -1)
+	{
+		if(pSnap->GetItem(m_aSlots[Slot])->Key() == Key)
+			return m_aSlots[Slot];
+		Slot = (Slot + 1) & Mask;
+	}
+	return -1;
+}
+
 // CSnapshotDelta
 
 enum
@@ -196,12 +283,13 @@ static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
 	return -1;
 }
 
-int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+int CSnapshotDelta::DiffItemScalar(int *pPast, int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
 	while(Size)
 	{
-		*pOut = *pCurrent - *pPast;
+		// items can hold anything, wrap around like the vectorised loops instead of overflowing
+		*pOut = (int)((unsigned)*pCurrent - (unsigned)*pPast);
 		Needed |= *pOut;
 		pOut++;
 		pPast++;
@@ -212,11 +300,11 @@ int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 	return Needed;
 }
 
-void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate)
+void CSnapshotDelta::UndiffItemScalar(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate)
 {
 	while(Size)
 	{
-		*pOut = *pPast + *pDiff;
+		*pOut = (int)((unsigned)*pPast + (unsigned)*pDiff);
 
 		if(*pDiff == 0)
 			*pDataRate += 1;
@@ -234,6 +322,77 @@ void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size, int
 	}
 }
 
+int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
+{
+	int i = 0;
+	int Needed = 0;
+#if defined(CONF_SIMD_SSE2)
+	__m128i NeededVec = _mm_setzero_si128();
+	for(; i + 4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(pCurrent + i)), _mm_loadu_si128((const __m128i *)(pPast + i)));
+		_mm_storeu_si128((__m128i *)(pOut + i), Diff);
+		NeededVec = _mm_or_si128(NeededVec, Diff);
+	}
+	NeededVec = _mm_or_si128(NeededVec, _mm_shuffle_epi32(NeededVec, _MM_SHUFFLE(1, 0, 3, 2)));
+	NeededVec = _mm_or_si128(NeededVec, _mm_shuffle_epi32(NeededVec, _MM_SHUFFLE(2, 3, 0, 1)));
+	Needed = _mm_cvtsi128_si32(NeededVec);
+#elif defined(CONF_SIMD_NEON)
+	int32x4_t NeededVec = vdupq_n_s32(0);
+	for(; i + 4 <= Size; i += 4)
+	{
+		int32x4_t Diff = vsubq_s32(vld1q_s32(pCurrent + i), vld1q_s32(pPast + i));
+		vst1q_s32(pOut + i, Diff);
+		NeededVec = vorrq_s32(NeededVec, Diff);
+	}
+	Needed = vgetq_lane_s32(NeededVec, 0) | vgetq_lane_s32(NeededVec, 1) | vgetq_lane_s32(NeededVec, 2) | vgetq_lane_s32(NeededVec, 3);
+#endif
+	return Needed | DiffItemScalar(pPast + i, pCurrent + i, pOut + i, Size - i);
+}
+
+void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate)
+{
+	// the data rate counts the bits CVariableInt::Pack needs for each diff: 1 byte for 6 bits, another for each 7 more, 1 bit for zero
+	int i = 0;
+#if defined(CONF_SIMD_SSE2)
+	const __m128i Zero = _mm_setzero_si128();
+	__m128i Rate = Zero;
+	for(; i + 4 <= Size; i += 4)
+	{
+		__m128i Diff = _mm_loadu_si128((const __m128i *)(pDiff + i));
+		_mm_storeu_si128((__m128i *)(pOut + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pPast + i)), Diff));
+
+		__m128i Folded = _mm_xor_si128(Diff, _mm_srai_epi32(Diff, 31));
+		__m128i Extra = _mm_add_epi32(
+			_mm_add_epi32(_mm_cmpgt_epi32(Folded, _mm_set1_epi32((1 << 6) - 1)), _mm_cmpgt_epi32(Folded, _mm_set1_epi32((1 << 13) - 1))),
+			_mm_add_epi32(_mm_cmpgt_epi32(Folded, _mm_set1_epi32((1 << 20) - 1)), _mm_cmpgt_epi32(Folded, _mm_set1_epi32((1 << 27) - 1))));
+		__m128i Bits = _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(1), Extra), 3);
+		__m128i IsZero = _mm_cmpeq_epi32(Diff, Zero);
+		Rate = _mm_add_epi32(Rate, _mm_or_si128(_mm_and_si128(IsZero, _mm_set1_epi32(1)), _mm_andnot_si128(IsZero, Bits)));
+	}
+	Rate = _mm_add_epi32(Rate, _mm_shuffle_epi32(Rate, _MM_SHUFFLE(1, 0, 3, 2)));
+	Rate = _mm_add_epi32(Rate, _mm_shuffle_epi32(Rate, _MM_SHUFFLE(2, 3, 0, 1)));
+	*pDataRate += _mm_cvtsi128_si32(Rate);
+#elif defined(CONF_SIMD_NEON)
+	int32x4_t Rate = vdupq_n_s32(0);
+	for(; i + 4 <= Size; i += 4)
+	{
+		int32x4_t Diff = vld1q_s32(pDiff + i);
+		vst1q_s32(pOut + i, vaddq_s32(vld1q_s32(pPast + i), Diff));
+
+		int32x4_t Folded = veorq_s32(Diff, vshrq_n_s32(Diff, 31));
+		int32x4_t Extra = vaddq_s32(
+			vaddq_s32(vreinterpretq_s32_u32(vcgtq_s32(Folded, vdupq_n_s32((1 << 6) - 1))), vreinterpretq_s32_u32(vcgtq_s32(Folded, vdupq_n_s32((1 << 13) - 1)))),
+			vaddq_s32(vreinterpretq_s32_u32(vcgtq_s32(Folded, vdupq_n_s32((1 << 20) - 1))), vreinterpretq_s32_u32(vcgtq_s32(Folded, vdupq_n_s32((1 << 27) - 1)))));
+		int32x4_t Bits = vshlq_n_s32(vsubq_s32(vdupq_n_s32(1), Extra), 3);
+		uint32x4_t IsZero = vceqq_s32(Diff, vdupq_n_s32(0));
+		Rate = vaddq_s32(Rate, vbslq_s32(IsZero, vdupq_n_s32(1), Bits));
+	}
+	*pDataRate += vgetq_lane_s32(Rate, 0) + vgetq_lane_s32(Rate, 1) + vgetq_lane_s32(Rate, 2) + vgetq_lane_s32(Rate, 3);
+#endif
+	UndiffItemScalar(pPast + i, pDiff + i, pOut + i, Size - i, pDataRate);
+}
+
 CSnapshotDelta::CSnapshotDelta()
 {
 	mem_zero(m_aItemSizes, sizeof(m_aItemSizes));
@@ -397,6 +556,8 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 	}
 
 	// unpack updated stuff
+	CSnapshotIndexBuffer FromIndex;
+	FromIndex.Get()->Build(pFrom);
 	for(int i = 0; i < pDelta->m_NumUpdateItems; i++)
 	{
 		if(pData + 2 > pEnd)
@@ -435,11 +596,11 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, const void *pS
 		if(!pNewData)
 			return -4;
 
-		const int FromIndex = pFrom->GetItemIndex(Key);
-		if(FromIndex != -1)
+		const int FromItemIndex = pFrom->GetItemIndex(Key, FromIndex.Get());
+		if(FromItemIndex != -1)
 		{
 			// we got an update so we need to apply the diff
-			UndiffItem(pFrom->GetItem(FromIndex)->Data(), pData, pNewData, ItemSize / 4, &m_aSnapshotDataRate[Type]);
+			UndiffItem(pFrom->GetItem(FromItemIndex)->Data(), pData, pNewData, ItemSize / 4, &m_aSnapshotDataRate[Type]);
 		}
 		else // no previous, just copy the pData
 		{
@@ -510,9 +671,11 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData,
 	// allocate memory for holder + snapshot_data
 	int TotalSize = sizeof(CHolder) + DataSize;
 
+	int AltIndexSize = 0;
 	if(AltDataSize > 0)
 	{
-		TotalSize += AltDataSize;
+		AltIndexSize = CSnapshotIndex::TotalSize(((CSnapshot *)pAltData)->NumItems());
+		TotalSize += AltDataSize + AltIndexSize;
 	}
 
 	CHolder *pHolder = (CHolder *)malloc(TotalSize);
@@ -529,11 +692,14 @@ void CSnapshotStorage::Add(int Tick, int64_t Tagtime, int DataSize, void *pData,
 		pHolder->m_pAltSnap = (CSnapshot *)(((char *)pHolder->m_pSnap) + DataSize);
 		mem_copy(pHolder->m_pAltSnap, pAltData, AltDataSize);
 		pHolder->m_AltSnapSize = AltDataSize;
+		pHolder->m_pAltIndex = (CSnapshotIndex *)(((char *)pHolder->m_pAltSnap) + AltDataSize);
+		pHolder->m_pAltIndex->Build(pHolder->m_pAltSnap);
 	}
 	else
 	{
 		pHolder->m_pAltSnap = 0;
 		pHolder->m_AltSnapSize = 0;
+		pHolder->m_pAltIndex = 0;
 	}
 
 	// link
@@ -573,6 +739,8 @@ int CSnapshotStorage::Get(int Tick, int64_t *pTagtime, CSnapshot **ppData, CSnap
 CSnapshotBuilder::CSnapshotBuilder()
 {
 	m_NumExtendedItemTypes = 0;
+	m_IndexSlotsCleared = false;
+	m_NumIndexedItems = 0;
 }
 
 void CSnapshotBuilder::Init(bool Sixup)
@@ -581,6 +749,10 @@ void CSnapshotBuilder::Init(bool Sixup)
 	m_NumItems = 0;
 	m_Sixup = Sixup;
 
+	if(m_NumIndexedItems)
+		m_IndexSlotsCleared = false;
+	m_NumIndexedItems = 0;
+
 	for(int i = 0; i < m_NumExtendedItemTypes; i++)
 	{
 		AddExtendedItemType(i);
@@ -594,10 +766,31 @@ CSnapshotItem *CSnapshotBuilder::GetItem(int Index)
 
 int *CSnapshotBuilder::GetItemData(int Key)
 {
-	for(int i = 0; i < m_NumItems; i++)
+	if(!m_IndexSlotsCleared)
 	{
-		if(GetItem(i)->Key() == Key)
-			return GetItem(i)->Data();
+		for(auto &Slot : m_aIndexSlots)
+			Slot = -1;
+		m_IndexSlotsCleared = true;
+	}
+
+	// index the items added since the last lookup
+	const unsigned Mask = CSnapshotIndex::MAX_SLOTS - 1;
+	for(; m_NumIndexedItems < m_NumItems; m_NumIndexedItems++)
+	{
+		const int ItemKey = GetItem(m_NumIndexedItems)->Key();
+		unsigned Slot = CSnapshotIndex::Hash(ItemKey) >> 16 & Mask;
+		while(m_aIndexSlots[Slot] != -1 && GetItem(m_aIndexSlots[Slot])->Key() != ItemKey)
+			Slot = (Slot + 1) & Mask;
+		if(m_aIndexSlots[Slot] == -1)
+			m_aIndexSlots[Slot] = m_NumIndexedItems;
+	}
+
+	unsigned Slot = CSnapshotIndex::Hash(Key) >> 16 & Mask;
+	while(m_aIndexSlots[Slot] != -1)
+	{
+		if(GetItem(m_aIndexSlots[Slot])->Key() == Key)
+			return GetItem(m_aIndexSlots[Slot])->Data();
+		Slot = (Slot + 1) & Mask;
 	}
 	return 0;
 }
@@ -6,6 +6,8 @@
 #include <cstddef>
 #include <stdint.h>
 
+class CSnapshotIndex;
+
 // CSnapshot
 
 class CSnapshotItem
@@ -50,16 +52,61 @@ public:
 	int NumItems() const { return m_NumItems; }
 	CSnapshotItem *GetItem(int Index) const;
 	int GetItemSize(int Index) const;
-	int GetItemIndex(int Key) const;
-	int GetItemType(int Index) const;
-	int GetExternalItemType(int InternalType) const;
-	void *FindItem(int Type, int ID) const;
+	// the lookups search linearly without an index built for this snapshot
+	int GetItemIndex(int Key, const CSnapshotIndex *pIndex = nullptr) const;
+	int GetItemType(int Index, const CSnapshotIndex *pIndex = nullptr) const;
+	int GetExternalItemType(int InternalType, const CSnapshotIndex *pIndex = nullptr) const;
+	void *FindItem(int Type, int ID, const CSnapshotIndex *pIndex = nullptr) const;
 
 	unsigned Crc();
 	void DebugDump();
 	bool IsValid(size_t ActualSize) const;
 };
 
+// CSnapshotIndex
+
+// Open addressing table from item keys to item indices of one snapshot, built once when the snapshot is stored.
+// Entries are checked against the snapshot's keys, so invalidated items are simply not found
+class CSnapshotIndex
+{
+public:
+	enum
+	{
+		MAX_ITEMS = CSnapshot::MAX_ITEMS, // snapshots with more items aren't indexed
+		MAX_SLOTS = MAX_ITEMS * 2,
+		MAX_EX_TYPE_ITEMS = 64,
+	};
+
+	static unsigned Hash(int Key);
+	static int TotalSize(int NumItems);
+
+	// the memory must be TotalSize(pSnap->NumItems()) bytes
+	void Build(const CSnapshot *pSnap);
+	bool IsIndexed() const { return m_NumSlots != 0; }
+	int GetItemIndex(const CSnapshot *pSnap, int Key) const;
+
+	// NETOBJTYPE_EX items, -1 if there are too many
+	int NumExTypeItems() const { return m_NumExTypeItems; }
+	int ExTypeItem(int i) const { return m_aExTypeItems[i]; }
+
+private:
+	static int NumSlots(int NumItems);
+
+	int m_NumSlots; // 0 if not indexed
+	int m_NumExTypeItems;
+	short m_aExTypeItems[MAX_EX_TYPE_ITEMS];
+	short m_aSlots[1]; // -1 for empty slots
+};
+
+// memory for the index of any snapshot
+class CSnapshotIndexBuffer
+{
+	alignas(CSnapshotIndex) char m_aData[sizeof(CSnapshotIndex) + (CSnapshotIndex::MAX_SLOTS - 1) * sizeof(short)];
+
+public:
+	CSnapshotIndex *Get() { return (CSnapshotIndex *)m_aData; }
+};
+
 // CSnapshotDelta
 
 class CSnapshotDelta
@@ -84,10 +131,12 @@ private:
 	int m_aSnapshotDataUpdates[CSnapshot::MAX_TYPE + 1];
 	CData m_Empty;
 
-	static void UndiffItem(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate);
-
 public:
 	static int DiffItem(int *pPast, int *pCurrent, int *pOut, int Size);
+	static void UndiffItem(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate);
+	// without SSE2/NEON, the results must be the same
+	static int DiffItemScalar(int *pPast, int *pCurrent, int *pOut, int Size);
+	static void UndiffItemScalar(int *pPast, int *pDiff, int *pOut, int Size, int *pDataRate);
 	CSnapshotDelta();
 	CSnapshotDelta(const CSnapshotDelta &Old);
 	int GetDataRate(int Index) const { return m_aSnapshotDataRate[Index]; }
@@ -117,6 +166,7 @@ public:
 
 		CSnapshot *m_pSnap;
 		CSnapshot *m_pAltSnap;
+		CSnapshotIndex *m_pAltIndex; // only stored with an alternative snapshot
 	};
 
 	CHolder *m_pFirst;
@@ -147,6 +197,11 @@ class CSnapshotBuilder
 	int m_aExtendedItemTypes[MAX_EXTENDED_ITEM_TYPES];
 	int m_NumExtendedItemTypes;
 
+	// only filled by GetItemData, the server doesn't look up items while building
+	short m_aIndexSlots[CSnapshotIndex::MAX_SLOTS];
+	bool m_IndexSlotsCleared;
+	int m_NumIndexedItems;
+
 	void AddExtendedItemType(int Index);
 	int GetExtendedItemTypeIndex(int TypeID);
 	int GetTypeFromIndex(int Index);
@@ -89,6 +89,11 @@ public:
 	virtual void StopVoice(CVoiceHandle Voice) = 0;
 	virtual bool IsPlaying(int SampleID) = 0;
 
+	// fills pFrames with NumFrames interleaved stereo frames, called by the mixer on the audio thread
+	typedef void (*FStreamCallback)(short *pFrames, unsigned NumFrames, void *pUser);
+	// mixes audio generated on demand at Rate into the channel, nullptr stops it
+	virtual void SetStream(int ChannelID, int Rate, FStreamCallback pfnCallback, void *pUser) = 0;
+
 	virtual ISoundMixFunc GetSoundMixFunc() = 0;
 	// useful for thread synchronization
 	virtual void PauseAudioDevice() = 0;
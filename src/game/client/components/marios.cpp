@@ -29,8 +29,25 @@ static const char *MARIO_SHADER =
 "\n uniform mat4 view;"
 "\n uniform mat4 projection;"
 "\n uniform sampler2D marioTex;"
-"\n uniform int wingCap;"
-"\n uniform int metalCap;"
+"\n #ifdef POSE_BATCH"
+"\n     // per Mario: metal cap and custom colors, body color, feet color, then the transforms of all the parts of the bind pose."
+"\n     // the w of a transform's first column is 0 if Mario doesn't draw the part, 1 if he does and 2 for his wings"
+"\n     layout(std140) uniform MarioPoses"
+"\n     {"
+"\n         vec4 poses[POSE_VEC4S];"
+"\n     };"
+"\n     uniform int numParts;"
+"\n     flat v2f int v_wingCap;"
+"\n     flat v2f int v_metalCap;"
+"\n #else"
+"\n     uniform int wingCap;"
+"\n     uniform int metalCap;"
+"\n     uniform mat4 model;"
+"\n     uniform mat3 normalMatrix;"
+"\n     uniform int customColors;"
+"\n     uniform vec3 bodyColor;"
+"\n     uniform vec3 feetColor;"
+"\n #endif"
 "\n "
 "\n v2f vec3 v_color;"
 "\n v2f vec3 v_normal;"
@@ -43,15 +60,46 @@ static const char *MARIO_SHADER =
 "\n     in vec3 normal;"
 "\n     in vec3 color;"
 "\n     in vec2 uv;"
+"\n #ifdef POSE_BATCH"
+"\n     in float part;"
+"\n #endif"
 "\n "
 "\n     void main()"
 "\n     {"
+"\n #ifdef POSE_BATCH"
+"\n         int first = gl_InstanceID * (3 + 4 * numParts);"
+"\n         int partIndex = int( part );"
+"\n         vec4 column = partIndex < numParts ? poses[first + 3 + 4 * partIndex] : vec4( 0 );"
+"\n         if (column.w == 0.)"
+"\n         {"
+"\n             // all the triangles of the part collapse to one point"
+"\n             gl_Position = vec4( 0, 0, 0, 1 );"
+"\n             return;"
+"\n         }"
+"\n         int p = first + 3 + 4 * partIndex;"
+"\n         mat4 model = mat4( vec4( column.xyz, 0 ), poses[p + 1], poses[p + 2], poses[p + 3] );"
+"\n         mat3 normalMatrix = mat3( 1, 0, 0, 0, -1, 0, 0, 0, 1 ) * mat3( model );"
+"\n         int metalCap = int( poses[first].x );"
+"\n         int customColors = int( poses[first].y );"
+"\n         vec3 bodyColor = poses[first + 1].rgb;"
+"\n         vec3 feetColor = poses[first + 2].rgb;"
+"\n         v_wingCap = column.w == 2. ? 1 : 0;"
+"\n         v_metalCap = metalCap;"
+"\n #endif"
 "\n         v_color = color;"
-"\n         v_normal = normal;"
+"\n         if (metalCap == 1) v_color = vec3( 0 );"
+"\n         else if (customColors == 1)"
+"\n         {"
+"\n             ivec3 c = ivec3( round( color * 255. ));"
+"\n             if (c == ivec3( 0, 0, 255 )) v_color = bodyColor / 2.; // overalls / pants"
+"\n             else if (c == ivec3( 255, 0, 0 )) v_color = bodyColor; // shirt / hat"
+"\n             else if (c == ivec3( 114, 28, 14 )) v_color = feetColor; // shoes"
+"\n         }"
+"\n         v_normal = normalize( normalMatrix * normal );"
 "\n         v_light = transpose( mat3( view )) * normalize( vec3( 1 ));"
 "\n         v_uv = uv;"
 "\n "
-"\n         gl_Position = projection * view * vec4( position, 1. );"
+"\n         gl_Position = projection * view * model * vec4( position, 1. );"
 "\n     }"
 "\n "
 "\n #endif"
@@ -61,15 +109,19 @@ static const char *MARIO_SHADER =
 "\n "
 "\n     void main() "
 "\n     {"
+"\n #ifdef POSE_BATCH"
+"\n         int wingCap = v_wingCap;"
+"\n         int metalCap = v_metalCap;"
+"\n #endif"
 "\n         float light = .5 + .5 * clamp( dot( v_normal, v_light ), 0., 1. );"
 "\n         vec4 texColor = vec4(0);"
-"\n         if (wingCap == 0 && metalCap == 0) texColor = texture2D(marioTex, v_uv);"
+"\n         if (wingCap == 0 && metalCap == 0) texColor = texture(marioTex, v_uv);"
 "\n         else if (wingCap == 1)"
 "\n         {"
-"\n             texColor = texture2D(marioTex, v_uv);"
+"\n             texColor = texture(marioTex, v_uv);"
 "\n             if (texColor.a != 1) discard;"
 "\n         }"
-"\n         else if (metalCap == 1) texColor = texture2D(marioTex, v_uv); // NEED A WAY TO MAKE REFLECTION"
+"\n         else if (metalCap == 1) texColor = texture(marioTex, v_uv); // NEED A WAY TO MAKE REFLECTION"
 "\n         vec3 mainColor = mix( v_color, texColor.rgb, texColor.a ); // v_uv.x >= 0. ? texColor.a : 0. );"
 "\n         color = vec4( mainColor * light, 1 );"
 "\n     }"
@@ -83,6 +135,7 @@ void CMarios::OnConsoleInit()
 	Console()->Register("mario_kill", "", CFGFLAG_CLIENT, ConMarioKill, this, "Kills Mario instantly");
 	Console()->Register("mario_music", "i[ID]", CFGFLAG_CLIENT, ConMarioMusic, this, "Play SM64 music. Valid music IDs from 0 to 34. ID 0 stops music");
 	Console()->Register("mario_cap", "s[cap]", CFGFLAG_CLIENT, ConMarioCap, this, "Switches Mario's cap: off, on, wing, metal");
+	Console()->Register("mario_benchmark", "?i[count]", CFGFLAG_CLIENT, ConMarioBenchmark, this, "Spawns Marios around you and logs the frame times (default 32)");
 }
 
 void CMarios::OnInit()
@@ -136,18 +189,34 @@ void CMarios::OnInit()
 			m_MarioTexture = (uint8_t*)malloc(4 * SM64_TEXTURE_WIDTH * SM64_TEXTURE_HEIGHT);
 
 			// load libsm64
-			sm64_global_init(romBuffer, m_MarioTexture, [](const char *msg) {dbg_msg("libsm64", "%s", msg);});
+			sm64_global_init_pull_audio(romBuffer, m_MarioTexture, [](const char *msg) {dbg_msg("libsm64", "%s", msg);});
+			// Mario's audio is generated inside our own mixer instead of libsm64's audio thread
+			Sound()->SetStream(CSounds::CHN_WORLD, SM64_AUDIO_RATE, [](short *pFrames, unsigned NumFrames, void *pUser) { sm64_audio_pull(pFrames, NumFrames); }, nullptr);
+			m_Loaded = true;
 			dbg_msg("libsm64", "Super Mario 64 US ROM loaded!");
 			sm64_play_sound_global(SOUND_MENU_STAR_SOUND);
 			free(romBuffer);
 
 			Graphics()->firstInitMario(&m_MarioShaderHandle, &m_MarioTexHandle, m_MarioTexture, MARIO_SHADER);
 
-			for(int i=0; i<3*SM64_GEO_MAX_TRIANGLES; i++) m_MarioIndices[i] = i;
+			m_BindPose.position = (float*)malloc( sizeof(float) * 9 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+			m_BindPose.normal   = (float*)malloc( sizeof(float) * 9 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+			m_BindPose.color    = (float*)malloc( sizeof(float) * 9 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+			m_BindPose.uv       = (float*)malloc( sizeof(float) * 6 * SM64_MARIO_BIND_POSE_MAX_TRIANGLES );
+			m_BindPose.numTrianglesUsed = 0;
 		}
 	}
 }
 
+void CMarios::OnShutdown()
+{
+	free(m_BindPose.position);
+	free(m_BindPose.normal);
+	free(m_BindPose.color);
+	free(m_BindPose.uv);
+	m_BindPose = {};
+}
+
 void CMarios::OnMapLoad()
 {
 	m_TeleOuts.clear();
@@ -172,34 +241,12 @@ void CMarios::OnMapLoad()
 		}
 	}
 
-	uint32_t surfaceCount = 2;
-	SM64Surface surfaces[surfaceCount];
-
-	for (uint32_t i=0; i<surfaceCount; i++)
-	{
-		surfaces[i].type = SURFACE_DEFAULT;
-		surfaces[i].force = 0;
-		surfaces[i].terrain = TERRAIN_STONE;
-	}
-	
-	int width = Collision()->GetWidth()/2 * 32 / (g_Config.m_MarioScale/100.f);
-	int spawnX = width;
-	int spawnY = (Collision()->GetHeight()+205) * 32 / (-g_Config.m_MarioScale/100.f);
-	
-	surfaces[surfaceCount-2].vertices[0][0] = spawnX + width + (400*32);	surfaces[surfaceCount-2].vertices[0][1] = spawnY;	surfaces[surfaceCount-2].vertices[0][2] = +128;
-	surfaces[surfaceCount-2].vertices[1][0] = spawnX - width - (400*32);	surfaces[surfaceCount-2].vertices[1][1] = spawnY;	surfaces[surfaceCount-2].vertices[1][2] = -128;
-	surfaces[surfaceCount-2].vertices[2][0] = spawnX - width - (400*32);	surfaces[surfaceCount-2].vertices[2][1] = spawnY;	surfaces[surfaceCount-2].vertices[2][2] = +128;
-
-	surfaces[surfaceCount-1].vertices[0][0] = spawnX - width - (400*32);	surfaces[surfaceCount-1].vertices[0][1] = spawnY;	surfaces[surfaceCount-1].vertices[0][2] = -128;
-	surfaces[surfaceCount-1].vertices[1][0] = spawnX + width + (400*32);	surfaces[surfaceCount-1].vertices[1][1] = spawnY;	surfaces[surfaceCount-1].vertices[1][2] = +128;
-	surfaces[surfaceCount-1].vertices[2][0] = spawnX + width + (400*32);	surfaces[surfaceCount-1].vertices[2][1] = spawnY;	surfaces[surfaceCount-1].vertices[2][2] = -128;
-
-	sm64_static_surfaces_load(surfaces, surfaceCount);
+	CMarioCore::LoadMapSurfaces(Collision(), g_Config.m_MarioScale/100.f);
 }
 
 void CMarios::OnStateChange(int NewState, int OldState)
 {
-	if (OldState == IClient::STATE_ONLINE)
+	if (OldState == IClient::STATE_ONLINE || OldState == IClient::STATE_DEMOPLAYBACK)
 	{
 		// disconnected, destroy all marios
 		for (int i=0; i<MAX_CLIENTS; i++)
@@ -208,12 +255,173 @@ void CMarios::OnStateChange(int NewState, int OldState)
 			{
 				delete m_pClient->m_GameWorld.m_Core.m_apMarios[i];
 				m_pClient->m_GameWorld.m_Core.m_apMarios[i] = 0;
+			}
+			DestroyPuppet(i);
+		}
+		DestroyPredictedMario();
+		StopBenchmark();
+
+		for (bool &Sent : m_aMarioInfoSent)
+			Sent = false;
+	}
+}
+
+void CMarios::SendMarioInfo(int Conn)
+{
+	CNetMsg_Cl_MarioInfo Msg;
+	Msg.m_Version = MARIO_NET_VERSION;
+	CMsgPacker Packer(Msg.MsgID(), false);
+	Msg.Pack(&Packer);
+	Client()->SendMsg(Conn, &Packer, MSGFLAG_VITAL);
+	m_aMarioInfoSent[Conn] = true;
+}
+
+void CMarios::DestroyPuppet(int ID)
+{
+	if (!m_apPuppets[ID])
+		return;
+
+	delete m_apPuppets[ID];
+	m_apPuppets[ID] = 0;
+}
+
+void CMarios::DestroyPredictedMario()
+{
+	if (!m_pPredicted)
+		return;
+
+	delete m_pPredicted;
+	m_pPredicted = nullptr;
+	m_PredictedID = -1;
+
+	for (CPredictedState &State : m_aPredictionHistory)
+		State.m_Tick = -1;
+	m_PredictionBase.m_Tick = -1;
+	m_LastSoundTick = -1;
+}
+
+// rewinds the predicted Mario to the snapshot's tick and corrects it with the server's Mario
+void CMarios::UpdatePredictedMario(int ID, const CNetObj_Mario *pObj)
+{
+	if (m_pPredicted && (m_PredictedID != ID || round_to_int(m_pPredicted->Scale()*100) != pObj->m_Scale))
+		DestroyPredictedMario();
+
+	int GameTick = Client()->GameTick(g_Config.m_ClDummy);
+	if (!m_pPredicted)
+	{
+		CMarioCore *mario = new CMarioCore;
+		mario->Init(&m_pClient->m_GameWorld.m_Core, Collision(), vec2(pObj->m_X, pObj->m_Y), pObj->m_Scale/100.f, &m_TeleOuts);
+		if (!mario->Spawned())
+		{
+			delete mario;
+			return;
+		}
+		m_pPredicted = mario;
+		m_PredictedID = ID;
+	}
+	else
+	{
+		const CPredictedState &Predicted = m_aPredictionHistory[GameTick % PREDICTION_HISTORY];
+		if (Predicted.m_Tick == GameTick)
+			m_pPredicted->RestoreState(Predicted.m_vState);
+	}
+
+	m_pPredicted->Reconcile(pObj);
+	m_pPredicted->SaveState(m_PredictionBase.m_vState);
+	m_PredictionBase.m_Tick = GameTick;
+}
 
-				CMarioMesh *mesh = &m_MarioMeshes[i];
-				Graphics()->destroyMario(mesh);
+void CMarios::OnPredict()
+{
+	if (!m_pPredicted || m_PredictionBase.m_Tick < 0)
+		return;
+
+	// replay our inputs from the last snapshot on, only the last few ticks are rendered and need a mesh
+	int PredTick = Client()->PredGameTick(g_Config.m_ClDummy);
+	m_pPredicted->RestoreState(m_PredictionBase.m_vState);
+	for (int Tick = m_PredictionBase.m_Tick + 1; Tick <= PredTick; Tick++)
+	{
+		if (const CNetObj_PlayerInput *pInput = (const CNetObj_PlayerInput *)Client()->GetInput(Tick))
+		{
+			m_pPredicted->input.stickX = -pInput->m_Direction;
+			m_pPredicted->input.buttonA = pInput->m_Jump;
+			m_pPredicted->input.buttonB = pInput->m_Fire & 1;
+			m_pPredicted->input.buttonZ = pInput->m_Hook;
+		}
+		m_pPredicted->m_GenerateGeometry = Tick > PredTick - 4;
+		m_pPredicted->m_GeneratePose = g_Config.m_MarioGpuSkinning;
+
+		sm64_set_sounds_muted(Tick <= m_LastSoundTick);
+		m_pPredicted->Tick(1.f/SERVER_TICK_SPEED);
+
+		CPredictedState &State = m_aPredictionHistory[Tick % PREDICTION_HISTORY];
+		State.m_Tick = Tick;
+		m_pPredicted->SaveState(State.m_vState);
+	}
+	sm64_set_sounds_muted(false);
+	m_LastSoundTick = maximum(m_LastSoundTick, PredTick);
+}
+
+void CMarios::OnNewSnapshot()
+{
+	if (!m_Loaded)
+		return;
+
+	// without it the server sends the laser outline of its Marios instead
+	if (Client()->State() == IClient::STATE_ONLINE)
+	{
+		if (!m_aMarioInfoSent[IClient::CONN_MAIN])
+			SendMarioInfo(IClient::CONN_MAIN);
+		if (!Client()->DummyConnected())
+			m_aMarioInfoSent[IClient::CONN_DUMMY] = false;
+		else if (!m_aMarioInfoSent[IClient::CONN_DUMMY])
+			SendMarioInfo(IClient::CONN_DUMMY);
+	}
+
+	bool aSnapped[MAX_CLIENTS] = {false};
+	bool Predicted = false;
+	const int LocalID = m_pClient->m_Snap.m_LocalClientID;
+	const bool Predict = g_Config.m_MarioPredict && Client()->State() == IClient::STATE_ONLINE;
+	int Num = Client()->SnapNumItems(IClient::SNAP_CURRENT);
+	for (int i = 0; i < Num; i++)
+	{
+		IClient::CSnapItem Item;
+		const void *pData = Client()->SnapGetItem(IClient::SNAP_CURRENT, i, &Item);
+		if (Item.m_Type != NETOBJTYPE_MARIO || Item.m_ID < 0 || Item.m_ID >= MAX_CLIENTS)
+			continue;
+
+		int ID = Item.m_ID;
+		if (Predict && ID == LocalID)
+		{
+			UpdatePredictedMario(ID, (const CNetObj_Mario *)pData);
+			Predicted = m_pPredicted != nullptr;
+			if (Predicted)
+				continue;
+		}
+
+		bool FirstPose = !m_apPuppets[ID];
+		if (FirstPose)
+		{
+			CMarioCore *mario = new CMarioCore;
+			mario->InitPuppet();
+			if (!mario->Spawned())
+			{
+				delete mario;
+				continue;
 			}
+			m_apPuppets[ID] = mario;
 		}
+
+		m_apPuppets[ID]->m_GeneratePose = g_Config.m_MarioGpuSkinning;
+		m_apPuppets[ID]->PosePuppet((const CNetObj_Mario *)pData, FirstPose);
+		aSnapped[ID] = true;
 	}
+
+	for (int i = 0; i < MAX_CLIENTS; i++)
+		if (!aSnapped[i])
+			DestroyPuppet(i);
+	if (!Predicted)
+		DestroyPredictedMario();
 }
 
 void CMarios::TickAndRenderMario(int ID)
@@ -258,8 +466,30 @@ void CMarios::TickAndRenderMario(int ID)
 		}
 	}
 
+	mario->m_GeneratePose = g_Config.m_MarioGpuSkinning;
 	mario->Tick(Client()->RenderFrameTime());
 
+	RenderMario(mario, g_Config.m_MarioCustomColors, g_Config.m_ClPlayerColorBody, g_Config.m_ClPlayerColorFeet);
+}
+
+void CMarios::RenderMario(CMarioCore *mario, bool CustomColors, int ColorBody, int ColorFeet)
+{
+	if (mario->m_GeneratePose)
+	{
+		// the shader recolors the bind pose like the loop below does
+		if (mario->pose.numPartsUsed)
+		{
+			CMarioPoseRenderInfo Info;
+			Info.m_pPose = &mario->pose;
+			Info.m_CapFlag = mario->state.flags;
+			Info.m_CustomColors = CustomColors;
+			Info.m_BodyColor = color_cast<ColorRGBA>(ColorHSLA(ColorBody).UnclampLighting());
+			Info.m_FeetColor = color_cast<ColorRGBA>(ColorHSLA(ColorFeet).UnclampLighting());
+			m_vPoseRenderInfos.push_back(Info);
+		}
+		return;
+	}
+
 	if (mario->state.flags & MARIO_METAL_CAP)
 	{
 		for (int i=0; i<mario->geometry.numTrianglesUsed; i++)
@@ -273,10 +503,10 @@ void CMarios::TickAndRenderMario(int ID)
 			for (int j=0; j<9; j++) mario->geometry.color[i*9+j] = 0; // needs fix
 		}
 	}
-	else if (g_Config.m_MarioCustomColors)
+	else if (CustomColors)
 	{
-		ColorRGBA bodyColor = color_cast<ColorRGBA>(ColorHSLA(g_Config.m_ClPlayerColorBody).UnclampLighting());
-		ColorRGBA feetColor = color_cast<ColorRGBA>(ColorHSLA(g_Config.m_ClPlayerColorFeet).UnclampLighting());
+		ColorRGBA bodyColor = color_cast<ColorRGBA>(ColorHSLA(ColorBody).UnclampLighting());
+		ColorRGBA feetColor = color_cast<ColorRGBA>(ColorHSLA(ColorFeet).UnclampLighting());
 		for (int i=0; i<mario->geometry.numTrianglesUsed; i++)
 		{
 			uint8_t r = mario->geometry.color[i*9+0]*255;
@@ -319,19 +549,145 @@ void CMarios::TickAndRenderMario(int ID)
 		}
 	}
 
-	CMarioMesh *mesh = &m_MarioMeshes[ID];
 	if (mario->geometry.numTrianglesUsed)
-		Graphics()->updateAndRenderMario(mesh, &mario->geometry, mario->state.flags, &m_MarioShaderHandle, &m_MarioTexHandle, m_MarioIndices);
+		m_vRenderInfos.push_back({&mario->geometry, mario->state.flags});
 }
 
 void CMarios::OnRender()
 {
+	const int64_t Now = time_get();
 	for (int i=0; i<MAX_CLIENTS; i++)
 	{
 		CMarioCore *mario = m_pClient->m_GameWorld.m_Core.m_apMarios[i];
 		if (!mario) continue;
 		TickAndRenderMario(i);
 	}
+
+	float IntraTick = Client()->IntraGameTick(g_Config.m_ClDummy);
+	for (int i=0; i<MAX_CLIENTS; i++)
+	{
+		CMarioCore *mario = m_apPuppets[i];
+		if (!mario) continue;
+
+		const CGameClient::CClientData &ClientData = m_pClient->m_aClients[i];
+		mario->InterpolatePuppet(IntraTick);
+		RenderMario(mario, g_Config.m_MarioCustomColors && ClientData.m_UseCustomColor, ClientData.m_ColorBody, ClientData.m_ColorFeet);
+	}
+
+	if (m_pPredicted)
+	{
+		const CGameClient::CClientData &ClientData = m_pClient->m_aClients[m_PredictedID];
+		m_pPredicted->InterpolatePredicted(Client()->PredIntraGameTick(g_Config.m_ClDummy));
+		RenderMario(m_pPredicted, g_Config.m_MarioCustomColors && ClientData.m_UseCustomColor, ClientData.m_ColorBody, ClientData.m_ColorFeet);
+	}
+
+	const int64_t BenchmarkMariosStart = time_get();
+	for (int i=0; i<(int)m_vpBenchmarkMarios.size(); i++)
+	{
+		// walk back and forth, turning around at different times so they don't move in lockstep
+		CMarioCore *mario = m_vpBenchmarkMarios[i];
+		mario->input.stickX = (Now / time_freq() + i) % 4 < 2 ? 1 : -1;
+		mario->input.stickY = 0;
+		mario->input.buttonA = (Now / (time_freq() / 2) + i) % 7 == 0;
+		mario->m_GeneratePose = g_Config.m_MarioGpuSkinning;
+		mario->Tick(Client()->RenderFrameTime());
+		RenderMario(mario, false, 0, 0);
+	}
+	const int64_t BenchmarkMariosTime = time_get() - BenchmarkMariosStart;
+
+	if (!m_vRenderInfos.empty())
+	{
+		Graphics()->renderMarios(m_vRenderInfos.data(), m_vRenderInfos.size(), &m_MarioShaderHandle, &m_MarioTexHandle);
+		m_vRenderInfos.clear();
+	}
+	if (!m_vPoseRenderInfos.empty())
+	{
+		// parts drawn for the first time this frame were added to the end of the bind pose
+		int FirstTriangle = m_BindPose.numTrianglesUsed;
+		sm64_mario_update_bind_pose(&m_BindPose);
+		if (m_BindPose.numTrianglesUsed > FirstTriangle)
+			Graphics()->uploadMarioBindPose(&m_BindPose, FirstTriangle);
+
+		Graphics()->renderMarioPoses(m_vPoseRenderInfos.data(), m_vPoseRenderInfos.size(), &m_MarioShaderHandle, &m_MarioTexHandle);
+		m_vPoseRenderInfos.clear();
+	}
+
+	if (!m_vpBenchmarkMarios.empty())
+	{
+		if (m_BenchmarkFrames == 0)
+			m_BenchmarkStart = Now;
+		else
+			m_BenchmarkMaxFrameTime = maximum(m_BenchmarkMaxFrameTime, Now - m_BenchmarkLastFrame);
+		m_BenchmarkLastFrame = Now;
+		m_BenchmarkFrames++;
+		m_BenchmarkRenderTime += time_get() - Now;
+		m_BenchmarkMarioTime += BenchmarkMariosTime;
+		if (Now - m_BenchmarkStart > BENCHMARK_SECONDS * time_freq())
+			StopBenchmark();
+	}
+}
+
+void CMarios::StopBenchmark()
+{
+	if (m_vpBenchmarkMarios.empty())
+		return;
+
+	if (m_BenchmarkFrames > 1)
+	{
+		const double Freq = time_freq();
+		char aBuf[256];
+		str_format(aBuf, sizeof(aBuf), "%d Marios, %d frames: %.2f ms per frame, worst %.2f ms, %.3f ms per frame in CMarios::OnRender, %.1f us per Mario per frame",
+			(int)m_vpBenchmarkMarios.size(), m_BenchmarkFrames,
+			(m_BenchmarkLastFrame - m_BenchmarkStart) * 1000.0 / Freq / (m_BenchmarkFrames - 1),
+			m_BenchmarkMaxFrameTime * 1000.0 / Freq,
+			m_BenchmarkRenderTime * 1000.0 / Freq / m_BenchmarkFrames,
+			m_BenchmarkMarioTime * 1000000.0 / Freq / m_BenchmarkFrames / m_vpBenchmarkMarios.size());
+		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "libsm64", aBuf);
+	}
+
+	for (CMarioCore *mario : m_vpBenchmarkMarios)
+		delete mario;
+	m_vpBenchmarkMarios.clear();
+}
+
+void CMarios::ConMarioBenchmark(IConsole::IResult *pResult, void *pUserData)
+{
+	CMarios *pSelf = (CMarios*)pUserData;
+	if (!pSelf->m_vpBenchmarkMarios.empty())
+	{
+		pSelf->StopBenchmark();
+		return;
+	}
+
+	int ID = pSelf->m_pClient->m_Snap.m_LocalClientID;
+	if (!pSelf->m_Loaded || ID < 0 || !pSelf->m_pClient->m_aClients[ID].m_Active)
+	{
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "libsm64", "You must be in-game to run the benchmark");
+		return;
+	}
+
+	int Count = pResult->NumArguments() ? clamp(pResult->GetInteger(0), 1, (int)MAX_CLIENTS) : 32;
+	for (int i=0; i<Count; i++)
+	{
+		// side by side in a line, two tiles apart
+		vec2 Pos = pSelf->m_pClient->m_LocalCharacterPos + vec2((i - Count / 2) * 64, 0);
+		CMarioCore *mario = new CMarioCore;
+		mario->Init(&pSelf->m_pClient->m_GameWorld.m_Core, pSelf->Collision(), Pos, g_Config.m_MarioScale/100.f, &pSelf->m_TeleOuts);
+		if (!mario->Spawned())
+		{
+			delete mario;
+			continue;
+		}
+		pSelf->m_vpBenchmarkMarios.push_back(mario);
+	}
+
+	char aBuf[128];
+	str_format(aBuf, sizeof(aBuf), "Spawned %d Marios for %d seconds", (int)pSelf->m_vpBenchmarkMarios.size(), (int)BENCHMARK_SECONDS);
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "libsm64", aBuf);
+	pSelf->m_BenchmarkFrames = 0;
+	pSelf->m_BenchmarkMaxFrameTime = 0;
+	pSelf->m_BenchmarkRenderTime = 0;
+	pSelf->m_BenchmarkMarioTime = 0;
 }
 
 void CMarios::ConMario(IConsole::IResult *pResult, void *pUserData)
@@ -359,18 +715,12 @@ void CMarios::ConMario(IConsole::IResult *pResult, void *pUserData)
 
 		pSelf->m_pClient->m_GameWorld.m_Core.m_apMarios[ID] = mario;
 
-		// create mario vertex
-		CMarioMesh *mesh = &pSelf->m_MarioMeshes[ID];
-		pSelf->Graphics()->initMario(mesh, &mario->geometry);
 	}
 	else
 	{
 		delete pSelf->m_pClient->m_GameWorld.m_Core.m_apMarios[ID];
 		pSelf->m_pClient->m_GameWorld.m_Core.m_apMarios[ID] = 0;
 
-		CMarioMesh *mesh = &pSelf->m_MarioMeshes[ID];
-		pSelf->Graphics()->destroyMario(mesh);
-
 		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_ADDINFO, "libsm64", "Deleted Mario");
 	}
 }
@@ -9,6 +9,9 @@
 #include <game/generated/protocol.h>
 
 #include <map>
+#include <vector>
+
+class CMarioCore;
 
 extern "C" {
 	#include <libsm64.h>
@@ -21,11 +24,14 @@ class CMarios : public CComponent
 public:
 	virtual int Sizeof() const override { return sizeof(*this); }
 	virtual void OnInit() override;
+	virtual void OnShutdown() override;
 	virtual void OnConsoleInit() override;
 	virtual void OnMapLoad() override;
 	virtual void OnStateChange(int NewState, int OldState) override;
 	virtual void OnRender() override;
 
+	void OnNewSnapshot();
+	void OnPredict();
 	void TickAndRenderMario(int ID);
 
 private:
@@ -33,10 +39,56 @@ private:
 	static void ConMarioKill(IConsole::IResult *pResult, void *pUserData);
 	static void ConMarioMusic(IConsole::IResult *pResult, void *pUserData);
 	static void ConMarioCap(IConsole::IResult *pResult, void *pUserData);
+	static void ConMarioBenchmark(IConsole::IResult *pResult, void *pUserData);
+
+	void RenderMario(CMarioCore *pMario, bool CustomColors, int ColorBody, int ColorFeet);
+	void SendMarioInfo(int Conn);
+	void DestroyPuppet(int ID);
+	void UpdatePredictedMario(int ID, const CNetObj_Mario *pObj);
+	void DestroyPredictedMario();
+
+	bool m_Loaded = false;
+	bool m_aMarioInfoSent[NUM_DUMMIES] = {};
+
+	// Marios simulated by the server, posed from their CNetObj_Mario. the index is the owner's client ID
+	CMarioCore *m_apPuppets[MAX_CLIENTS] = {};
+
+	// our own Mario simulated by the server, predicted from the last snapshot like the characters in CGameClient::OnPredict
+	enum
+	{
+		PREDICTION_HISTORY = 64, // ticks
+	};
+	struct CPredictedState
+	{
+		int m_Tick = -1;
+		std::vector<uint8_t> m_vState;
+	};
+	CMarioCore *m_pPredicted = nullptr;
+	int m_PredictedID = -1;
+	CPredictedState m_aPredictionHistory[PREDICTION_HISTORY];
+	CPredictedState m_PredictionBase; // the prediction of the last snapshot's tick, corrected with the server's Mario
+	int m_LastSoundTick = -1; // sounds of ticks up to this one were played already, replays are muted
+
+	// mario_benchmark: extra Marios walking around the local player, the frame times are logged at the end
+	enum
+	{
+		BENCHMARK_SECONDS = 10,
+	};
+	std::vector<CMarioCore *> m_vpBenchmarkMarios;
+	int64_t m_BenchmarkStart = 0;
+	int64_t m_BenchmarkLastFrame = 0;
+	int64_t m_BenchmarkMaxFrameTime = 0;
+	int64_t m_BenchmarkRenderTime = 0;
+	int64_t m_BenchmarkMarioTime = 0; // ticking and preparing the benchmark Marios, without the drawing
+	int m_BenchmarkFrames = 0;
+	void StopBenchmark();
 
-	CMarioMesh m_MarioMeshes[MAX_CLIENTS];
+	// all Marios of the frame are drawn together at the end of OnRender
+	std::vector<CMarioRenderInfo> m_vRenderInfos;
+	std::vector<CMarioPoseRenderInfo> m_vPoseRenderInfos;
+	// with mario_gpu_skinning: the bind pose mesh of the posed Marios, new parts are uploaded when they're first drawn
+	SM64MarioGeometryBuffers m_BindPose = {};
 	uint8_t *m_MarioTexture;
-	uint16_t m_MarioIndices[SM64_GEO_MAX_TRIANGLES * 3];
 	uint32_t m_MarioTexHandle;
 	uint32_t m_MarioShaderHandle;
 };
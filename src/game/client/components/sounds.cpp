@@ -16,6 +16,8 @@ CSoundLoading::CSoundLoading(CGameClient *pGameClient, bool Render) :
 	m_pGameClient(pGameClient),
 	m_Render(Render)
 {
+	// the client can't start before the sounds are decoded, don't queue behind skins
+	SetPriority(PRIORITY_HIGH);
 }
 
 void CSoundLoading::Run()
@@ -1706,6 +1706,7 @@ void CGameClient::OnNewSnapshot()
 
 	m_Ghost.OnNewSnapshot();
 	m_RaceDemo.OnNewSnapshot();
+	m_Marios.OnNewSnapshot();
 
 	// detect air jump for other players
 	for(int i = 0; i < MAX_CLIENTS; i++)
@@ -1757,6 +1758,8 @@ void CGameClient::OnPredict()
 		return;
 	}
 
+	m_Marios.OnPredict();
+
 	vec2 aBeforeRender[MAX_CLIENTS];
 	for(int i = 0; i < MAX_CLIENTS; i++)
 		aBeforeRender[i] = GetSmoothPos(i);
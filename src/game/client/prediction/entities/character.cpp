@@ -1035,10 +1035,20 @@ void CCharacter::DDRacePostCoreTick()
 	HandleSkippableTiles(CurrentIndex);
 
 	// handle Anti-Skip tiles
-	std::list<int> Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
-		for(int Index : Indices)
-			HandleTiles(Index);
+	int aIndices[64];
+	const int *pIndices = aIndices;
+	std::vector<int> vIndices;
+	int NumIndices = Collision()->GetMapIndices(m_PrevPos, m_Pos, aIndices, std::size(aIndices));
+	if(NumIndices > (int)std::size(aIndices))
+	{
+		// only long moves like teleports pass this many tiles
+		vIndices.resize(NumIndices);
+		Collision()->GetMapIndices(m_PrevPos, m_Pos, vIndices.data(), NumIndices);
+		pIndices = vIndices.data();
+	}
+	if(NumIndices)
+		for(int i = 0; i < NumIndices; i++)
+			HandleTiles(pIndices[i]);
 	else
 	{
 		HandleTiles(CurrentIndex);
@@ -7,6 +7,7 @@
 #include <antibot/antibot_data.h>
 
 #include <cmath>
+#include <limits>
 #include <engine/map.h>
 
 #include <game/collision.h>
@@ -131,6 +132,10 @@ void CCollision::Init(class CLayers *pLayers)
 			}
 		}
 	}
+
+	m_vTileExists.resize((size_t)m_Width * m_Height);
+	for(int i = 0; i < m_Width * m_Height; i++)
+		m_vTileExists[i] = ComputeTileExists(i);
 }
 
 void CCollision::FillAntibot(CAntibotMapData *pMapData)
@@ -288,6 +293,82 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
+// Line checks sample the line every pixel. This walks the tiles along the line instead and returns the first
+// sample that can land on a tile IsCandidate accepts, all samples before it can be skipped. The line is widened
+// by a margin so that samples rounded to the next pixel are covered. Returns INT_MAX if no sample after From can.
+// Callers step every pixel again for a tile's worth of samples after a candidate before walking further
+template<typename F>
+int CCollision::FirstCandidateSample(vec2 Pos0, vec2 Pos1, int From, float NumSamples, F IsCandidate) const
+{
+	const float Margin = 2.0f;
+	const float Inf = std::numeric_limits<float>::infinity();
+	const vec2 Dir = Pos1 - Pos0;
+	const float Start = From / NumSamples;
+
+	auto TileOf = [](float Coord, int Size) { return clamp((int)std::floor(Coord / 32), 0, Size - 1); };
+	// the parameter range in which the widened line overlaps a row or column of tiles
+	auto Overlap = [&](float Coord0, float Delta, int Tile, int Size, float *pEnter, float *pExit) {
+		float Lo = Tile == 0 ? -Inf : Tile * 32 - Margin;
+		float Hi = Tile == Size - 1 ? Inf : (Tile + 1) * 32 + Margin;
+		if(Delta > 0)
+		{
+			*pEnter = (Lo - Coord0) / Delta;
+			*pExit = (Hi - Coord0) / Delta;
+		}
+		else if(Delta < 0)
+		{
+			*pEnter = (Hi - Coord0) / Delta;
+			*pExit = (Lo - Coord0) / Delta;
+		}
+		else
+		{
+			*pEnter = Coord0 > Lo && Coord0 < Hi ? -Inf : Inf;
+			*pExit = Inf;
+		}
+	};
+
+	const int StepX = Dir.x < 0 ? -1 : 1;
+	const int StepY = Dir.y < 0 ? -1 : 1;
+	const float StartX = Pos0.x + Dir.x * Start;
+	const int FirstColumn = TileOf(StartX - StepX * Margin, m_Width);
+	const int LastColumn = TileOf((Dir.x ? Pos1.x : StartX) + StepX * Margin, m_Width);
+
+	float Best = Inf;
+	for(int x = FirstColumn; x != LastColumn + StepX; x += StepX)
+	{
+		float ColumnEnter, ColumnExit;
+		Overlap(Pos0.x, Dir.x, x, m_Width, &ColumnEnter, &ColumnExit);
+		ColumnEnter = maximum(ColumnEnter, Start);
+		ColumnExit = minimum(ColumnExit, 1.0f);
+		if(ColumnEnter >= Best)
+			break;
+		if(ColumnEnter > ColumnExit)
+			continue;
+
+		float YEnter = Pos0.y + Dir.y * ColumnEnter;
+		float YExit = Pos0.y + Dir.y * ColumnExit;
+		const int FirstRow = TileOf(YEnter - StepY * Margin, m_Height);
+		const int LastRow = TileOf(YExit + StepY * Margin, m_Height);
+		for(int y = FirstRow; y != LastRow + StepY; y += StepY)
+		{
+			float RowEnter, RowExit;
+			Overlap(Pos0.y, Dir.y, y, m_Height, &RowEnter, &RowExit);
+			RowEnter = maximum(RowEnter, ColumnEnter);
+			if(RowEnter >= Best)
+				break;
+			if(RowEnter <= minimum(RowExit, ColumnExit) && IsCandidate(y * m_Width + x))
+			{
+				Best = RowEnter;
+				break;
+			}
+		}
+	}
+
+	if(Best > 1.0f)
+		return std::numeric_limits<int>::max();
+	return maximum(From, (int)std::floor(Best * NumSamples) - 1);
+}
+
 // TODO: rewrite this smarter!
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
@@ -295,8 +376,22 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 	int End(Distance + 1);
 	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	auto IsCandidate = [this](int Index) { return m_pTiles[Index].m_Index == TILE_SOLID || m_pTiles[Index].m_Index == TILE_NOHOOK; };
+	for(int i = 0, NextWalk = 0; i <= End; i++)
 	{
+		if(i >= NextWalk)
+		{
+			int Skip = FirstCandidateSample(Pos0, Pos1, i, End, IsCandidate);
+			if(Skip > End)
+				break;
+			if(Skip > i)
+			{
+				i = Skip;
+				Last = mix(Pos0, Pos1, (i - 1) / (float)End);
+			}
+			NextWalk = i + 32;
+		}
+
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		ix = round_to_int(Pos.x);
@@ -328,8 +423,28 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 	int ix = 0, iy = 0; // Temporary position for checking collision
 	int dx = 0, dy = 0; // Offset for checking the "through" tile
 	ThroughOffset(Pos0, Pos1, &dx, &dy);
-	for(int i = 0; i <= End; i++)
+	auto IsCandidate = [this](int Index) {
+		int Tile = m_pTiles[Index].m_Index;
+		int FTile = m_pFront ? m_pFront[Index].m_Index : 0;
+		return Tile == TILE_SOLID || Tile == TILE_NOHOOK || Tile == TILE_THROUGH_ALL || Tile == TILE_THROUGH_DIR ||
+		       FTile == TILE_THROUGH_ALL || FTile == TILE_THROUGH_DIR || (m_pTele && m_pTele[Index].m_Type);
+	};
+	*pTeleNr = 0;
+	for(int i = 0, NextWalk = 0; i <= End; i++)
 	{
+		if(i >= NextWalk)
+		{
+			int Skip = FirstCandidateSample(Pos0, Pos1, i, End, IsCandidate);
+			if(Skip > End)
+				break;
+			if(Skip > i)
+			{
+				i = Skip;
+				Last = mix(Pos0, Pos1, (i - 1) / (float)End);
+			}
+			NextWalk = i + 32;
+		}
+
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		ix = round_to_int(Pos.x);
@@ -383,8 +498,25 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 	int End(Distance + 1);
 	vec2 Last = Pos0;
 	int ix = 0, iy = 0; // Temporary position for checking collision
-	for(int i = 0; i <= End; i++)
+	auto IsCandidate = [this](int Index) {
+		return m_pTiles[Index].m_Index == TILE_SOLID || m_pTiles[Index].m_Index == TILE_NOHOOK || (m_pTele && m_pTele[Index].m_Type);
+	};
+	*pTeleNr = 0;
+	for(int i = 0, NextWalk = 0; i <= End; i++)
 	{
+		if(i >= NextWalk)
+		{
+			int Skip = FirstCandidateSample(Pos0, Pos1, i, End, IsCandidate);
+			if(Skip > End)
+				break;
+			if(Skip > i)
+			{
+				i = Skip;
+				Last = mix(Pos0, Pos1, (i - 1) / (float)End);
+			}
+			NextWalk = i + 32;
+		}
+
 		float a = i / (float)End;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		ix = round_to_int(Pos.x);
@@ -558,6 +690,7 @@ void CCollision::Dest()
 	m_pSwitch = 0;
 	m_pTune = 0;
 	m_pDoor = 0;
+	m_vTileExists.clear();
 }
 
 int CCollision::IsSolid(int x, int y) const
@@ -817,6 +950,14 @@ int CCollision::GetPureMapIndex(float x, float y) const
 }
 
 bool CCollision::TileExists(int Index) const
+{
+	if(Index < 0)
+		return false;
+	return m_vTileExists[Index];
+}
+
+// the checks behind TileExists, done once per tile in Init and again when a tile changes
+bool CCollision::ComputeTileExists(int Index) const
 {
 	if(Index < 0)
 		return false;
@@ -892,9 +1033,9 @@ int CCollision::GetMapIndex(vec2 Pos) const
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
+template<typename F>
+void CCollision::ForEachMapIndex(vec2 PrevPos, vec2 Pos, F Visit) const
 {
-	std::list<int> Indices;
 	float d = distance(PrevPos, Pos);
 	int End(d + 1);
 	if(!d)
@@ -904,12 +1045,7 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 		int Index = Ny * m_Width + Nx;
 
 		if(TileExists(Index))
-		{
-			Indices.push_back(Index);
-			return Indices;
-		}
-		else
-			return Indices;
+			Visit(Index);
 	}
 	else
 	{
@@ -918,8 +1054,17 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 		int Nx = 0;
 		int Ny = 0;
 		int Index, LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		auto IsCandidate = [this](int TileIndex) { return m_vTileExists[TileIndex] != 0; };
+		// character moves are mostly shorter than a tile, stepping them is cheaper than walking
+		for(int i = 0, NextWalk = End < 32 ? End : 0; i < End; i++)
 		{
+			if(i >= NextWalk)
+			{
+				i = FirstCandidateSample(PrevPos, Pos, i, d, IsCandidate);
+				if(i >= End)
+					break;
+				NextWalk = i + 32;
+			}
 			a = i / d;
 			Tmp = mix(PrevPos, Pos, a);
 			Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
@@ -927,17 +1072,38 @@ std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxInd
 			Index = Ny * m_Width + Nx;
 			if(TileExists(Index) && LastIndex != Index)
 			{
-				if(MaxIndices && Indices.size() > MaxIndices)
-					return Indices;
-				Indices.push_back(Index);
+				if(!Visit(Index))
+					return;
 				LastIndex = Index;
 			}
 		}
-
-		return Indices;
 	}
 }
 
+std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
+{
+	std::list<int> Indices;
+	ForEachMapIndex(PrevPos, Pos, [&](int Index) {
+		if(MaxIndices && Indices.size() > MaxIndices)
+			return false;
+		Indices.push_back(Index);
+		return true;
+	});
+	return Indices;
+}
+
+int CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices) const
+{
+	int NumIndices = 0;
+	ForEachMapIndex(PrevPos, Pos, [&](int Index) {
+		if(NumIndices < MaxIndices)
+			pIndices[NumIndices] = Index;
+		NumIndices++;
+		return true;
+	});
+	return NumIndices;
+}
+
 vec2 CCollision::GetPos(int Index) const
 {
 	if(Index < 0)
@@ -1094,6 +1260,7 @@ void CCollision::SetCollisionAt(float x, float y, int id)
 	int Ny = clamp(round_to_int(y) / 32, 0, m_Height - 1);
 
 	m_pTiles[Ny * m_Width + Nx].m_Index = id;
+	UpdateTileExists(Ny * m_Width + Nx);
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1106,6 +1273,16 @@ void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Numb
 	m_pDoor[Ny * m_Width + Nx].m_Index = Type;
 	m_pDoor[Ny * m_Width + Nx].m_Flags = Flags;
 	m_pDoor[Ny * m_Width + Nx].m_Number = Number;
+	UpdateTileExists(Ny * m_Width + Nx);
+}
+
+void CCollision::UpdateTileExists(int Index)
+{
+	// the tiles around also depend on this one, see TileExistsNext
+	const int aIndices[] = {Index, Index - 1, Index + 1, Index - m_Width, Index + m_Width};
+	for(int i : aIndices)
+		if(i >= 0 && i < m_Width * m_Height)
+			m_vTileExists[i] = ComputeTileExists(i);
 }
 
 int CCollision::GetDTileIndex(int Index) const
@@ -1167,9 +1344,26 @@ int CCollision::IntersectNoLaser(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2
 {
 	float d = distance(Pos0, Pos1);
 	vec2 Last = Pos0;
+	auto IsCandidate = [this](int Index) {
+		int Tile = m_pTiles[Index].m_Index;
+		return Tile == TILE_SOLID || Tile == TILE_NOHOOK || Tile == TILE_NOLASER || (m_pFront && m_pFront[Index].m_Index == TILE_NOLASER);
+	};
 
-	for(int i = 0, id = (int)ceilf(d); i < id; i++)
+	for(int i = 0, id = (int)ceilf(d), NextWalk = 0; i < id; i++)
 	{
+		if(i >= NextWalk)
+		{
+			int Skip = FirstCandidateSample(Pos0, Pos1, i, d, IsCandidate);
+			if(Skip >= id)
+				break;
+			if(Skip > i)
+			{
+				i = Skip;
+				Last = mix(Pos0, Pos1, (int)(i - 1) / d);
+			}
+			NextWalk = i + 32;
+		}
+
 		float a = (int)i / d;
 		vec2 Pos = mix(Pos0, Pos1, a);
 		int Nx = clamp(round_to_int(Pos.x) / 32, 0, m_Width - 1);
@@ -7,6 +7,7 @@
 #include <engine/shared/protocol.h>
 
 #include <list>
+#include <vector>
 
 enum
 {
@@ -74,8 +75,12 @@ public:
 	int GetPureMapIndex(float x, float y) const;
 	int GetPureMapIndex(vec2 Pos) const { return GetPureMapIndex(Pos.x, Pos.y); }
 	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
+	// writes at most MaxIndices indices to pIndices without allocating and returns how many there are in total,
+	// call it again with a bigger buffer if that's more than MaxIndices
+	int GetMapIndices(vec2 PrevPos, vec2 Pos, int *pIndices, int MaxIndices) const;
 	int GetMapIndex(vec2 Pos) const;
 	bool TileExists(int Index) const;
+	bool ComputeTileExists(int Index) const;
 	bool TileExistsNext(int Index) const;
 	vec2 GetPos(int Index) const;
 	int GetTileIndex(int Index) const;
@@ -123,6 +128,15 @@ private:
 	class CSwitchTile *m_pSwitch;
 	class CTuneTile *m_pTune;
 	class CDoorTile *m_pDoor;
+
+	// whether each tile has anything a character reacts to, so GetMapIndices doesn't have to check every layer
+	std::vector<uint8_t> m_vTileExists;
+	void UpdateTileExists(int Index);
+
+	template<typename F>
+	void ForEachMapIndex(vec2 PrevPos, vec2 Pos, F Visit) const;
+	template<typename F>
+	int FirstCandidateSample(vec2 Pos0, vec2 Pos1, int From, float NumSamples, F IsCandidate) const;
 };
 
 void ThroughOffset(vec2 Pos0, vec2 Pos1, int *pOffsetX, int *pOffsetY);
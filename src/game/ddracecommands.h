@@ -61,4 +61,6 @@ CONSOLE_COMMAND("save_dry", "", CFGFLAG_SERVER, ConDrySave, this, "Dump the curr
 
 CONSOLE_COMMAND("freezehammer", "v[id]", CFGFLAG_SERVER | CMDFLAG_TEST, ConFreezeHammer, this, "Gives a player Freeze Hammer")
 CONSOLE_COMMAND("unfreezehammer", "v[id]", CFGFLAG_SERVER | CMDFLAG_TEST, ConUnFreezeHammer, this, "Removes Freeze Hammer from a player")
+
+CONSOLE_COMMAND("mario_surfaces", "", CFGFLAG_SERVER, ConMarioSurfaces, this, "Shows the number of Marios, shared blocks and loaded libsm64 surfaces")
 #undef CONSOLE_COMMAND
@@ -2,8 +2,17 @@
 #include <limits.h>
 #include <string.h>
 
+#include <mutex>
+
+#include <base/detect.h>
 #include <base/math.h>
 
+#if defined(CONF_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(CONF_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
 #include <engine/shared/config.h>
 
 #include "mariocore.h"
@@ -15,6 +24,62 @@ extern "C" {
 	#include <decomp/include/surface_terrains.h>
 }
 
+float CMarioCore::ms_MapSurfacesScale = 0;
+CCollision *CMarioCore::ms_pMapSurfacesCollision = nullptr;
+int CMarioCore::ms_NumMapSurfacesMarios = 0;
+static std::mutex s_TeleRandomMutex;
+std::map<CMarioCore::SharedBlockKey, CMarioCore::CSharedBlock> CMarioCore::ms_SharedBlocks;
+
+// out = in * scale + offset for xyz positions, numFloats is a multiple of 3
+static void transformPositions(float *pOut, const float *pIn, int numFloats, const float aScale[3], const float aOffset[3])
+{
+	int i = 0;
+#if defined(CONF_SIMD_SSE2)
+	// 4 vertices are 3 vectors: xyzx yzxy zxyz
+	const __m128 aS[3] = {_mm_setr_ps(aScale[0], aScale[1], aScale[2], aScale[0]), _mm_setr_ps(aScale[1], aScale[2], aScale[0], aScale[1]), _mm_setr_ps(aScale[2], aScale[0], aScale[1], aScale[2])};
+	const __m128 aO[3] = {_mm_setr_ps(aOffset[0], aOffset[1], aOffset[2], aOffset[0]), _mm_setr_ps(aOffset[1], aOffset[2], aOffset[0], aOffset[1]), _mm_setr_ps(aOffset[2], aOffset[0], aOffset[1], aOffset[2])};
+	for (; i + 12 <= numFloats; i += 12)
+	{
+		for (int j=0; j<3; j++)
+			_mm_storeu_ps(pOut + i + j*4, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pIn + i + j*4), aS[j]), aO[j]));
+	}
+#elif defined(CONF_SIMD_NEON)
+	const float aS4[12] = {aScale[0], aScale[1], aScale[2], aScale[0], aScale[1], aScale[2], aScale[0], aScale[1], aScale[2], aScale[0], aScale[1], aScale[2]};
+	const float aO4[12] = {aOffset[0], aOffset[1], aOffset[2], aOffset[0], aOffset[1], aOffset[2], aOffset[0], aOffset[1], aOffset[2], aOffset[0], aOffset[1], aOffset[2]};
+	const float32x4_t aS[3] = {vld1q_f32(aS4), vld1q_f32(aS4 + 4), vld1q_f32(aS4 + 8)};
+	const float32x4_t aO[3] = {vld1q_f32(aO4), vld1q_f32(aO4 + 4), vld1q_f32(aO4 + 8)};
+	for (; i + 12 <= numFloats; i += 12)
+	{
+		for (int j=0; j<3; j++)
+			vst1q_f32(pOut + i + j*4, vmlaq_f32(aO[j], vld1q_f32(pIn + i + j*4), aS[j]));
+	}
+#endif
+	for (; i < numFloats; i++)
+		pOut[i] = pIn[i] * aScale[i%3] + aOffset[i%3];
+}
+
+static void mixPositions(float *pOut, const float *pFrom, const float *pTo, int numFloats, float amount)
+{
+	int i = 0;
+#if defined(CONF_SIMD_SSE2)
+	const __m128 Amount = _mm_set1_ps(amount);
+	for (; i + 4 <= numFloats; i += 4)
+	{
+		__m128 From = _mm_loadu_ps(pFrom + i);
+		_mm_storeu_ps(pOut + i, _mm_add_ps(From, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pTo + i), From), Amount)));
+	}
+#elif defined(CONF_SIMD_NEON)
+	const float32x4_t Amount = vdupq_n_f32(amount);
+	for (; i + 4 <= numFloats; i += 4)
+	{
+		float32x4_t From = vld1q_f32(pFrom + i);
+		vst1q_f32(pOut + i, vmlaq_f32(From, vsubq_f32(vld1q_f32(pTo + i), From), Amount));
+	}
+#endif
+	for (; i < numFloats; i++)
+		pOut[i] = pFrom[i] + (pTo[i] - pFrom[i]) * amount;
+}
+
 void CMarioCore::Init(CWorldCore *pWorld, CCollision *pCollision, vec2 spawnpos, float scale, std::map<int, std::vector<vec2>> *pTeleOuts)
 {
 	m_pWorld = pWorld;
@@ -26,6 +91,7 @@ void CMarioCore::Init(CWorldCore *pWorld, CCollision *pCollision, vec2 spawnpos,
 	m_SpawnPos = spawnpos;
 	memset(m_currSurfaces, UINT_MAX, sizeof(m_currSurfaces));
 	memset(&input, 0, sizeof(SM64MarioInputs));
+	initFaceSurfaces();
 
 	Reset();
 }
@@ -39,6 +105,8 @@ void CMarioCore::Destroy()
 {
 	if (Spawned())
 	{
+		if (m_UseMapSurfaces && m_pCollision)
+			ms_NumMapSurfacesMarios--;
 		deleteBlocks();
 
 		free(geometry.position);
@@ -68,53 +136,98 @@ void CMarioCore::Reset()
 	int spawnX = m_SpawnPos.x/m_Scale;
 	int spawnY = -m_SpawnPos.y/m_Scale;
 
-	//exportMap(spawnX, spawnY);
-
-	loadNewBlocks(m_SpawnPos.x/32, m_SpawnPos.y/32);
+	// libsm64 has one set of static surfaces. the map mesh is rebuilt for this Mario's scale only while no other Mario
+	// stands on it, Marios of another map or scale stream blocks around them instead
+	if (ms_pMapSurfacesCollision == m_pCollision && ms_MapSurfacesScale != m_Scale && ms_NumMapSurfacesMarios == 0)
+		LoadMapSurfaces(m_pCollision, m_Scale);
+	m_UseMapSurfaces = MapSurfacesMatch();
+	if (!m_UseMapSurfaces)
+		loadNewBlocks(m_SpawnPos.x/32, m_SpawnPos.y/32);
 	marioId = sm64_mario_create(spawnX, spawnY, 0, 0,0,0,0);
 
 	if (Spawned())
 	{
-		geometry.position = (float*)malloc( sizeof(float) * 9 * SM64_GEO_MAX_TRIANGLES );
-		geometry.normal   = (float*)malloc( sizeof(float) * 9 * SM64_GEO_MAX_TRIANGLES );
-		geometry.color    = (float*)malloc( sizeof(float) * 9 * SM64_GEO_MAX_TRIANGLES );
-		geometry.uv       = (float*)malloc( sizeof(float) * 6 * SM64_GEO_MAX_TRIANGLES );
-		geometry.numTrianglesUsed = 0;
+		allocGeometry();
+		if (m_UseMapSurfaces)
+			ms_NumMapSurfacesMarios++;
 	}
 }
 
+void CMarioCore::InitPuppet()
+{
+	m_pWorld = nullptr;
+	m_pCollision = nullptr;
+	m_pTeleOuts = nullptr;
+
+	m_Tick = 0;
+	m_Scale = 1;
+	m_UseMapSurfaces = true; // never streams blocks
+	memset(m_currSurfaces, UINT_MAX, sizeof(m_currSurfaces));
+	memset(&input, 0, sizeof(SM64MarioInputs));
+	memset(&state, 0, sizeof(SM64MarioState));
+
+	// a fake Mario doesn't need a floor to spawn on
+	marioId = sm64_mario_create(0, 0, 0, 0,0,0,1);
+	if (Spawned())
+		allocGeometry();
+}
+
+void CMarioCore::allocGeometry()
+{
+	geometry.position = (float*)malloc( sizeof(float) * 9 * SM64_GEO_MAX_TRIANGLES );
+	geometry.normal   = (float*)malloc( sizeof(float) * 9 * SM64_GEO_MAX_TRIANGLES );
+	geometry.color    = (float*)malloc( sizeof(float) * 9 * SM64_GEO_MAX_TRIANGLES );
+	geometry.uv       = (float*)malloc( sizeof(float) * 6 * SM64_GEO_MAX_TRIANGLES );
+	geometry.numTrianglesUsed = 0;
+	m_NumLastTriangles = 0;
+	m_RawPose.numPartsUsed = m_LastPose.numPartsUsed = m_CurrPose.numPartsUsed = pose.numPartsUsed = 0;
+
+	memset(&m_AnimInfo, 0, sizeof(m_AnimInfo));
+	memset(m_aAnimRot, 0, sizeof(m_aAnimRot));
+}
+
 void CMarioCore::Tick(float tickspeed)
 {
 	if (!Spawned())
 		return;
 
+	// the map mesh was rebuilt for another map
+	if (m_UseMapSurfaces && !MapSurfacesMatch())
+	{
+		m_UseMapSurfaces = false;
+		ms_NumMapSurfacesMarios--;
+		loadNewBlocks(m_Pos.x/32, m_Pos.y/32);
+	}
+
 	m_Tick += tickspeed;
 	while (m_Tick >= 1.f/30)
 	{
 		m_Tick -= 1.f/30;
 
-		m_LastPos = m_CurrPos;
-		mem_copy(m_LastGeometryPos, m_CurrGeometryPos, sizeof(m_CurrGeometryPos));
+		keepLastGeometry();
 
 		sm64_reset_mario_z(marioId);
 		if (state.health != MARIO_DEAD_HEALTH && g_Config.m_MarioInvincible) sm64_mario_set_health(marioId, MARIO_FULL_HEALTH);
 		if (state.action & ACT_FLAG_SWIMMING_OR_FLYING) input.stickX *= -1;
-		sm64_mario_tick(marioId, &input, &state, &geometry);
+		if (m_GenerateGeometry && m_GeneratePose)
+		{
+			sm64_mario_tick_pose(marioId, &input, &state, &m_RawPose);
+			geometry.numTrianglesUsed = 0;
+		}
+		else
+		{
+			sm64_mario_tick(marioId, &input, &state, m_GenerateGeometry ? &geometry : nullptr);
+			if (!m_GenerateGeometry) geometry.numTrianglesUsed = 0;
+			m_RawPose.numPartsUsed = 0;
+		}
+		m_AnimInfo = *sm64_mario_get_anim_info(marioId, m_aAnimRot);
 
 		vec2 newPos(state.position[0]*m_Scale, -state.position[1]*m_Scale);
-		if ((int)(newPos.x/32) != (int)(m_Pos.x/32) || (int)(newPos.y/32) != (int)(m_Pos.y/32))
+		if (!m_UseMapSurfaces && ((int)(newPos.x/32) != (int)(m_Pos.x/32) || (int)(newPos.y/32) != (int)(m_Pos.y/32)))
 			loadNewBlocks(newPos.x/32, newPos.y/32);
 
 		newPos.y += 16;
-		m_CurrPos = newPos;
-
-		float drawScale = g_Config.m_MarioDrawScale / 100.f;
-		for (int i=0; i<geometry.numTrianglesUsed*3; i++)
-		{
-			m_CurrGeometryPos[i*3+0] = (geometry.position[i*3+0]*m_Scale - newPos.x) * drawScale + newPos.x;
-			m_CurrGeometryPos[i*3+1] = (geometry.position[i*3+1]*-m_Scale + 16 - newPos.y) * drawScale + newPos.y;
-			m_CurrGeometryPos[i*3+2] = (geometry.position[i*3+2]*m_Scale- (state.position[2]*m_Scale)) * drawScale + (state.position[2]*m_Scale);
-		}
+		storeGeometry(newPos);
 
 		// interact with tiles like teleporters
 		for (int y=-round_to_int(m_Scale*10/2.f); y<=0; y++)
@@ -130,10 +243,15 @@ void CMarioCore::Tick(float tickspeed)
 					int z = z1 ? z1 : z2;
 					if (m_pTeleOuts && !(*m_pTeleOuts)[z - 1].empty())
 					{
-						int TeleOut = m_pWorld->RandomOr0((*m_pTeleOuts)[z - 1].size());
+						int TeleOut;
+						{
+							// Marios may be ticking in parallel and share the world's random generator
+							std::lock_guard<std::mutex> lock(s_TeleRandomMutex);
+							TeleOut = m_pWorld->RandomOr0((*m_pTeleOuts)[z - 1].size());
+						}
 
 						vec2 outPos = (*m_pTeleOuts)[z - 1][TeleOut];
-						loadNewBlocks(outPos.x/32, outPos.y/32);
+						if (!m_UseMapSurfaces) loadNewBlocks(outPos.x/32, outPos.y/32);
 						sm64_set_mario_position(marioId, outPos.x / m_Scale, -outPos.y / m_Scale, 0);
 						if (z2) sm64_set_mario_velocity(marioId, 0, 0, 0); // evil teleport
 					}
@@ -142,287 +260,545 @@ void CMarioCore::Tick(float tickspeed)
 		}
 	}
 
-	m_Pos = mix(m_LastPos, m_CurrPos, m_Tick / (1.f/30));
-	for (int i=0; i<geometry.numTrianglesUsed*9; i++)
-		geometry.position[i] = mix(m_LastGeometryPos[i], m_CurrGeometryPos[i], m_Tick / (1.f/30));
+	interpolate(m_Tick / (1.f/30));
 }
 
-void CMarioCore::deleteBlocks()
+void CMarioCore::Write(CNetObj_Mario *pObj) const
 {
-	for (int j=0; j<MAX_SURFACES; j++)
+	pObj->m_X = round_to_int(state.position[0]*m_Scale);
+	pObj->m_Y = round_to_int(-state.position[1]*m_Scale);
+	pObj->m_VelX = round_to_int(state.velocity[0]*m_Scale*256);
+	pObj->m_VelY = round_to_int(-state.velocity[1]*m_Scale*256);
+	pObj->m_Action = state.action;
+	pObj->m_Flags = state.flags;
+	pObj->m_AnimID = m_AnimInfo.animID;
+	pObj->m_AnimFrame = m_AnimInfo.animFrame;
+	pObj->m_AnimAccel = m_AnimInfo.animAccel;
+	pObj->m_AngleX = m_aAnimRot[0];
+	pObj->m_AngleY = m_aAnimRot[1];
+	pObj->m_AngleZ = m_aAnimRot[2];
+	pObj->m_Scale = round_to_int(m_Scale*100);
+	// lets predicting clients step Mario at the same ticks as the server
+	static_assert(sizeof(m_Tick) == sizeof(pObj->m_TickPhase), "m_TickPhase holds the bits of m_Tick");
+	mem_copy(&pObj->m_TickPhase, &m_Tick, sizeof(m_Tick));
+}
+
+void CMarioCore::SaveState(std::vector<uint8_t> &vState) const
+{
+	vState.resize(sizeof(CSavedCore) + sm64_mario_saved_state_size());
+	if (!Spawned())
+		return;
+
+	CSavedCore *pCore = (CSavedCore *)vState.data();
+	pCore->m_Tick = m_Tick;
+	pCore->m_State = state;
+	pCore->m_Pos = m_Pos;
+	pCore->m_LastPos = m_LastPos;
+	pCore->m_CurrPos = m_CurrPos;
+	pCore->m_AnimInfo = m_AnimInfo;
+	mem_copy(pCore->m_aAnimRot, m_aAnimRot, sizeof(m_aAnimRot));
+	sm64_mario_save_state(marioId, vState.data() + sizeof(CSavedCore));
+}
+
+void CMarioCore::RestoreState(const std::vector<uint8_t> &vState)
+{
+	if (!Spawned() || vState.size() != sizeof(CSavedCore) + sm64_mario_saved_state_size())
+		return;
+
+	const CSavedCore *pCore = (const CSavedCore *)vState.data();
+	m_Tick = pCore->m_Tick;
+	state = pCore->m_State;
+	m_Pos = pCore->m_Pos;
+	m_LastPos = pCore->m_LastPos;
+	m_CurrPos = pCore->m_CurrPos;
+	m_AnimInfo = pCore->m_AnimInfo;
+	mem_copy(m_aAnimRot, pCore->m_aAnimRot, sizeof(m_aAnimRot));
+
+	// libsm64 looks up the floor again on restore, the blocks around the old position have to be there
+	if (!m_UseMapSurfaces)
+		loadNewBlocks(state.position[0]*m_Scale/32, -state.position[1]*m_Scale/32);
+	sm64_mario_restore_state(marioId, vState.data() + sizeof(CSavedCore));
+}
+
+// corrects a predicted Mario with the server's Mario of the same tick. returns whether the prediction was off
+bool CMarioCore::Reconcile(const CNetObj_Mario *pObj)
+{
+	if (!Spawned())
+		return false;
+
+	mem_copy(&m_Tick, &pObj->m_TickPhase, sizeof(m_Tick));
+
+	CNetObj_Mario Predicted;
+	Write(&Predicted);
+	if (absolute(Predicted.m_X - pObj->m_X) <= 1 && absolute(Predicted.m_Y - pObj->m_Y) <= 1 &&
+		absolute(Predicted.m_VelX - pObj->m_VelX) <= 64 && absolute(Predicted.m_VelY - pObj->m_VelY) <= 64 &&
+		Predicted.m_Action == pObj->m_Action && Predicted.m_Flags == pObj->m_Flags)
+		return false;
+
+	// the action goes first, entering one may set Mario's velocity
+	if (Predicted.m_Action != pObj->m_Action)
+		sm64_set_mario_action(marioId, pObj->m_Action);
+	sm64_set_mario_state(marioId, pObj->m_Flags);
+
+	vec2 pos(pObj->m_X, pObj->m_Y);
+	if (!m_UseMapSurfaces)
+		loadNewBlocks(pos.x/32, pos.y/32);
+
+	state.position[0] = pos.x/m_Scale;
+	state.position[1] = -pos.y/m_Scale;
+	state.position[2] = 0;
+	state.velocity[0] = pObj->m_VelX/256.f/m_Scale;
+	state.velocity[1] = -pObj->m_VelY/256.f/m_Scale;
+	state.velocity[2] = 0;
+	state.faceAngle = pObj->m_AngleY / 32768.0f * pi;
+	state.action = pObj->m_Action;
+	state.flags = pObj->m_Flags;
+
+	sm64_set_mario_position(marioId, state.position[0], state.position[1], state.position[2]);
+	sm64_set_mario_velocity(marioId, state.velocity[0], state.velocity[1], state.velocity[2]);
+	sm64_set_mario_faceangle(marioId, state.faceAngle);
+	// on the ground Mario moves by his forward velocity, along his face angle
+	if (absolute(sinf(state.faceAngle)) > 0.1f)
+		sm64_set_mario_forward_velocity(marioId, state.velocity[0] / sinf(state.faceAngle));
+
+	m_CurrPos = vec2(pos.x, pos.y + 16);
+	return true;
+}
+
+// like the interpolation in Tick, with the time since the last predicted tick added
+void CMarioCore::InterpolatePredicted(float intra)
+{
+	if (Spawned())
+		interpolate(minimum(1.f, (m_Tick + intra/SERVER_TICK_SPEED) / (1.f/30)));
+}
+
+// called once per received snapshot, InterpolatePuppet blends between the last two poses
+void CMarioCore::PosePuppet(const CNetObj_Mario *pObj, bool firstPose)
+{
+	if (!Spawned())
+		return;
+
+	m_Scale = pObj->m_Scale/100.f;
+	state.position[0] = pObj->m_X/m_Scale;
+	state.position[1] = -pObj->m_Y/m_Scale;
+	state.position[2] = 0;
+	state.velocity[0] = pObj->m_VelX/256.f/m_Scale;
+	state.velocity[1] = -pObj->m_VelY/256.f/m_Scale;
+	state.velocity[2] = 0;
+	state.faceAngle = pObj->m_AngleY / 32768.0f * pi;
+	state.action = pObj->m_Action;
+	state.flags = pObj->m_Flags;
+
+	SM64AnimInfo animInfo;
+	memset(&animInfo, 0, sizeof(animInfo));
+	animInfo.animID = pObj->m_AnimID;
+	animInfo.animFrame = pObj->m_AnimFrame;
+	animInfo.animFrameAccelAssist = pObj->m_AnimFrame << 16;
+	animInfo.animAccel = pObj->m_AnimAccel;
+	int16_t rot[3] = {(int16_t)pObj->m_AngleX, (int16_t)pObj->m_AngleY, (int16_t)pObj->m_AngleZ};
+
+	sm64_set_mario_position(marioId, state.position[0], state.position[1], state.position[2]);
+	if (m_GeneratePose)
 	{
-		if (m_currSurfaces[j] == UINT_MAX) continue;
-		sm64_surface_object_delete(m_currSurfaces[j]);
-		m_currSurfaces[j] = UINT_MAX;
+		sm64_mario_anim_tick_pose(marioId, state.flags, &animInfo, &m_RawPose, rot);
+		geometry.numTrianglesUsed = 0;
+	}
+	else
+	{
+		sm64_mario_anim_tick(marioId, state.flags, &animInfo, &geometry, rot);
+		m_RawPose.numPartsUsed = 0;
 	}
+
+	keepLastGeometry();
+	storeGeometry(vec2(pObj->m_X, pObj->m_Y + 16));
+	if (firstPose)
+		keepLastGeometry();
 }
 
-bool CMarioCore::addBlock(int x, int y, int *i)
+void CMarioCore::InterpolatePuppet(float intra)
 {
-	if ((*i) >= MAX_SURFACES) return false;
-	bool block = Collision()->CheckPoint(x*32, y*32);
-	if (!block) return false;
-	int indexUp = Collision()->GetPureMapIndex(x*32, y*32-32);
-	bool snow = Collision()->GetTileIndex(indexUp) == TILE_FREEZE || Collision()->GetFTileIndex(indexUp) == TILE_FREEZE;
-
-	struct SM64SurfaceObject obj;
-	memset(&obj.transform, 0, sizeof(struct SM64ObjectTransform));
-	obj.transform.position[0] = x*32 / m_Scale;
-	obj.transform.position[1] = (-y*32-16) / m_Scale;
-	obj.transform.position[2] = 0;
-	obj.surfaceCount = 0;
-	obj.surfaces = (struct SM64Surface*)malloc(sizeof(struct SM64Surface) * 4*2);
+	if (Spawned())
+		interpolate(intra);
+}
 
-	bool up =		Collision()->CheckPoint(x*32, y*32-32);
-	bool down =		Collision()->CheckPoint(x*32, y*32+32);
-	bool left =		Collision()->CheckPoint(x*32-32, y*32);
-	bool right =	Collision()->CheckPoint(x*32+32, y*32);
+// the current tick's geometry becomes the last one, before a new tick stores its own
+void CMarioCore::keepLastGeometry()
+{
+	m_LastPos = m_CurrPos;
+	m_NumLastTriangles = geometry.numTrianglesUsed;
+	mem_copy(m_LastGeometryPos, m_CurrGeometryPos, sizeof(float) * 9 * m_NumLastTriangles);
+	m_LastPose.numPartsUsed = m_CurrPose.numPartsUsed;
+	mem_copy(m_LastPose.parts, m_CurrPose.parts, sizeof(SM64MarioPart) * m_CurrPose.numPartsUsed);
+}
 
-	// block ground face
-	if (!up)
+// converts the mesh libsm64 generated to world coordinates around Mario's new position
+void CMarioCore::storeGeometry(vec2 newPos)
+{
+	m_CurrPos = newPos;
+
+	// scaled by m_Scale with Y flipped, then by drawScale around Mario's position:
+	// x = (px*m_Scale - newPos.x) * drawScale + newPos.x, likewise for y (+16) and z
+	float drawScale = g_Config.m_MarioDrawScale / 100.f;
+	const float aScale[3] = {m_Scale*drawScale, -m_Scale*drawScale, m_Scale*drawScale};
+	const float aOffset[3] = {
+		newPos.x * (1-drawScale),
+		16*drawScale + newPos.y * (1-drawScale),
+		state.position[2]*m_Scale * (1-drawScale)};
+	transformPositions(m_CurrGeometryPos, geometry.position, geometry.numTrianglesUsed*9, aScale, aOffset);
+
+	// triangles that weren't there last tick aren't blended
+	if (geometry.numTrianglesUsed > m_NumLastTriangles)
+		mem_copy(m_LastGeometryPos + m_NumLastTriangles*9, m_CurrGeometryPos + m_NumLastTriangles*9, sizeof(float) * 9 * (geometry.numTrianglesUsed - m_NumLastTriangles));
+
+	// the same conversion applied to the part transforms
+	m_CurrPose.numPartsUsed = m_RawPose.numPartsUsed;
+	for (int p=0; p<m_RawPose.numPartsUsed; p++)
 	{
-		obj.surfaces[obj.surfaceCount+0].vertices[0][0] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[0][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[0][2] = 64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[1][0] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[1][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[1][2] = -64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[2][0] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[2][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[2][2] = 64 / m_Scale;
+		const SM64MarioPart &raw = m_RawPose.parts[p];
+		SM64MarioPart &part = m_CurrPose.parts[p];
+		part.firstTriangle = raw.firstTriangle;
+		part.numTriangles = raw.numTriangles;
+		for (int c=0; c<4; c++)
+		{
+			for (int r=0; r<3; r++)
+				part.transform[c][r] = raw.transform[c][r] * aScale[r] + (c == 3 ? aOffset[r] : 0);
+			part.transform[c][3] = raw.transform[c][3];
+		}
+	}
+}
 
-		obj.surfaces[obj.surfaceCount+1].vertices[0][0] = 0 / m_Scale; 		obj.surfaces[obj.surfaceCount+1].vertices[0][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[0][2] = -64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[1][0] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[1][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[1][2] = 64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[2][0] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[2][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[2][2] = -64 / m_Scale;
+void CMarioCore::interpolate(float amount)
+{
+	m_Pos = mix(m_LastPos, m_CurrPos, amount);
+	mixPositions(geometry.position, m_LastGeometryPos, m_CurrGeometryPos, geometry.numTrianglesUsed*9, amount);
 
-		obj.surfaceCount += 2;
+	// lerping the transforms moves the vertices like lerping them does. parts that just appeared aren't blended
+	pose.numPartsUsed = m_CurrPose.numPartsUsed;
+	for (int p=0; p<m_CurrPose.numPartsUsed; p++)
+	{
+		const SM64MarioPart &curr = m_CurrPose.parts[p];
+		const SM64MarioPart *pLast = nullptr;
+		if (p < m_LastPose.numPartsUsed && m_LastPose.parts[p].firstTriangle == curr.firstTriangle)
+			pLast = &m_LastPose.parts[p];
+		for (int i=0; !pLast && i<m_LastPose.numPartsUsed; i++)
+		{
+			if (m_LastPose.parts[i].firstTriangle == curr.firstTriangle)
+				pLast = &m_LastPose.parts[i];
+		}
+
+		SM64MarioPart &part = pose.parts[p];
+		part.firstTriangle = curr.firstTriangle;
+		part.numTriangles = curr.numTriangles;
+		if (!pLast)
+			pLast = &curr;
+		for (int c=0; c<4; c++)
+			for (int r=0; r<4; r++)
+				part.transform[c][r] = mix(pLast->transform[c][r], curr.transform[c][r], amount);
 	}
+}
 
-	// left (Z+)
-	if (!left)
+void CMarioCore::initFaceSurfaces()
+{
+	// one quad (two triangles) per block face, relative to the block's bottom left corner
+	const int aaaFaces[NUM_FACES][2][3][3] = {
+		// block ground face
+		{{{32, 32, 64}, {0, 32, -64}, {0, 32, 64}},
+			{{0, 32, -64}, {32, 32, 64}, {32, 32, -64}}},
+		// left (Z+)
+		{{{0, 0, -64}, {0, 32, 64}, {0, 32, -64}},
+			{{0, 32, 64}, {0, 0, -64}, {0, 0, 64}}},
+		// right (Z-)
+		{{{32, 0, 64}, {32, 32, -64}, {32, 32, 64}},
+			{{32, 32, -64}, {32, 0, 64}, {32, 0, -64}}},
+		// block bottom face
+		{{{0, 0, 64}, {0, 0, -64}, {32, 0, 64}},
+			{{32, 0, -64}, {32, 0, 64}, {0, 0, -64}}},
+	};
+
+	for (int f = 0; f < NUM_FACES; f++)
 	{
-		obj.surfaces[obj.surfaceCount+0].vertices[0][2] = -64 / m_Scale;	obj.surfaces[obj.surfaceCount+0].vertices[0][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[0][0] = 0 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[1][2] = 64 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[1][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[1][0] = 0 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[2][2] = -64 / m_Scale;	obj.surfaces[obj.surfaceCount+0].vertices[2][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[2][0] = 0 / m_Scale;
+		for (int t = 0; t < 2; t++)
+		{
+			SM64Surface *pSurface = &m_aFaceSurfaces[f][t];
+			pSurface->type = SURFACE_DEFAULT;
+			pSurface->force = 0;
+			pSurface->terrain = TERRAIN_STONE;
+			for (int v = 0; v < 3; v++)
+				for (int c = 0; c < 3; c++)
+					pSurface->vertices[v][c] = aaaFaces[f][t][v][c] / m_Scale;
+		}
+	}
+}
+
+// returns the exposed faces of the block at the given tile, or BLOCK_EMPTY if there is no block
+int CMarioCore::blockFaces(int x, int y)
+{
+	if (!Collision()->CheckPoint(x*32, y*32))
+		return BLOCK_EMPTY;
 
-		obj.surfaces[obj.surfaceCount+1].vertices[0][2] = 64 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[0][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[0][0] = 0 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[1][2] = -64 / m_Scale;	obj.surfaces[obj.surfaceCount+1].vertices[1][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[1][0] = 0 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[2][2] = 64 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[2][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[2][0] = 0 / m_Scale;
+	int faces = 0;
+	if (!Collision()->CheckPoint(x*32, y*32-32)) faces |= FACE_UP;
+	if (!Collision()->CheckPoint(x*32-32, y*32)) faces |= FACE_LEFT;
+	if (!Collision()->CheckPoint(x*32+32, y*32)) faces |= FACE_RIGHT;
+	if (!Collision()->CheckPoint(x*32, y*32+32)) faces |= FACE_DOWN;
 
-		obj.surfaceCount += 2;
+	int indexUp = Collision()->GetPureMapIndex(x*32, y*32-32);
+	if (Collision()->GetTileIndex(indexUp) == TILE_FREEZE || Collision()->GetFTileIndex(indexUp) == TILE_FREEZE)
+		faces |= BLOCK_SNOW;
+
+	return faces;
+}
+
+void CMarioCore::deleteBlocks()
+{
+	for (int j=0; j<MAX_SURFACES; j++)
+	{
+		if (m_currSurfaces[j] == UINT_MAX) continue;
+		releaseBlock(m_currBlocks[j]);
+		m_currSurfaces[j] = UINT_MAX;
 	}
+}
 
-	// right (Z-)
-	if (!right)
+// returns the shared surface object of the block at the given tile, creating it if no other Mario has it loaded.
+// returns UINT_MAX if the block has no exposed faces
+uint32_t CMarioCore::acquireBlock(ivec2 block)
+{
+	SharedBlockKey key(m_pCollision, m_Scale, block.x, block.y);
+	auto it = ms_SharedBlocks.find(key);
+	if (it != ms_SharedBlocks.end())
 	{
-		obj.surfaces[obj.surfaceCount+0].vertices[0][2] = 64 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[0][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[0][0] = 32 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[1][2] = -64 / m_Scale;	obj.surfaces[obj.surfaceCount+0].vertices[1][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[1][0] = 32 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[2][2] = 64 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[2][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[2][0] = 32 / m_Scale;
+		it->second.m_Refs++;
+		return it->second.m_SurfaceObject;
+	}
 
-		obj.surfaces[obj.surfaceCount+1].vertices[0][2] = -64 / m_Scale;	obj.surfaces[obj.surfaceCount+1].vertices[0][1] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[0][0] = 32 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[1][2] = 64 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[1][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[1][0] = 32 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[2][2] = -64 / m_Scale;	obj.surfaces[obj.surfaceCount+1].vertices[2][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[2][0] = 32 / m_Scale;
+	int faces = blockFaces(block.x, block.y);
+	if (faces == BLOCK_EMPTY || !(faces & (FACE_UP|FACE_LEFT|FACE_RIGHT|FACE_DOWN))) return UINT_MAX;
 
-		obj.surfaceCount += 2;
+	struct SM64Surface aSurfaces[NUM_FACES*2];
+	struct SM64SurfaceObject obj;
+	memset(&obj.transform, 0, sizeof(struct SM64ObjectTransform));
+	obj.transform.position[0] = block.x*32 / m_Scale;
+	obj.transform.position[1] = (-block.y*32-16) / m_Scale;
+	obj.transform.position[2] = 0;
+	obj.surfaceCount = 0;
+	obj.surfaces = aSurfaces;
+
+	for (int f=0; f<NUM_FACES; f++)
+	{
+		if (!(faces & (1 << f))) continue;
+		aSurfaces[obj.surfaceCount++] = m_aFaceSurfaces[f][0];
+		aSurfaces[obj.surfaceCount++] = m_aFaceSurfaces[f][1];
 	}
 
-	// block bottom face
-	if (!down)
+	if (faces & BLOCK_SNOW)
 	{
-		obj.surfaces[obj.surfaceCount+0].vertices[0][0] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[0][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[0][2] = 64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[1][0] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[1][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[1][2] = -64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+0].vertices[2][0] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[2][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+0].vertices[2][2] = 64 / m_Scale;
+		for (uint32_t ind=0; ind<obj.surfaceCount; ind++)
+			aSurfaces[ind].terrain = TERRAIN_SNOW;
+	}
 
-		obj.surfaces[obj.surfaceCount+1].vertices[0][0] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[0][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[0][2] = -64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[1][0] = 32 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[1][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[1][2] = 64 / m_Scale;
-		obj.surfaces[obj.surfaceCount+1].vertices[2][0] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[2][1] = 0 / m_Scale;		obj.surfaces[obj.surfaceCount+1].vertices[2][2] = -64 / m_Scale;
+	CSharedBlock &shared = ms_SharedBlocks[key];
+	shared.m_SurfaceObject = sm64_surface_object_create(&obj);
+	shared.m_Refs = 1;
+	return shared.m_SurfaceObject;
+}
 
-		obj.surfaceCount += 2;
-	}
+// drops a reference to the shared block. the last Mario referencing it deletes the surface object
+void CMarioCore::releaseBlock(ivec2 block)
+{
+	auto it = ms_SharedBlocks.find(SharedBlockKey(m_pCollision, m_Scale, block.x, block.y));
+	if (it == ms_SharedBlocks.end()) return;
 
-	for (uint32_t ind=0; ind<obj.surfaceCount; ind++)
+	if (--it->second.m_Refs <= 0)
 	{
-		obj.surfaces[ind].type = SURFACE_DEFAULT;
-		obj.surfaces[ind].force = 0;
-		obj.surfaces[ind].terrain = snow ? TERRAIN_SNOW : TERRAIN_STONE;
+		sm64_surface_object_delete(it->second.m_SurfaceObject);
+		ms_SharedBlocks.erase(it);
 	}
+}
 
-	if (obj.surfaceCount)
-		m_currSurfaces[(*i)++] = sm64_surface_object_create(&obj);
+// collects the block at the given tile into the wanted window. returns whether there is a block
+bool CMarioCore::addBlock(int x, int y, ivec2 *pBlocks, int *pNumBlocks)
+{
+	if ((*pNumBlocks) >= MAX_SURFACES) return false;
+	if (!Collision()->CheckPoint(x*32, y*32)) return false;
 
-	free(obj.surfaces);
+	ivec2 block(x, y);
+	for (int i=0; i<*pNumBlocks; i++)
+	{
+		if (pBlocks[i] == block)
+			return true;
+	}
+
+	pBlocks[(*pNumBlocks)++] = block;
 	return true;
 }
 
 void CMarioCore::loadNewBlocks(int x, int y)
 {
-	deleteBlocks();
+	ivec2 aWanted[MAX_SURFACES];
+	int numWanted = 0;
 	int yadd = 0;
 
-	int arrayInd = 0;
 	for (int xadd=-7; xadd<=7; xadd++)
 	{
 		// get block at floor
 		for (yadd=0; y+yadd<=Collision()->GetHeight(); yadd++)
 		{
-			if (addBlock(x+xadd, y+yadd, &arrayInd)) break;
+			if (addBlock(x+xadd, y+yadd, aWanted, &numWanted)) break;
 		}
 
 		for (yadd=6; yadd>=0; yadd--)
 		{
-			addBlock(x+xadd, y-yadd, &arrayInd);
+			addBlock(x+xadd, y-yadd, aWanted, &numWanted);
 		}
 	}
-}
 
-void CMarioCore::exportMap(int spawnX, int spawnY)
-{
-	FILE *f = fopen("level.c", "w");
+	// evict the blocks that scrolled out of the window, and skip the ones that are still loaded
+	bool aLoaded[MAX_SURFACES] = {false};
+	for (int j=0; j<MAX_SURFACES; j++)
+	{
+		if (m_currSurfaces[j] == UINT_MAX) continue;
 
-	fprintf(f, "#include \"level.h\"\n#include \"../src/decomp/include/surface_terrains.h\"\nconst struct SM64Surface surfaces[] = {\n");
+		bool keep = false;
+		for (int i=0; i<numWanted; i++)
+		{
+			if (!aLoaded[i] && aWanted[i] == m_currBlocks[j])
+			{
+				aLoaded[i] = keep = true;
+				break;
+			}
+		}
 
-	for (int y=0; y<Collision()->GetHeight(); y++)
-	{
-		for (int x=0; x<Collision()->GetWidth(); x++)
+		if (!keep)
 		{
-			bool block = Collision()->CheckPoint(x*32, y*32);
-			if (!block) continue;
+			releaseBlock(m_currBlocks[j]);
+			m_currSurfaces[j] = UINT_MAX;
+		}
+	}
 
-			vec3 pos(x*32 / m_Scale, (-y*32-16) / m_Scale, 0);
+	// load the newly exposed blocks into free slots
+	int slot = 0;
+	for (int i=0; i<numWanted; i++)
+	{
+		if (aLoaded[i]) continue;
 
-			bool up =		Collision()->CheckPoint(x*32, y*32-32);
-			bool down =		Collision()->CheckPoint(x*32, y*32+32);
-			bool left =		Collision()->CheckPoint(x*32-32, y*32);
-			bool right =	Collision()->CheckPoint(x*32+32, y*32);
+		while (slot < MAX_SURFACES && m_currSurfaces[slot] != UINT_MAX) slot++;
+		if (slot >= MAX_SURFACES) break;
 
-			int vertices1[3][3], vertices2[3][3];
+		uint32_t surfaceObject = acquireBlock(aWanted[i]);
+		if (surfaceObject == UINT_MAX) continue;
 
-			// block ground face
-			if (!up)
-			{
-				vertices1[0][0] = pos.x + (32 / m_Scale);	vertices1[0][1] = pos.y + (32 / m_Scale);	vertices1[0][2] = pos.z + (64 / m_Scale);
-				vertices1[1][0] = pos.x + (0 / m_Scale);	vertices1[1][1] = pos.y + (32 / m_Scale);	vertices1[1][2] = pos.z + (-64 / m_Scale);
-				vertices1[2][0] = pos.x + (0 / m_Scale);	vertices1[2][1] = pos.y + (32 / m_Scale);	vertices1[2][2] = pos.z + (64 / m_Scale);
-
-				vertices2[0][0] = pos.x + (0 / m_Scale); 	vertices2[0][1] = pos.y + (32 / m_Scale);	vertices2[0][2] = pos.z + (-64 / m_Scale);
-				vertices2[1][0] = pos.x + (32 / m_Scale);	vertices2[1][1] = pos.y + (32 / m_Scale);	vertices2[1][2] = pos.z + (64 / m_Scale);
-				vertices2[2][0] = pos.x + (32 / m_Scale);	vertices2[2][1] = pos.y + (32 / m_Scale);	vertices2[2][2] = pos.z + (-64 / m_Scale);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices1[0][0], vertices1[0][1], vertices1[0][2],
-					vertices1[1][0], vertices1[1][1], vertices1[1][2],
-					vertices1[2][0], vertices1[2][1], vertices1[2][2]);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices2[0][0], vertices2[0][1], vertices2[0][2],
-					vertices2[1][0], vertices2[1][1], vertices2[1][2],
-					vertices2[2][0], vertices2[2][1], vertices2[2][2]);
-			}
+		m_currSurfaces[slot] = surfaceObject;
+		m_currBlocks[slot] = aWanted[i];
+	}
+}
 
-			// left (X-)
-			if (!left)
+void CMarioCore::LoadMapSurfaces(CCollision *pCollision, float scale)
+{
+	const int width = pCollision->GetWidth();
+	const int height = pCollision->GetHeight();
+	const int depth = 64 / scale;
+
+	std::vector<bool> vSolid(width * height);
+	for (int y=0; y<height; y++)
+		for (int x=0; x<width; x++)
+			vSolid[y*width + x] = pCollision->CheckPoint(x*32, y*32);
+
+	// tiles outside of the map repeat the border tiles, like CCollision::CheckPoint does
+	auto isSolid = [&](int x, int y) { return vSolid[clamp(y, 0, height-1)*width + clamp(x, 0, width-1)]; };
+	auto blockTerrain = [&](int x, int y) {
+		int indexUp = pCollision->GetPureMapIndex(x*32, y*32-32);
+		bool snow = pCollision->GetTileIndex(indexUp) == TILE_FREEZE || pCollision->GetFTileIndex(indexUp) == TILE_FREEZE;
+		return snow ? TERRAIN_SNOW : TERRAIN_STONE;
+	};
+
+	// tile edges in SM64 units. a block in row y spans from edgeY(y+1) to edgeY(y), same as addBlock
+	auto edgeX = [&](int x) { return (int)(x*32 / scale); };
+	auto edgeY = [&](int y) { return (int)((-y*32+16) / scale); };
+
+	std::vector<SM64Surface> vSurfaces;
+	auto addTriangle = [&](int terrain, const int (&aVertices)[3][3]) {
+		SM64Surface surface;
+		surface.type = SURFACE_DEFAULT;
+		surface.force = 0;
+		surface.terrain = terrain;
+		memcpy(surface.vertices, aVertices, sizeof(surface.vertices));
+		vSurfaces.push_back(surface);
+	};
+
+	// greedy meshing: runs of exposed faces with the same terrain are merged into one quad.
+	// floors and ceilings are merged along rows, walls along columns
+	for (int y=0; y<height; y++)
+	{
+		for (int side=0; side<2; side++)
+		{
+			int neighbourY = side == 0 ? y-1 : y+1;
+			for (int x=0; x<width;)
 			{
-				vertices1[0][2] = pos.z + (-64 / m_Scale);	vertices1[0][1] = pos.y + (0 / m_Scale);	vertices1[0][0] = pos.x + (0 / m_Scale);
-				vertices1[1][2] = pos.z + (64 / m_Scale);	vertices1[1][1] = pos.y + (32 / m_Scale);	vertices1[1][0] = pos.x + (0 / m_Scale);
-				vertices1[2][2] = pos.z + (-64 / m_Scale);	vertices1[2][1] = pos.y + (32 / m_Scale);	vertices1[2][0] = pos.x + (0 / m_Scale);
-
-				vertices2[0][2] = pos.z + (64 / m_Scale);	vertices2[0][1] = pos.y + (32 / m_Scale);	vertices2[0][0] = pos.x + (0 / m_Scale);
-				vertices2[1][2] = pos.z + (-64 / m_Scale);	vertices2[1][1] = pos.y + (0 / m_Scale);	vertices2[1][0] = pos.x + (0 / m_Scale);
-				vertices2[2][2] = pos.z + (64 / m_Scale);	vertices2[2][1] = pos.y + (0 / m_Scale);	vertices2[2][0] = pos.x + (0 / m_Scale);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices1[0][0], vertices1[0][1], vertices1[0][2],
-					vertices1[1][0], vertices1[1][1], vertices1[1][2],
-					vertices1[2][0], vertices1[2][1], vertices1[2][2]);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices2[0][0], vertices2[0][1], vertices2[0][2],
-					vertices2[1][0], vertices2[1][1], vertices2[1][2],
-					vertices2[2][0], vertices2[2][1], vertices2[2][2]);
-			}
+				if (!isSolid(x, y) || isSolid(x, neighbourY)) { x++; continue; }
 
-			// right (X+)
-			if (!right)
-			{
-				vertices1[0][2] = pos.z + (64 / m_Scale);	vertices1[0][1] = pos.y + (0 / m_Scale);	vertices1[0][0] = pos.x + (32 / m_Scale);
-				vertices1[1][2] = pos.z + (-64 / m_Scale);	vertices1[1][1] = pos.y + (32 / m_Scale);	vertices1[1][0] = pos.x + (32 / m_Scale);
-				vertices1[2][2] = pos.z + (64 / m_Scale);	vertices1[2][1] = pos.y + (32 / m_Scale);	vertices1[2][0] = pos.x + (32 / m_Scale);
-
-				vertices2[0][2] = pos.z + (-64 / m_Scale);	vertices2[0][1] = pos.y + (32 / m_Scale);	vertices2[0][0] = pos.x + (32 / m_Scale);
-				vertices2[1][2] = pos.z + (64 / m_Scale);	vertices2[1][1] = pos.y + (0 / m_Scale);	vertices2[1][0] = pos.x + (32 / m_Scale);
-				vertices2[2][2] = pos.z + (-64 / m_Scale);	vertices2[2][1] = pos.y + (0 / m_Scale);	vertices2[2][0] = pos.x + (32 / m_Scale);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices1[0][0], vertices1[0][1], vertices1[0][2],
-					vertices1[1][0], vertices1[1][1], vertices1[1][2],
-					vertices1[2][0], vertices1[2][1], vertices1[2][2]);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices2[0][0], vertices2[0][1], vertices2[0][2],
-					vertices2[1][0], vertices2[1][1], vertices2[1][2],
-					vertices2[2][0], vertices2[2][1], vertices2[2][2]);
-			}
+				int terrain = blockTerrain(x, y);
+				int end = x+1;
+				while (end < width && isSolid(end, y) && !isSolid(end, neighbourY) && blockTerrain(end, y) == terrain)
+					end++;
 
-			// front
-			{
-				vertices1[0][0] = pos.x + (32 / m_Scale);	vertices1[0][1] = pos.y + (0 / m_Scale);	vertices1[0][2] = pos.z + (-64 / m_Scale);
-				vertices1[1][0] = pos.x + (0 / m_Scale);	vertices1[1][1] = pos.y + (32 / m_Scale);	vertices1[1][2] = pos.z + (-64 / m_Scale);
-				vertices1[2][0] = pos.x + (32 / m_Scale);	vertices1[2][1] = pos.y + (32 / m_Scale);	vertices1[2][2] = pos.z + (-64 / m_Scale);
-
-				vertices2[0][0] = pos.x + (0 / m_Scale);	vertices2[0][1] = pos.y + (32 / m_Scale);	vertices2[0][2] = pos.z + (-64 / m_Scale);
-				vertices2[1][0] = pos.x + (32 / m_Scale);	vertices2[1][1] = pos.y + (0 / m_Scale);	vertices2[1][2] = pos.z + (-64 / m_Scale);
-				vertices2[2][0] = pos.x + (0 / m_Scale);	vertices2[2][1] = pos.y + (0 / m_Scale);	vertices2[2][2] = pos.z + (-64 / m_Scale);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices1[0][0], vertices1[0][1], vertices1[0][2],
-					vertices1[1][0], vertices1[1][1], vertices1[1][2],
-					vertices1[2][0], vertices1[2][1], vertices1[2][2]);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices2[0][0], vertices2[0][1], vertices2[0][2],
-					vertices2[1][0], vertices2[1][1], vertices2[1][2],
-					vertices2[2][0], vertices2[2][1], vertices2[2][2]);
+				int x0 = edgeX(x), x1 = edgeX(end);
+				if (side == 0) // block ground face
+				{
+					int top = edgeY(y);
+					addTriangle(terrain, {{x1, top, depth}, {x0, top, -depth}, {x0, top, depth}});
+					addTriangle(terrain, {{x0, top, -depth}, {x1, top, depth}, {x1, top, -depth}});
+				}
+				else // block bottom face
+				{
+					int bottom = edgeY(y+1);
+					addTriangle(terrain, {{x0, bottom, depth}, {x0, bottom, -depth}, {x1, bottom, depth}});
+					addTriangle(terrain, {{x1, bottom, -depth}, {x1, bottom, depth}, {x0, bottom, -depth}});
+				}
+				x = end;
 			}
+		}
+	}
 
-			// back
+	for (int x=0; x<width; x++)
+	{
+		for (int side=0; side<2; side++)
+		{
+			int neighbourX = side == 0 ? x-1 : x+1;
+			for (int y=0; y<height;)
 			{
-				vertices1[0][0] = pos.x + (0 / m_Scale);	vertices1[0][1] = pos.y + (0 / m_Scale);	vertices1[0][2] = pos.z + (64 / m_Scale);
-				vertices1[1][0] = pos.x + (32 / m_Scale);	vertices1[1][1] = pos.y + (32 / m_Scale);	vertices1[1][2] = pos.z + (64 / m_Scale);
-				vertices1[2][0] = pos.x + (0 / m_Scale);	vertices1[2][1] = pos.y + (32 / m_Scale);	vertices1[2][2] = pos.z + (64 / m_Scale);
-
-				vertices2[0][0] = pos.x + (32 / m_Scale);	vertices2[0][1] = pos.y + (32 / m_Scale);	vertices2[0][2] = pos.z + (64 / m_Scale);
-				vertices2[1][0] = pos.x + (0 / m_Scale);	vertices2[1][1] = pos.y + (0 / m_Scale);	vertices2[1][2] = pos.z + (64 / m_Scale);
-				vertices2[2][0] = pos.x + (32 / m_Scale);	vertices2[2][1] = pos.y + (0 / m_Scale);	vertices2[2][2] = pos.z + (64 / m_Scale);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices1[0][0], vertices1[0][1], vertices1[0][2],
-					vertices1[1][0], vertices1[1][1], vertices1[1][2],
-					vertices1[2][0], vertices1[2][1], vertices1[2][2]);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices2[0][0], vertices2[0][1], vertices2[0][2],
-					vertices2[1][0], vertices2[1][1], vertices2[1][2],
-					vertices2[2][0], vertices2[2][1], vertices2[2][2]);
-			}
+				if (!isSolid(x, y) || isSolid(neighbourX, y)) { y++; continue; }
 
-			// block bottom face
-			if (!down)
-			{
-				vertices1[0][0] = pos.x + (0 / m_Scale);	vertices1[0][1] = pos.y + (0 / m_Scale);	vertices1[0][2] = pos.z + (64 / m_Scale);
-				vertices1[1][0] = pos.x + (0 / m_Scale);	vertices1[1][1] = pos.y + (0 / m_Scale);	vertices1[1][2] = pos.z + (-64 / m_Scale);
-				vertices1[2][0] = pos.x + (32 / m_Scale);	vertices1[2][1] = pos.y + (0 / m_Scale);	vertices1[2][2] = pos.z + (64 / m_Scale);
-
-				vertices2[0][0] = pos.x + (32 / m_Scale);	vertices2[0][1] = pos.y + (0 / m_Scale);	vertices2[0][2] = pos.z + (-64 / m_Scale);
-				vertices2[1][0] = pos.x + (32 / m_Scale);	vertices2[1][1] = pos.y + (0 / m_Scale);	vertices2[1][2] = pos.z + (64 / m_Scale);
-				vertices2[2][0] = pos.x + (0 / m_Scale);	vertices2[2][1] = pos.y + (0 / m_Scale);	vertices2[2][2] = pos.z + (-64 / m_Scale);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices1[0][0], vertices1[0][1], vertices1[0][2],
-					vertices1[1][0], vertices1[1][1], vertices1[1][2],
-					vertices1[2][0], vertices1[2][1], vertices1[2][2]);
-
-				fprintf(f, "{SURFACE_DEFAULT,0,TERRAIN_STONE,{{%d,%d,%d},{%d,%d,%d},{%d,%d,%d}}},\n",
-					vertices2[0][0], vertices2[0][1], vertices2[0][2],
-					vertices2[1][0], vertices2[1][1], vertices2[1][2],
-					vertices2[2][0], vertices2[2][1], vertices2[2][2]);
+				int terrain = blockTerrain(x, y);
+				int end = y+1;
+				while (end < height && isSolid(x, end) && !isSolid(neighbourX, end) && blockTerrain(x, end) == terrain)
+					end++;
+
+				int top = edgeY(y), bottom = edgeY(end);
+				if (side == 0) // left (Z+)
+				{
+					int wall = edgeX(x);
+					addTriangle(terrain, {{wall, bottom, -depth}, {wall, top, depth}, {wall, top, -depth}});
+					addTriangle(terrain, {{wall, top, depth}, {wall, bottom, -depth}, {wall, bottom, depth}});
+				}
+				else // right (Z-)
+				{
+					int wall = edgeX(x+1);
+					addTriangle(terrain, {{wall, bottom, depth}, {wall, top, -depth}, {wall, top, depth}});
+					addTriangle(terrain, {{wall, top, -depth}, {wall, bottom, depth}, {wall, bottom, -depth}});
+				}
+				y = end;
 			}
 		}
 	}
 
-	fprintf(f, "};\nconst size_t surfaces_count = sizeof( surfaces ) / sizeof( surfaces[0] );\nconst int32_t spawn[3] = {%d, %d, 0};\n", spawnX, spawnY);
-	fclose(f);
+	// giant floor below the map to catch Mario if he falls out of it
+	int floorWidth = width/2 * 32 / scale;
+	int floorX = floorWidth;
+	int floorY = (height+205) * 32 / -scale;
+	addTriangle(TERRAIN_STONE, {{floorX + floorWidth + (400*32), floorY, +128}, {floorX - floorWidth - (400*32), floorY, -128}, {floorX - floorWidth - (400*32), floorY, +128}});
+	addTriangle(TERRAIN_STONE, {{floorX - floorWidth - (400*32), floorY, -128}, {floorX + floorWidth + (400*32), floorY, +128}, {floorX + floorWidth + (400*32), floorY, -128}});
+
+	sm64_static_surfaces_load(vSurfaces.data(), vSurfaces.size());
+	ms_MapSurfacesScale = scale;
+	ms_pMapSurfacesCollision = pCollision;
 }
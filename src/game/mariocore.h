@@ -4,6 +4,9 @@
 #define MAX_SURFACES 128
 
 #include <inttypes.h>
+#include <map>
+#include <tuple>
+#include <vector>
 
 extern "C" {
 	#include <libsm64.h>
@@ -11,6 +14,12 @@ extern "C" {
 
 #include "gamecore.h"
 
+// sent by clients in Cl_MarioInfo. servers send CNetObj_Mario instead of the laser outline to clients with the same version.
+// bump it whenever CNetObj_Mario changes
+enum
+{
+	MARIO_NET_VERSION = 2, // 2: CNetObj_Mario::m_TickPhase
+};
 
 class CMarioCore
 {
@@ -20,16 +29,73 @@ class CMarioCore
 	std::map<int, std::vector<vec2>> *m_pTeleOuts;
 	vec2 m_SpawnPos;
 
+	enum
+	{
+		FACE_UP = 1 << 0,
+		FACE_LEFT = 1 << 1,
+		FACE_RIGHT = 1 << 2,
+		FACE_DOWN = 1 << 3,
+		NUM_FACES = 4,
+		BLOCK_SNOW = 1 << 4,
+		BLOCK_EMPTY = -1,
+	};
+
+	// the map and scale the static surfaces were built for by LoadMapSurfaces
+	static float ms_MapSurfacesScale;
+	static CCollision *ms_pMapSurfacesCollision;
+	// spawned Marios standing on the static surfaces. libsm64 frees the old surfaces on a rebuild while these Marios
+	// still point into them, so the surfaces are only rebuilt for another scale when there are none
+	static int ms_NumMapSurfacesMarios;
+	bool MapSurfacesMatch() const { return ms_pMapSurfacesCollision == m_pCollision && ms_MapSurfacesScale == m_Scale; }
+
+	// blocks streamed in by several Marios are loaded once and shared. keyed by map, scale and tile
+	struct CSharedBlock
+	{
+		uint32_t m_SurfaceObject;
+		int m_Refs;
+	};
+	typedef std::tuple<CCollision *, float, int, int> SharedBlockKey;
+	static std::map<SharedBlockKey, CSharedBlock> ms_SharedBlocks;
+
 	int marioId;
 	float m_Tick;
+	// animation state after the last tick, sent in CNetObj_Mario
+	SM64AnimInfo m_AnimInfo;
+	int16_t m_aAnimRot[3];
 	float m_Scale;
+	bool m_UseMapSurfaces;
+
+	// sliding window of referenced blocks: shared surface object ID and tile position per slot
 	uint32_t m_currSurfaces[MAX_SURFACES];
+	ivec2 m_currBlocks[MAX_SURFACES];
+	SM64Surface m_aFaceSurfaces[NUM_FACES][2];
 
+	void initFaceSurfaces();
+	int blockFaces(int x, int y);
 	void deleteBlocks();
-	bool addBlock(int x, int y, int *i);
+	bool addBlock(int x, int y, ivec2 *pBlocks, int *pNumBlocks);
 	void loadNewBlocks(int x, int y);
+	uint32_t acquireBlock(ivec2 block);
+	void releaseBlock(ivec2 block);
 
-	void exportMap(int spawnX, int spawnY);
+	// the part of CMarioCore that a tick changes, saved in front of libsm64's state
+	struct alignas(16) CSavedCore
+	{
+		float m_Tick;
+		SM64MarioState m_State;
+		vec2 m_Pos, m_LastPos, m_CurrPos;
+		SM64AnimInfo m_AnimInfo;
+		int16_t m_aAnimRot[3];
+	};
+
+	// the pose libsm64 generated and the world space poses of the last two ticks, see m_GeneratePose
+	SM64MarioPose m_RawPose;
+	SM64MarioPose m_LastPose, m_CurrPose;
+
+	void allocGeometry();
+	void keepLastGeometry();
+	void storeGeometry(vec2 newPos);
+	void interpolate(float amount);
 
 public:
 	~CMarioCore();
@@ -37,14 +103,39 @@ public:
 	SM64MarioState state;
 	SM64MarioInputs input;
 	SM64MarioGeometryBuffers geometry;
+	bool m_GenerateGeometry = true; // without it only the physics are ticked and geometry stays empty
+	// generate pose instead of geometry, for renderers that transform the shared bind pose themselves
+	bool m_GeneratePose = false;
+	SM64MarioPose pose;
 
 	vec2 m_Pos, m_LastPos, m_CurrPos;
 	float m_LastGeometryPos[SM64_GEO_MAX_TRIANGLES * 9], m_CurrGeometryPos[SM64_GEO_MAX_TRIANGLES * 9];
+	int m_NumLastTriangles = 0; // used part of m_LastGeometryPos
 
 	void Init(CWorldCore *pWorld, CCollision *pCollision, vec2 spawnpos, float scale, std::map<int, std::vector<vec2>> *pTeleOuts = nullptr);
 	void Destroy();
 	void Reset();
 	void Tick(float tickspeed);
+	void Write(CNetObj_Mario *pObj) const;
+
+	// client-side prediction: the state after a tick is saved so the simulation can be rewound to it,
+	// corrected with the server's Mario of that tick and replayed with the inputs sent since
+	void SaveState(std::vector<uint8_t> &vState) const;
+	void RestoreState(const std::vector<uint8_t> &vState);
+	bool Reconcile(const CNetObj_Mario *pObj);
+	void InterpolatePredicted(float intra);
+
+	// a puppet Mario has no physics, it's posed from the snapshot of a Mario simulated by the server
+	void InitPuppet();
+	void PosePuppet(const CNetObj_Mario *pObj, bool firstPose);
+	void InterpolatePuppet(float intra);
+
+	// builds the collision mesh of the whole map and loads it as libsm64's static surfaces
+	static void LoadMapSurfaces(CCollision *pCollision, float scale);
+	static int NumSharedBlocks() { return ms_SharedBlocks.size(); }
+
+	// Tick only touches this Mario's own libsm64 state unless it streams blocks, so it can run in parallel with other Marios
+	bool CanTickInParallel() const {return m_UseMapSurfaces && MapSurfacesMatch();}
 
 	int ID() const {return marioId;}
 	float Scale() const {return m_Scale;}
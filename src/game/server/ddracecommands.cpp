@@ -5,6 +5,7 @@
 
 #include <engine/shared/config.h>
 #include <game/server/entities/character.h>
+#include <game/server/entities/mario.h>
 #include <game/server/gamemodes/DDRace.h>
 #include <game/server/player.h>
 #include <game/server/save.h>
@@ -827,3 +828,17 @@ void CGameContext::ConDumpAntibot(IConsole::IResult *pResult, void *pUserData)
 	CGameContext *pSelf = (CGameContext *)pUserData;
 	pSelf->Antibot()->Dump();
 }
+
+void CGameContext::ConMarioSurfaces(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+
+	int NumMarios = 0;
+	for(CEntity *pEnt = pSelf->m_World.FindFirst(CGameWorld::ENTTYPE_MARIO); pEnt; pEnt = pEnt->TypeNext())
+		NumMarios++;
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "marios=%d shared_blocks=%d surface_objects=%u surfaces=%u",
+		NumMarios, CMarioCore::NumSharedBlocks(), sm64_surface_object_count(), sm64_surface_count());
+	pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "mario", aBuf);
+}
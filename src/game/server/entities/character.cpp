@@ -2118,12 +2118,22 @@ void CCharacter::DDRacePostCoreTick()
 		return;
 
 	// handle Anti-Skip tiles
-	std::list<int> Indices = Collision()->GetMapIndices(m_PrevPos, m_Pos);
-	if(!Indices.empty())
+	int aIndices[64];
+	const int *pIndices = aIndices;
+	std::vector<int> vIndices;
+	int NumIndices = Collision()->GetMapIndices(m_PrevPos, m_Pos, aIndices, std::size(aIndices));
+	if(NumIndices > (int)std::size(aIndices))
 	{
-		for(int &Index : Indices)
+		// only long moves like teleports pass this many tiles
+		vIndices.resize(NumIndices);
+		Collision()->GetMapIndices(m_PrevPos, m_Pos, vIndices.data(), NumIndices);
+		pIndices = vIndices.data();
+	}
+	if(NumIndices)
+	{
+		for(int i = 0; i < NumIndices; i++)
 		{
-			HandleTiles(Index);
+			HandleTiles(pIndices[i]);
 			if(!m_Alive)
 				return;
 		}
@@ -9,18 +9,18 @@
 #include <game/generated/protocol.h>
 #include <game/server/gamecontext.h>
 
-#include "../quickhull/QuickHull.hpp"
-#include "../ConvexHull/ConvexHull.h"
-
 extern "C" {
 	#include <decomp/include/sm64shared.h>
 	#include <decomp/include/audio_defines.h>
 }
 
+int CMario::ms_NumOutlineIDs = 0;
+
 CMario::CMario(CGameWorld *pGameWorld, vec2 Pos, int owner) : CEntity(pGameWorld, CGameWorld::ENTTYPE_MARIO, Pos)
 {
 	GameWorld()->InsertEntity(this);
 	m_Owner = owner;
+	m_SpawnTick = Server()->Tick();
 
 	CCharacter *character = GameServer()->GetPlayerChar(m_Owner);
 	if (!character)
@@ -41,6 +41,8 @@ CMario::CMario(CGameWorld *pGameWorld, vec2 Pos, int owner) : CEntity(pGameWorld
 		return;
 	}
 
+	ReserveOutlineIDs(NUM_RESERVED_OUTLINE_IDS);
+
 	//GameServer()->m_apPlayers[m_Owner]->Pause(CPlayer::PAUSE_SPEC, true);
 	//GameServer()->m_apPlayers[m_Owner]->m_SpectatorID = m_Owner;
 
@@ -64,6 +66,7 @@ CMario::CMario(CGameWorld *pGameWorld, vec2 Pos, int owner) : CEntity(pGameWorld
 void CMario::Destroy()
 {
 	m_Core.Destroy();
+	FreeOutlineIDs();
 	GameServer()->m_World.m_Core.m_apMarios[m_Owner] = 0;
 	m_MarkedForDestroy = true;
 	if (GameServer()->m_apPlayers[m_Owner])
@@ -81,6 +84,28 @@ void CMario::Reset()
 	Destroy();
 }
 
+void CMario::ReserveOutlineIDs(int Num)
+{
+	// only grows, so a dot keeps its ID when the outline gets smaller for a few ticks.
+	// when the budget of all Marios is used up, the outline is drawn with fewer dots
+	while ((int)m_vOutlineIDs.size() < Num && ms_NumOutlineIDs < MAX_TOTAL_OUTLINE_IDS)
+	{
+		int id = Server()->SnapNewID();
+		if (id < 0)
+			break;
+		m_vOutlineIDs.push_back(id);
+		ms_NumOutlineIDs++;
+	}
+}
+
+void CMario::FreeOutlineIDs()
+{
+	for (int id : m_vOutlineIDs)
+		Server()->SnapFreeID(id);
+	ms_NumOutlineIDs -= m_vOutlineIDs.size();
+	m_vOutlineIDs.clear();
+}
+
 void CMario::Tick()
 {
 	if (!m_Core.Spawned()) return;
@@ -98,6 +123,7 @@ void CMario::Tick()
 	m_Core.input.buttonA = character->GetLatestInput()->m_Jump;
 	m_Core.input.buttonB = character->GetLatestInput()->m_Fire & 1;
 	m_Core.input.buttonZ = character->GetLatestInput()->m_Hook;
+	m_Core.m_GenerateGeometry = g_Config.m_MarioDrawMode != CMarioOutline::MODE_HITBOX;
 
 	if (g_Config.m_MarioAttackTees)
 	{
@@ -125,8 +151,26 @@ void CMario::Tick()
 		}
 	}
 
+}
+
+void CMario::TickCore()
+{
 	m_Core.Tick(1.f/Server()->TickSpeed());
 
+	// the outline only depends on Mario, build it once here instead of for every snapping client
+	m_Outline.Build(g_Config.m_MarioDrawMode, m_Core.geometry.position, 3 * m_Core.geometry.numTrianglesUsed,
+		m_Core.m_Pos, m_Core.Scale() * g_Config.m_MarioDrawScale / 100.f, m_Core.state.action & ACT_FLAG_SHORT_HITBOX);
+}
+
+void CMario::FinishTickCore()
+{
+	// snap IDs can only be taken on the main thread
+	ReserveOutlineIDs(minimum((int)m_Outline.Points().size(), (int)MAX_OUTLINE_IDS));
+
+	CPlayer *player = GameServer()->m_apPlayers[m_Owner];
+	CCharacter *character = GameServer()->GetPlayerChar(m_Owner);
+	if (!player || !character) return;
+
 	m_Pos = m_Core.m_Pos;
 	player->m_ViewPos = vec2(m_Pos.x, m_Pos.y-48);
 
@@ -141,89 +185,21 @@ void CMario::Snap(int SnappingClient)
 	if (!GameServer()->m_apPlayers[m_Owner] || !GameServer()->GetPlayerChar(m_Owner)) return;
 	if (NetworkClipped(SnappingClient, m_Pos)) return;
 
-	std::vector<ivec2> verticesSnapped;
-	for (int id : vertexIDs)
-		Server()->SnapFreeID(id);
-	vertexIDs.clear();
-
-	// QuickHull
-	std::vector<size_t> indexBuffer;
-	quickhull::VertexDataSource<float> vertexBuffer;
-
-	// ConvexHull
-	std::vector<Coordinate> convexHull;
-
-	size_t end = 3 * m_Core.geometry.numTrianglesUsed;
-
-	switch(g_Config.m_MarioDrawMode)
+	// clients of this mod pose Mario themselves, everyone else gets the laser outline
+	if (SnappingClient != SERVER_DEMO_CLIENT && GameServer()->m_apPlayers[SnappingClient]->m_MarioVersion == MARIO_NET_VERSION)
 	{
-		case 1:
-			{
-				quickhull::QuickHull<float> qh; // Could be double as well
-				std::vector<quickhull::Vector3<float> > pointCloud;
-
-				for (int i=0; i<3 * m_Core.geometry.numTrianglesUsed; i++)
-					pointCloud.push_back(quickhull::Vector3<float>(m_Core.geometry.position[i*3+0], m_Core.geometry.position[i*3+1], m_Core.geometry.position[i*3+2]));
-
-				quickhull::ConvexHull<float> hull = qh.getConvexHull(pointCloud, true, false);
-				indexBuffer = hull.getIndexBuffer();
-				vertexBuffer = hull.getVertexBuffer();
-				end = (indexBuffer.empty()) ? 0 : indexBuffer.size()-1;
-			}
-			break;
-
-		case 2:
-			{
-				std::vector<Coordinate> polygonPoints;
-
-				for (int i=0; i<3 * m_Core.geometry.numTrianglesUsed; i++)
-					polygonPoints.push_back({m_Core.geometry.position[i*3+0], m_Core.geometry.position[i*3+1]});
-
-				Polygon polygon(polygonPoints);
-				convexHull = polygon.ComputeConvexHull();
-				end = convexHull.size()-1;
-			}
-			break;
+		CNetObj_Mario *pMario = static_cast<CNetObj_Mario *>(Server()->SnapNewItem(NETOBJTYPE_MARIO, m_Owner, sizeof(CNetObj_Mario)));
+		if (pMario)
+			m_Core.Write(pMario);
+		return;
 	}
 
-	for (size_t i=0; i<end; i++)
+	const std::vector<ivec2> &vPoints = m_Outline.Points();
+	const int NumPoints = minimum((int)vPoints.size(), (int)m_vOutlineIDs.size());
+	for (int i = 0; i < NumPoints; i++)
 	{
-		ivec2 vertex, vertexTo;
-		switch(g_Config.m_MarioDrawMode)
-		{
-			case 0:
-				vertex = ivec2((int)m_Core.geometry.position[i*3+0], (int)m_Core.geometry.position[i*3+1]);
-				vertexTo = vertex;
-				break;
-
-			case 1:
-				vertex = ivec2((int)vertexBuffer[indexBuffer[i]].x, (int)vertexBuffer[indexBuffer[i]].y);
-				vertexTo = ivec2((int)vertexBuffer[indexBuffer[i+1]].x, (int)vertexBuffer[indexBuffer[i+1]].y);
-				break;
-
-			case 2:
-				vertex = ivec2((int)convexHull[i].GetX(), (int)convexHull[i].GetY());
-				vertexTo = ivec2((int)convexHull[i+1].GetX(), (int)convexHull[i+1].GetY());
-				break;
-		}
-
-		bool repeated = false;
-
-		for (size_t j=0; j<verticesSnapped.size(); j++)
-		{
-			if (verticesSnapped[j] == vertex)
-			{
-				repeated = true;
-				break;
-			}
-		}
-
-		if (repeated) continue;
-		verticesSnapped.push_back(vertex);
-		int id = Server()->SnapNewID();
-		vertexIDs.push_back(id);
-
-		CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(Server()->SnapNewItem(NETOBJTYPE_LASER, id, sizeof(CNetObj_Laser)));
+		const ivec2 &vertex = vPoints[i];
+		CNetObj_Laser *pObj = static_cast<CNetObj_Laser *>(Server()->SnapNewItem(NETOBJTYPE_LASER, m_vOutlineIDs[i], sizeof(CNetObj_Laser)));
 		if(!pObj)
 			continue;
 
@@ -231,6 +207,7 @@ void CMario::Snap(int SnappingClient)
 		pObj->m_FromY = vertex.y;
 		pObj->m_X = vertex.x;
 		pObj->m_Y = vertex.y;
-		pObj->m_StartTick = Server()->Tick() + Server()->TickSpeed();
+		// dots have no length so the start tick isn't rendered. keep it fixed so it doesn't change the item every tick
+		pObj->m_StartTick = m_SpawnTick;
 	}
 }
@@ -5,12 +5,29 @@
 #include <game/server/player.h>
 #include <game/mariocore.h>
 
+#include "mario_outline.h"
+
 class CMario : public CEntity
 {
 	CMarioCore m_Core;
-	std::vector<int> vertexIDs;
+	enum
+	{
+		NUM_RESERVED_OUTLINE_IDS = 64,
+		MAX_OUTLINE_IDS = 128,
+		// all Marios together, a quarter of the server's 32768 snap IDs so the other entities always get theirs
+		MAX_TOTAL_OUTLINE_IDS = 8192,
+	};
+	static int ms_NumOutlineIDs;
+
+	CMarioOutline m_Outline;
+	// snap IDs of the outline dots, held for Mario's whole life so each dot keeps its item key and unchanged dots delta to nothing
+	std::vector<int> m_vOutlineIDs;
+	int m_SpawnTick;
 	int m_Owner;
 
+	void ReserveOutlineIDs(int Num);
+	void FreeOutlineIDs();
+
 public:
 	CMario(CGameWorld *pGameWorld, vec2 Pos, int owner);
 
@@ -19,6 +36,12 @@ public:
 	void Destroy() override;
 	void Reset() override;
 	void Tick() override;
+	// advances Mario's simulation. called by the game world after Tick, possibly on a worker thread
+	void TickCore();
+	// applies the simulation result to the player and the character, back on the main thread
+	void FinishTickCore();
+	bool CanTickInParallel() const {return m_Core.CanTickInParallel();}
+	bool Spawned() const {return m_Core.Spawned();}
 	void Snap(int SnappingClient) override;
 };
 
@@ -0,0 +1,113 @@
+#include "mario_outline.h"
+
+#include <algorithm>
+
+#include "../ConvexHull/ConvexHull.h"
+#include "../quickhull/QuickHull.hpp"
+
+CMarioOutline::CMarioOutline() :
+	m_pQuickHull(new quickhull::QuickHull<float>())
+{
+}
+
+CMarioOutline::~CMarioOutline() = default;
+
+void CMarioOutline::Build(int Mode, const float *pPositions, int NumVertices, vec2 Pos, float HitboxScale, bool ShortHitbox)
+{
+	m_vPoints.clear();
+
+	switch(Mode)
+	{
+	case MODE_VERTICES:
+		for(int i = 0; i < NumVertices; i++)
+			m_vPoints.emplace_back((int)pPositions[i * 3 + 0], (int)pPositions[i * 3 + 1]);
+		break;
+
+	case MODE_QUICKHULL:
+		if(NumVertices > 0)
+		{
+			quickhull::ConvexHull<float> Hull = m_pQuickHull->getConvexHull(pPositions, NumVertices, true, false);
+			const std::vector<size_t> &vIndices = Hull.getIndexBuffer();
+			const quickhull::VertexDataSource<float> &Vertices = Hull.getVertexBuffer();
+			for(size_t i = 0; i + 1 < vIndices.size(); i++)
+				m_vPoints.emplace_back((int)Vertices[vIndices[i]].x, (int)Vertices[vIndices[i]].y);
+		}
+		break;
+
+	case MODE_CONVEXHULL:
+		if(NumVertices > 0)
+		{
+			std::vector<Coordinate> vPolygonPoints;
+			vPolygonPoints.reserve(NumVertices);
+			for(int i = 0; i < NumVertices; i++)
+				vPolygonPoints.push_back({pPositions[i * 3 + 0], pPositions[i * 3 + 1]});
+
+			Polygon Polygon(std::move(vPolygonPoints));
+			std::vector<Coordinate> vConvexHull = Polygon.ComputeConvexHull();
+			for(size_t i = 0; i + 1 < vConvexHull.size(); i++)
+				m_vPoints.emplace_back((int)vConvexHull[i].GetX(), (int)vConvexHull[i].GetY());
+		}
+		break;
+
+	case MODE_HITBOX:
+		BuildHitbox(Pos, HitboxScale, ShortHitbox);
+		break;
+	}
+
+	RemoveRepeatedPoints();
+}
+
+void CMarioOutline::BuildHitbox(vec2 Pos, float HitboxScale, bool ShortHitbox)
+{
+	// dots along Mario's hitbox with chamfered corners, same size as in SM64
+	float Radius = 37 * HitboxScale;
+	float Height = (ShortHitbox ? 100 : 160) * HitboxScale;
+	float Chamfer = Radius / 2;
+
+	const vec2 aCorners[] = {
+		vec2(-Radius + Chamfer, 0), vec2(Radius - Chamfer, 0), vec2(Radius, -Chamfer), vec2(Radius, -Height + Chamfer),
+		vec2(Radius - Chamfer, -Height), vec2(-Radius + Chamfer, -Height), vec2(-Radius, -Height + Chamfer), vec2(-Radius, -Chamfer)};
+	const int NumCorners = std::size(aCorners);
+
+	for(int c = 0; c < NumCorners; c++)
+	{
+		vec2 From = aCorners[c];
+		vec2 To = aCorners[(c + 1) % NumCorners];
+		int Steps = maximum(1, round_to_int(distance(From, To) / 16));
+		for(int s = 0; s < Steps; s++)
+		{
+			vec2 Point = Pos + mix(From, To, s / (float)Steps);
+			m_vPoints.emplace_back((int)Point.x, (int)Point.y);
+		}
+	}
+}
+
+// drops repeated points in O(n log n), keeping the first occurrence of each so the order stays stable
+void CMarioOutline::RemoveRepeatedPoints()
+{
+	const int NumPoints = m_vPoints.size();
+	m_vOrder.resize(NumPoints);
+	for(int i = 0; i < NumPoints; i++)
+		m_vOrder[i] = i;
+
+	std::sort(m_vOrder.begin(), m_vOrder.end(), [this](int a, int b) {
+		const ivec2 &A = m_vPoints[a];
+		const ivec2 &B = m_vPoints[b];
+		if(A.x != B.x)
+			return A.x < B.x;
+		if(A.y != B.y)
+			return A.y < B.y;
+		return a < b;
+	});
+
+	m_vRepeated.assign(NumPoints, false);
+	for(int i = 1; i < NumPoints; i++)
+		if(m_vPoints[m_vOrder[i]] == m_vPoints[m_vOrder[i - 1]])
+			m_vRepeated[m_vOrder[i]] = true;
+
+	int NumUnique = 0;
+	for(int i = 0; i < NumPoints; i++)
+		if(!m_vRepeated[i])
+			m_vPoints[NumUnique++] = m_vPoints[i];
+	m_vPoints.resize(NumUnique);
+}
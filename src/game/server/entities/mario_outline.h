@@ -0,0 +1,46 @@
+#ifndef GAME_SERVER_ENTITIES_MARIO_OUTLINE_H
+#define GAME_SERVER_ENTITIES_MARIO_OUTLINE_H
+
+#include <base/vmath.h>
+
+#include <memory>
+#include <vector>
+
+namespace quickhull {
+template<typename T>
+class QuickHull;
+}
+
+// Outline of Mario that is snapped to clients as laser dots.
+// It only depends on Mario's geometry, so it is built once per tick and shared by every snapshot
+class CMarioOutline
+{
+public:
+	enum
+	{
+		MODE_VERTICES = 0,
+		MODE_QUICKHULL,
+		MODE_CONVEXHULL,
+		MODE_HITBOX, // doesn't need Mario's mesh
+	};
+
+	CMarioOutline();
+	~CMarioOutline();
+
+	// pPositions holds NumVertices xyz positions in world coordinates. Pos is Mario's feet, HitboxScale converts SM64 units to world units
+	void Build(int Mode, const float *pPositions, int NumVertices, vec2 Pos, float HitboxScale, bool ShortHitbox);
+	const std::vector<ivec2> &Points() const { return m_vPoints; }
+
+private:
+	void BuildHitbox(vec2 Pos, float HitboxScale, bool ShortHitbox);
+	void RemoveRepeatedPoints();
+
+	std::vector<ivec2> m_vPoints;
+
+	// kept between builds to avoid allocating every tick
+	std::unique_ptr<quickhull::QuickHull<float>> m_pQuickHull;
+	std::vector<int> m_vOrder;
+	std::vector<bool> m_vRepeated;
+};
+
+#endif // GAME_SERVER_ENTITIES_MARIO_OUTLINE_H
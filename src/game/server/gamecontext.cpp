@@ -2299,6 +2299,11 @@ void CGameContext::OnMessage(int MsgID, CUnpacker *pUnpacker, int ClientID)
 			CNetMsg_Cl_ShowDistance *pMsg = (CNetMsg_Cl_ShowDistance *)pRawMsg;
 			pPlayer->m_ShowDistance = vec2(pMsg->m_X, pMsg->m_Y);
 		}
+		else if(MsgID == NETMSGTYPE_CL_MARIOINFO)
+		{
+			CNetMsg_Cl_MarioInfo *pMsg = (CNetMsg_Cl_MarioInfo *)pRawMsg;
+			pPlayer->m_MarioVersion = pMsg->m_Version;
+		}
 		else if(MsgID == NETMSGTYPE_CL_SETSPECTATORMODE && !m_World.m_Paused)
 		{
 			CNetMsg_Cl_SetSpectatorMode *pMsg = (CNetMsg_Cl_SetSpectatorMode *)pRawMsg;
@@ -3532,29 +3537,7 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 		Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "git-revision", GIT_SHORTREV_HASH);
 
 	// SM64
-	uint32_t surfaceCount = 2;
-	SM64Surface surfaces[surfaceCount];
-
-	for (uint32_t i=0; i<surfaceCount; i++)
-	{
-		surfaces[i].type = SURFACE_DEFAULT;
-		surfaces[i].force = 0;
-		surfaces[i].terrain = TERRAIN_STONE;
-	}
-	
-	int width = Collision()->GetWidth()/2 * 32 / (g_Config.m_MarioScale/100.f);
-	int spawnX = width;
-	int spawnY = (Collision()->GetHeight()+205) * 32 / (-g_Config.m_MarioScale/100.f);
-	
-	surfaces[surfaceCount-2].vertices[0][0] = spawnX + width + (400*32);	surfaces[surfaceCount-2].vertices[0][1] = spawnY;	surfaces[surfaceCount-2].vertices[0][2] = +128;
-	surfaces[surfaceCount-2].vertices[1][0] = spawnX - width - (400*32);	surfaces[surfaceCount-2].vertices[1][1] = spawnY;	surfaces[surfaceCount-2].vertices[1][2] = -128;
-	surfaces[surfaceCount-2].vertices[2][0] = spawnX - width - (400*32);	surfaces[surfaceCount-2].vertices[2][1] = spawnY;	surfaces[surfaceCount-2].vertices[2][2] = +128;
-
-	surfaces[surfaceCount-1].vertices[0][0] = spawnX - width - (400*32);	surfaces[surfaceCount-1].vertices[0][1] = spawnY;	surfaces[surfaceCount-1].vertices[0][2] = -128;
-	surfaces[surfaceCount-1].vertices[1][0] = spawnX + width + (400*32);	surfaces[surfaceCount-1].vertices[1][1] = spawnY;	surfaces[surfaceCount-1].vertices[1][2] = +128;
-	surfaces[surfaceCount-1].vertices[2][0] = spawnX + width + (400*32);	surfaces[surfaceCount-1].vertices[2][1] = spawnY;	surfaces[surfaceCount-1].vertices[2][2] = -128;
-
-	sm64_static_surfaces_load(surfaces, surfaceCount);
+	CMarioCore::LoadMapSurfaces(Collision(), g_Config.m_MarioScale/100.f);
 
 #ifdef CONF_DEBUG
 	if(g_Config.m_DbgDummies)
@@ -422,6 +422,7 @@ private:
 	static void ConUnFreezeHammer(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConMarioSpawn(IConsole::IResult *pResult, void *pUserData);
+	static void ConMarioSurfaces(IConsole::IResult *pResult, void *pUserData);
 
 	enum
 	{
@@ -3,14 +3,19 @@
 
 #include "gameworld.h"
 #include "entities/character.h"
+#include "entities/mario.h"
 #include "entity.h"
 #include "gamecontext.h"
 #include "gamecontroller.h"
 #include "player.h"
 
+#include <engine/engine.h>
 #include <engine/shared/config.h>
+#include <engine/shared/jobs.h>
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <utility>
 
 //////////////////////////////////////////////////
@@ -287,6 +292,8 @@ void CGameWorld::Tick()
 				pEnt = m_pNextTraverseEntity;
 			}
 
+		TickMarios();
+
 		for(auto *pEnt : m_apFirstEntityTypes)
 			for(; pEnt;)
 			{
@@ -320,6 +327,76 @@ void CGameWorld::Tick()
 	}
 }
 
+// Marios claim from a shared counter, so whichever of the workers and the main thread is free ticks the next one
+class CMarioTickBatch
+{
+public:
+	std::vector<CMario *> m_vpMarios;
+	std::atomic<int> m_NextMario{0};
+	std::atomic<int> m_NumTicked{0};
+	SEMAPHORE m_Done; // signaled once by whoever ticks the last Mario
+
+	CMarioTickBatch() { sphore_init(&m_Done); }
+	~CMarioTickBatch() { sphore_destroy(&m_Done); }
+
+	void Run()
+	{
+		int Index;
+		while((Index = m_NextMario.fetch_add(1)) < (int)m_vpMarios.size())
+		{
+			m_vpMarios[Index]->TickCore();
+			if(m_NumTicked.fetch_add(1) + 1 == (int)m_vpMarios.size())
+				sphore_signal(&m_Done);
+		}
+	}
+};
+
+class CMarioTickJob : public IJob
+{
+	std::shared_ptr<CMarioTickBatch> m_pBatch;
+	void Run() override { m_pBatch->Run(); }
+
+public:
+	CMarioTickJob(std::shared_ptr<CMarioTickBatch> pBatch) :
+		m_pBatch(std::move(pBatch))
+	{
+		// the tick waits for it
+		SetPriority(PRIORITY_HIGH);
+	}
+};
+
+void CGameWorld::TickMarios()
+{
+	auto pBatch = std::make_shared<CMarioTickBatch>();
+	for(CMario *pMario = (CMario *)FindFirst(ENTTYPE_MARIO); pMario; pMario = (CMario *)pMario->TypeNext())
+	{
+		if(pMario->m_MarkedForDestroy || !pMario->Spawned())
+			continue;
+
+		// Marios streaming blocks change the surfaces the others collide with, tick them alone first
+		if(!g_Config.m_MarioParallelTick || !pMario->CanTickInParallel())
+			pMario->TickCore();
+		else
+			pBatch->m_vpMarios.push_back(pMario);
+	}
+
+	const int NumMarios = pBatch->m_vpMarios.size();
+	if(NumMarios > 1)
+	{
+		const int NumJobs = minimum(NumMarios, (int)std::thread::hardware_concurrency()) - 1;
+		for(int i = 0; i < NumJobs; i++)
+			GameServer()->Engine()->AddJob(std::make_shared<CMarioTickJob>(pBatch));
+	}
+
+	pBatch->Run();
+	if(NumMarios > 0)
+		sphore_wait(&pBatch->m_Done);
+
+	for(CMario *pMario = (CMario *)FindFirst(ENTTYPE_MARIO); pMario; pMario = (CMario *)pMario->TypeNext())
+		if(!pMario->m_MarkedForDestroy && pMario->Spawned())
+			pMario->FinishTickCore();
+}
+
 void CGameWorld::SwapClients(int Client1, int Client2)
 {
 	// update all objects
@@ -41,6 +41,7 @@ private:
 	class IServer *m_pServer;
 
 	void UpdatePlayerMaps();
+	void TickMarios();
 
 public:
 	class CGameContext *GameServer() { return m_pGameServer; }
@@ -112,6 +112,7 @@ void CPlayer::Reset()
 	m_ShowOthers = g_Config.m_SvShowOthersDefault;
 	m_ShowAll = g_Config.m_SvShowAllDefault;
 	m_ShowDistance = vec2(1200, 800);
+	m_MarioVersion = 0;
 	m_SpecTeam = false;
 	m_NinjaJetpack = false;
 
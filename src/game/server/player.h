@@ -179,6 +179,7 @@ public:
 	int m_ShowOthers;
 	bool m_ShowAll;
 	vec2 m_ShowDistance;
+	int m_MarioVersion;
 	bool m_SpecTeam;
 	bool m_NinjaJetpack;
 	bool m_Afk;
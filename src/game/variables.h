@@ -203,13 +203,16 @@ MACRO_CONFIG_INT(SvPractice, sv_practice, 1, 0, 1, CFGFLAG_SERVER, "Enable pract
 
 // headbot
 MACRO_CONFIG_INT(SvDDNet9Timer, sv_ddnet9_timer, 1, 0, 1, CFGFLAG_SERVER, "Use the old DDNet9-style timer which allows you to manipulate envelopes and sounds with the game/race timer")
-MACRO_CONFIG_INT(MarioDrawMode, mario_draw_mode, 1, 0, 1, CFGFLAG_SERVER, "Set Mario draw mode. 0: vertices, 1: quickhull")
+MACRO_CONFIG_INT(MarioDrawMode, mario_draw_mode, 1, 0, 3, CFGFLAG_SERVER, "Set Mario draw mode. 0: vertices, 1: quickhull, 2: convex hull, 3: hitbox outline (Mario's mesh isn't generated)")
 MACRO_CONFIG_INT(MarioInvincible, mario_invincible, 1, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE | CFGFLAG_SERVER, "Whether Mario can't take damage")
 MACRO_CONFIG_INT(MarioScale, mario_scale, 75, 1, 500, CFGFLAG_CLIENT | CFGFLAG_SAVE | CFGFLAG_SERVER, "Set Mario's scale. Only applies when (re)spawning Mario")
 MACRO_CONFIG_INT(MarioDrawScale, mario_draw_scale, 100, 50, 500, CFGFLAG_CLIENT | CFGFLAG_SAVE | CFGFLAG_SERVER, "Set Mario's drawing scale. Relative to mario_scale")
 MACRO_CONFIG_INT(MarioAttackTees, mario_attack_tees, 0, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE | CFGFLAG_SERVER, "Whether Mario can attack tees by jumping on them or punching them")
 MACRO_CONFIG_INT(MarioTilesTele, mario_tiles_tele, 1, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE | CFGFLAG_SERVER, "Allow Mario to interact with teleport tiles")
+MACRO_CONFIG_INT(MarioParallelTick, mario_parallel_tick, 1, 0, 1, CFGFLAG_SERVER, "Tick Marios in parallel on the job pool")
 MACRO_CONFIG_INT(MarioCustomColors, mario_custom_colors, 0, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE, "Mario custom colors mode: 0 = off, 1 = tee colors")
+MACRO_CONFIG_INT(MarioPredict, mario_predict, 1, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE, "Predict your own Mario when the server simulates it")
+MACRO_CONFIG_INT(MarioGpuSkinning, mario_gpu_skinning, 0, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE, "Send Mario's part transforms to the GPU instead of his whole mesh every frame")
 
 MACRO_CONFIG_INT(ClVideoPauseWithDemo, cl_video_pausewithdemo, 1, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE, "Pause video rendering when demo playing pause")
 MACRO_CONFIG_INT(ClVideoShowhud, cl_video_showhud, 0, 0, 1, CFGFLAG_CLIENT | CFGFLAG_SAVE, "Show ingame HUD when rendering video")
@@ -0,0 +1,415 @@
+#include "collision.h"
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/config.h>
+#include <game/mapitems.h>
+
+#include <list>
+#include <vector>
+
+// the stepping of CCollision::GetMapIndices, with the layer checks done on every step like before they were cached
+static std::list<int> UncachedMapIndices(const CCollision &Collision, vec2 PrevPos, vec2 Pos)
+{
+	std::list<int> Indices;
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		vec2 Tmp = d ? mix(PrevPos, Pos, i / d) : Pos;
+		int Nx = clamp((int)Tmp.x / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, Collision.GetHeight() - 1);
+		int Index = Ny * Collision.GetWidth() + Nx;
+		if(Collision.ComputeTileExists(Index) && LastIndex != Index)
+		{
+			Indices.push_back(Index);
+			LastIndex = Index;
+		}
+		if(!d)
+			break;
+	}
+	return Indices;
+}
+
+// the line checks before they walked the tiles, stepping every pixel
+static int ReferenceIntersectLine(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int ReferenceIntersectLineTeleHook(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int dx = 0, dy = 0;
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportHook)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportHook(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int hit = 0;
+		if(Collision.CheckPoint(ix, iy))
+		{
+			if(!Collision.IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				hit = Collision.GetCollisionAt(ix, iy);
+		}
+		else if(Collision.IsHookBlocker(ix, iy, Pos0, Pos1))
+		{
+			hit = TILE_NOHOOK;
+		}
+		if(hit)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return hit;
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int ReferenceIntersectLineTeleWeapon(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int ix = round_to_int(Pos.x);
+		int iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		if(g_Config.m_SvOldTeleportWeapons)
+			*pTeleNr = Collision.IsTeleport(Index);
+		else
+			*pTeleNr = Collision.IsTeleportWeapon(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINWEAPON;
+		}
+
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int ReferenceIntersectNoLaser(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+	for(int i = 0, id = (int)ceilf(d); i < id; i++)
+	{
+		float a = (int)i / d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int Nx = clamp(round_to_int(Pos.x) / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp(round_to_int(Pos.y) / 32, 0, Collision.GetHeight() - 1);
+		if(Collision.GetIndex(Nx, Ny) == TILE_SOLID || Collision.GetIndex(Nx, Ny) == TILE_NOHOOK || Collision.GetIndex(Nx, Ny) == TILE_NOLASER || Collision.GetFIndex(Nx, Ny) == TILE_NOLASER)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(Collision.GetFIndex(Nx, Ny) == TILE_NOLASER)
+				return Collision.GetFCollisionAt(Pos.x, Pos.y);
+			else
+				return Collision.GetCollisionAt(Pos.x, Pos.y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static bool SameBits(vec2 a, vec2 b)
+{
+	return mem_comp(&a, &b, sizeof(vec2)) == 0;
+}
+
+TEST_F(CollisionMap, TileExistsMatchesLayers)
+{
+	const char *apMaps[] = {"data/maps/Tutorial.map", "data/maps/coverage.map"};
+	for(const char *pMap : apMaps)
+	{
+		if(!Load(pMap))
+		{
+			dbg_msg("collision", "%s not found, skipping", pMap);
+			continue;
+		}
+		int NumExisting = 0;
+		for(int i = 0; i < m_Collision.GetWidth() * m_Collision.GetHeight(); i++)
+		{
+			ASSERT_EQ(m_Collision.TileExists(i), m_Collision.ComputeTileExists(i)) << pMap << " tile " << i;
+			NumExisting += m_Collision.TileExists(i);
+		}
+		EXPECT_FALSE(m_Collision.TileExists(-1));
+		dbg_msg("collision", "%s: %d of %d tiles exist", pMap, NumExisting, m_Collision.GetWidth() * m_Collision.GetHeight());
+		Unload();
+	}
+}
+
+TEST_F(CollisionMap, SetCollisionAtUpdatesNeighbours)
+{
+	if(!Load("data/maps/Tutorial.map"))
+		return;
+
+	const int Width = m_Collision.GetWidth();
+	const int Height = m_Collision.GetHeight();
+	// find an empty tile in the middle of empty tiles
+	for(int y = 2; y < Height - 2; y++)
+		for(int x = 2; x < Width - 2; x++)
+		{
+			int Index = y * Width + x;
+			if(m_Collision.TileExists(Index) || m_Collision.TileExists(Index - 1) || m_Collision.TileExists(Index + 1) ||
+				m_Collision.TileExists(Index - Width) || m_Collision.TileExists(Index + Width))
+				continue;
+
+			int OldTile = m_Collision.GetTileIndex(Index);
+			m_Collision.SetCollisionAt(x * 32, y * 32, TILE_STOPA);
+			EXPECT_TRUE(m_Collision.TileExists(Index - 1));
+			EXPECT_TRUE(m_Collision.TileExists(Index + 1));
+			EXPECT_TRUE(m_Collision.TileExists(Index - Width));
+			EXPECT_TRUE(m_Collision.TileExists(Index + Width));
+
+			m_Collision.SetCollisionAt(x * 32, y * 32, TILE_FREEZE);
+			EXPECT_TRUE(m_Collision.TileExists(Index));
+			EXPECT_FALSE(m_Collision.TileExists(Index - 1));
+
+			m_Collision.SetCollisionAt(x * 32, y * 32, OldTile);
+			EXPECT_FALSE(m_Collision.TileExists(Index));
+			return;
+		}
+}
+
+// the tile walk must only skip samples, the results have to stay bit-identical to stepping every pixel
+TEST_F(CollisionMap, LineChecksMatchStepping)
+{
+	const char *apMaps[] = {"data/maps/Tutorial.map", "data/maps/coverage.map"};
+	for(const char *pMap : apMaps)
+	{
+		if(!Load(pMap))
+			continue;
+
+		const float Width = m_Collision.GetWidth() * 32.0f;
+		const float Height = m_Collision.GetHeight() * 32.0f;
+		unsigned Random = 1;
+		auto RandomFloat = [&Random](float Min, float Max) {
+			Random = Random * 1103515245 + 12345;
+			return Min + (Random >> 8) / (float)(1 << 24) * (Max - Min);
+		};
+
+		int NumHits = 0;
+		for(int i = 0; i < 20000; i++)
+		{
+			vec2 Pos0(RandomFloat(-64, Width + 64), RandomFloat(-64, Height + 64));
+			vec2 Pos1;
+			switch(i % 5)
+			{
+			case 0: // along a tile edge
+				Pos0 = vec2(round_to_int(Pos0.x / 32) * 32, Pos0.y);
+				Pos1 = vec2(Pos0.x, Pos0.y + RandomFloat(-800, 800));
+				break;
+			case 1:
+				Pos0 = vec2(Pos0.x, round_to_int(Pos0.y / 32) * 32 + 0.5f);
+				Pos1 = vec2(Pos0.x + RandomFloat(-800, 800), Pos0.y);
+				break;
+			case 2: // diagonal through tile corners
+				Pos0 = vec2(round_to_int(Pos0.x / 32) * 32, round_to_int(Pos0.y / 32) * 32);
+				Pos1 = Pos0 + vec2(1, i % 2 ? 1 : -1) * RandomFloat(-600, 600);
+				break;
+			case 3: // a few pixels
+				Pos1 = Pos0 + vec2(RandomFloat(-3, 3), RandomFloat(-3, 3));
+				break;
+			default: // hook and laser lengths
+				Pos1 = Pos0 + vec2(RandomFloat(-800, 800), RandomFloat(-800, 800));
+			}
+
+			vec2 aCol[2], aBefore[2];
+			int aHit[2], aTele[2];
+
+			aHit[0] = ReferenceIntersectLine(m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0]);
+			aHit[1] = m_Collision.IntersectLine(Pos0, Pos1, &aCol[1], &aBefore[1]);
+			ASSERT_EQ(aHit[0], aHit[1]) << pMap << " IntersectLine " << i;
+			ASSERT_TRUE(SameBits(aCol[0], aCol[1]) && SameBits(aBefore[0], aBefore[1])) << pMap << " IntersectLine " << i;
+			NumHits += aHit[0] != 0;
+
+			for(int Old = 0; Old < 2; Old++)
+			{
+				g_Config.m_SvOldTeleportHook = Old;
+				g_Config.m_SvOldTeleportWeapons = Old;
+
+				aHit[0] = ReferenceIntersectLineTeleHook(m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0], &aTele[0]);
+				aHit[1] = m_Collision.IntersectLineTeleHook(Pos0, Pos1, &aCol[1], &aBefore[1], &aTele[1]);
+				ASSERT_EQ(aHit[0], aHit[1]) << pMap << " IntersectLineTeleHook " << i;
+				ASSERT_EQ(aTele[0], aTele[1]) << pMap << " IntersectLineTeleHook " << i;
+				ASSERT_TRUE(SameBits(aCol[0], aCol[1]) && SameBits(aBefore[0], aBefore[1])) << pMap << " IntersectLineTeleHook " << i;
+
+				aHit[0] = ReferenceIntersectLineTeleWeapon(m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0], &aTele[0]);
+				aHit[1] = m_Collision.IntersectLineTeleWeapon(Pos0, Pos1, &aCol[1], &aBefore[1], &aTele[1]);
+				ASSERT_EQ(aHit[0], aHit[1]) << pMap << " IntersectLineTeleWeapon " << i;
+				ASSERT_EQ(aTele[0], aTele[1]) << pMap << " IntersectLineTeleWeapon " << i;
+				ASSERT_TRUE(SameBits(aCol[0], aCol[1]) && SameBits(aBefore[0], aBefore[1])) << pMap << " IntersectLineTeleWeapon " << i;
+			}
+			g_Config.m_SvOldTeleportHook = 0;
+			g_Config.m_SvOldTeleportWeapons = 0;
+
+			aHit[0] = ReferenceIntersectNoLaser(m_Collision, Pos0, Pos1, &aCol[0], &aBefore[0]);
+			aHit[1] = m_Collision.IntersectNoLaser(Pos0, Pos1, &aCol[1], &aBefore[1]);
+			ASSERT_EQ(aHit[0], aHit[1]) << pMap << " IntersectNoLaser " << i;
+			ASSERT_TRUE(SameBits(aCol[0], aCol[1]) && SameBits(aBefore[0], aBefore[1])) << pMap << " IntersectNoLaser " << i;
+
+			ASSERT_EQ(m_Collision.GetMapIndices(Pos0, Pos1), UncachedMapIndices(m_Collision, Pos0, Pos1)) << pMap << " GetMapIndices " << i;
+		}
+		dbg_msg("collision", "%s: %d of 20000 lines hit", pMap, NumHits);
+		Unload();
+	}
+}
+
+// 64 characters moving through a real map, collecting the tiles they pass like CCharacter::DDRaceTick
+TEST_F(CollisionMap, MapIndicesMatchUncached)
+{
+	if(!Load("data/maps/Tutorial.map"))
+		return;
+
+	SCharacter aChars[NUM_CHARACTERS];
+	vec2 aPrevPos[NUM_CHARACTERS];
+	SpawnCharacters(m_Collision, aChars);
+
+	unsigned Random = 1;
+	for(int Tick = 0; Tick < NUM_TICKS; Tick++)
+	{
+		TickCharacters(m_Collision, aChars, aPrevPos, &Random);
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+			ASSERT_EQ(m_Collision.GetMapIndices(aPrevPos[i], aChars[i].m_Pos), UncachedMapIndices(m_Collision, aPrevPos[i], aChars[i].m_Pos)) << "tick " << Tick << " character " << i;
+	}
+}
+
+// the tick time of MapIndicesMatchUncached with and without the cached layer checks.
+// only prints timings, run it with --gtest_also_run_disabled_tests
+TEST_F(CollisionMap, DISABLED_Benchmark)
+{
+	if(!Load("data/maps/Tutorial.map"))
+		return;
+
+	SCharacter aChars[NUM_CHARACTERS];
+	vec2 aPrevPos[NUM_CHARACTERS];
+	SpawnCharacters(m_Collision, aChars);
+
+	int64_t UncachedNs = 0, CachedNs = 0;
+	int NumIndices = 0;
+	unsigned Random = 1;
+	for(int Tick = 0; Tick < NUM_TICKS; Tick++)
+	{
+		TickCharacters(m_Collision, aChars, aPrevPos, &Random);
+
+		std::list<int> aUncached[NUM_CHARACTERS];
+		int64_t Start = time_get_nanoseconds().count();
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+			aUncached[i] = UncachedMapIndices(m_Collision, aPrevPos[i], aChars[i].m_Pos);
+		UncachedNs += time_get_nanoseconds().count() - Start;
+
+		std::list<int> aCached[NUM_CHARACTERS];
+		Start = time_get_nanoseconds().count();
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+			aCached[i] = m_Collision.GetMapIndices(aPrevPos[i], aChars[i].m_Pos);
+		CachedNs += time_get_nanoseconds().count() - Start;
+
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+		{
+			ASSERT_EQ(aCached[i], aUncached[i]) << "tick " << Tick << " character " << i;
+			NumIndices += aCached[i].size();
+		}
+	}
+
+	dbg_msg("collision", "%d characters, %d ticks, %d indices: layer checks %.1f us/tick, cached %.1f us/tick",
+		NUM_CHARACTERS, NUM_TICKS, NumIndices, UncachedNs / 1000.0 / NUM_TICKS, CachedNs / 1000.0 / NUM_TICKS);
+}
+
+TEST_F(CollisionMap, MapIndicesBufferMatchesList)
+{
+	if(!Load("data/maps/Tutorial.map"))
+		return;
+
+	const float Width = m_Collision.GetWidth() * 32.0f;
+	const float Height = m_Collision.GetHeight() * 32.0f;
+	unsigned Random = 1;
+	auto RandomFloat = [&Random](float Min, float Max) {
+		Random = Random * 1103515245 + 12345;
+		return Min + (Random >> 8) / (float)(1 << 24) * (Max - Min);
+	};
+
+	int aIndices[8];
+	std::vector<int> vIndices;
+	int NumOverflows = 0;
+	for(int i = 0; i < 5000; i++)
+	{
+		vec2 PrevPos(RandomFloat(0, Width), RandomFloat(0, Height));
+		vec2 Pos = i % 2 ? PrevPos + vec2(RandomFloat(-40, 40), RandomFloat(-40, 40)) : vec2(RandomFloat(0, Width), RandomFloat(0, Height));
+		std::list<int> Indices = m_Collision.GetMapIndices(PrevPos, Pos);
+
+		int NumIndices = m_Collision.GetMapIndices(PrevPos, Pos, aIndices, std::size(aIndices));
+		ASSERT_EQ(NumIndices, (int)Indices.size());
+		// a buffer that is too small is filled with the first indices
+		std::list<int> Written(aIndices, aIndices + minimum(NumIndices, (int)std::size(aIndices)));
+		std::list<int> First(Indices.begin(), std::next(Indices.begin(), Written.size()));
+		ASSERT_EQ(Written, First);
+
+		if(NumIndices > (int)std::size(aIndices))
+		{
+			NumOverflows++;
+			vIndices.resize(NumIndices);
+			ASSERT_EQ(m_Collision.GetMapIndices(PrevPos, Pos, vIndices.data(), NumIndices), NumIndices);
+			ASSERT_EQ(std::list<int>(vIndices.begin(), vIndices.end()), Indices);
+		}
+	}
+	EXPECT_GT(NumOverflows, 0);
+}
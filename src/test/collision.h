@@ -0,0 +1,95 @@
+#ifndef TEST_COLLISION_H
+#define TEST_COLLISION_H
+
+#include <gtest/gtest.h>
+
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/layers.h>
+
+#include <memory>
+
+// shared by the collision tests of the testrunner and testrunner_alloc
+
+constexpr int NUM_CHARACTERS = 64;
+constexpr int NUM_TICKS = 500;
+
+class CollisionMap : public ::testing::Test
+{
+protected:
+	std::unique_ptr<IKernel> m_pKernel;
+	IEngineMap *m_pMap = nullptr;
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	bool Load(const char *pMap)
+	{
+		m_pKernel = std::unique_ptr<IKernel>(IKernel::Create());
+		m_pKernel->RegisterInterface(CreateLocalStorage());
+		m_pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(m_pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(m_pMap), false);
+		if(!m_pMap->Load(pMap))
+			return false;
+		m_Layers.Init(m_pKernel.get());
+		m_Collision.Init(&m_Layers);
+		return true;
+	}
+
+	void Unload()
+	{
+		m_Collision.Dest();
+		m_pMap = nullptr;
+		m_pKernel.reset();
+	}
+
+	void TearDown() override
+	{
+		Unload();
+	}
+};
+
+struct SCharacter
+{
+	vec2 m_Pos;
+	vec2 m_Vel;
+};
+
+// characters falling and running through the map, bouncing off its walls
+inline void TickCharacters(const CCollision &Collision, SCharacter *pChars, vec2 *pPrevPos, unsigned *pRandom)
+{
+	for(int i = 0; i < NUM_CHARACTERS; i++)
+	{
+		SCharacter &Char = pChars[i];
+		pPrevPos[i] = Char.m_Pos;
+		*pRandom = *pRandom * 1103515245 + 12345;
+		if(*pRandom % 32 == 0)
+			Char.m_Vel.y = -14.0f; // jump
+		Char.m_Vel.y = minimum(Char.m_Vel.y + 0.5f, 20.0f);
+		Collision.MoveBox(&Char.m_Pos, &Char.m_Vel, vec2(28, 28), 0.5f);
+		if(Char.m_Vel.x == 0)
+			Char.m_Vel.x = (*pRandom >> 16) % 2 ? 10.0f : -10.0f;
+	}
+}
+
+inline void SpawnCharacters(const CCollision &Collision, SCharacter *pChars)
+{
+	unsigned Random = 1;
+	for(int i = 0; i < NUM_CHARACTERS; i++)
+	{
+		vec2 Pos;
+		do
+		{
+			Random = Random * 1103515245 + 12345;
+			Pos.x = 32 + (Random >> 8) % ((Collision.GetWidth() - 2) * 32);
+			Random = Random * 1103515245 + 12345;
+			Pos.y = 32 + (Random >> 8) % ((Collision.GetHeight() - 2) * 32);
+		} while(Collision.TestBox(Pos, vec2(28, 28)));
+		pChars[i].m_Pos = Pos;
+		pChars[i].m_Vel = vec2(i % 2 ? 10.0f : -10.0f, 0);
+	}
+}
+
+#endif // TEST_COLLISION_H
@@ -0,0 +1,82 @@
+#include "collision.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <cstdlib>
+#include <list>
+#include <new>
+
+// this file is the testrunner_alloc binary, so replacing operator new to count the heap allocations of the current
+// thread doesn't affect the other tests
+static thread_local bool s_CountAllocations = false;
+static thread_local int s_NumAllocations = 0;
+
+void *operator new(std::size_t Size)
+{
+	if(s_CountAllocations)
+		s_NumAllocations++;
+	void *pMem = malloc(Size ? Size : 1);
+	if(!pMem)
+		dbg_break();
+	return pMem;
+}
+
+void operator delete(void *pMem) noexcept
+{
+	free(pMem);
+}
+
+void operator delete(void *pMem, std::size_t) noexcept
+{
+	free(pMem);
+}
+
+// what CCharacter::DDRaceTick does with the indices every tick must not touch the heap
+TEST_F(CollisionMap, MapIndicesNoAllocations)
+{
+	if(!Load("data/maps/Tutorial.map"))
+		return;
+
+	SCharacter aChars[NUM_CHARACTERS];
+	vec2 aPrevPos[NUM_CHARACTERS];
+	SpawnCharacters(m_Collision, aChars);
+
+	int ListAllocations = 0;
+	int BufferAllocations = 0;
+	int64_t Checksum[2] = {0, 0};
+	unsigned Random = 1;
+	for(int Tick = 0; Tick < NUM_TICKS; Tick++)
+	{
+		TickCharacters(m_Collision, aChars, aPrevPos, &Random);
+
+		s_CountAllocations = true;
+		s_NumAllocations = 0;
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+		{
+			std::list<int> Indices = m_Collision.GetMapIndices(aPrevPos[i], aChars[i].m_Pos);
+			for(int Index : Indices)
+				Checksum[0] += Index;
+		}
+		ListAllocations += s_NumAllocations;
+
+		s_NumAllocations = 0;
+		for(int i = 0; i < NUM_CHARACTERS; i++)
+		{
+			int aIndices[64];
+			int NumIndices = m_Collision.GetMapIndices(aPrevPos[i], aChars[i].m_Pos, aIndices, std::size(aIndices));
+			ASSERT_LE(NumIndices, (int)std::size(aIndices));
+			for(int j = 0; j < NumIndices; j++)
+				Checksum[1] += aIndices[j];
+		}
+		BufferAllocations += s_NumAllocations;
+		s_CountAllocations = false;
+	}
+
+	EXPECT_EQ(Checksum[0], Checksum[1]);
+	// the list allocates a node per index, this also makes sure the counting works
+	EXPECT_GT(ListAllocations, 0);
+	EXPECT_EQ(BufferAllocations, 0);
+	dbg_msg("collision", "%d characters, %d ticks: std::list %d allocations, buffer %d allocations",
+		NUM_CHARACTERS, NUM_TICKS, ListAllocations, BufferAllocations);
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <base/system.h>
 #include <engine/shared/compression.h>
 
 static const int DATA[] = {0, 1, -1, 32, 64, 256, -512, 12345, -123456, 1234567, 12345678, 123456789, 2147483647, (-2147483647 - 1)};
@@ -82,3 +83,63 @@ TEST(CVariableInt, DecompressBufferTooSmall)
 	long CompressedSize = CVariableInt::Decompress(aCompressed, sizeof(aCompressed), aUncompressed, sizeof(aUncompressed));
 	ASSERT_EQ(CompressedSize, -1);
 }
+
+TEST(CVariableInt, CompressDecompressMatchScalar)
+{
+	unsigned State = 0x12345678;
+	auto Random = [&State]() {
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return State;
+	};
+
+	int aData[200];
+	int aOut[200];
+	int aScalarOut[200];
+	unsigned char aCompressed[sizeof(aData) / sizeof(int) * CVariableInt::MAX_BYTES_PACKED];
+	unsigned char aScalarCompressed[sizeof(aCompressed)];
+	for(int i = 0; i < 20000; i++)
+	{
+		// runs of small numbers like in snapshot deltas, mixed with bigger ones
+		int Num = Random() % std::size(aData);
+		int Large = Random() % 16;
+		for(int j = 0; j < Num; j++)
+		{
+			unsigned Value = Random();
+			unsigned Shifted = Value >> (Random() % 32);
+			aData[j] = Value % 16 < (unsigned)Large ? (int)(Value & 1 ? 0 - Shifted : Shifted) : (int)(Value % 128) - 64;
+		}
+		// sometimes too small
+		int DstSize = Random() % 4 == 0 ? Random() % sizeof(aCompressed) : sizeof(aCompressed);
+
+		long Size = CVariableInt::Compress(aData, Num * sizeof(int), aCompressed, DstSize);
+		long ScalarSize = CVariableInt::CompressScalar(aData, Num * sizeof(int), aScalarCompressed, DstSize);
+		ASSERT_EQ(Size, ScalarSize);
+		if(Size < 0)
+			continue;
+		ASSERT_EQ(mem_comp(aCompressed, aScalarCompressed, Size), 0);
+
+		int OutSize = Random() % 4 == 0 ? Random() % (Num + 1) * sizeof(int) : sizeof(aOut);
+		long DecompressedSize = CVariableInt::Decompress(aCompressed, Size, aOut, OutSize);
+		ASSERT_EQ(DecompressedSize, CVariableInt::DecompressScalar(aCompressed, Size, aScalarOut, OutSize));
+		if(DecompressedSize < 0)
+			continue;
+		ASSERT_EQ(DecompressedSize, Num * (long)sizeof(int));
+		ASSERT_EQ(mem_comp(aOut, aData, DecompressedSize), 0);
+	}
+
+	// garbage must be rejected the same way
+	for(int i = 0; i < 20000; i++)
+	{
+		int Size = Random() % 64;
+		for(int j = 0; j < Size; j++)
+			aCompressed[j] = Random() % 3 == 0 ? Random() : Random() % 0x80;
+		long DecompressedSize = CVariableInt::Decompress(aCompressed, Size, aOut, sizeof(aOut));
+		ASSERT_EQ(DecompressedSize, CVariableInt::DecompressScalar(aCompressed, Size, aScalarOut, sizeof(aScalarOut)));
+		if(DecompressedSize > 0)
+		{
+			ASSERT_EQ(mem_comp(aOut, aScalarOut, DecompressedSize), 0);
+		}
+	}
+}
@@ -141,3 +141,97 @@ TEST_F(Jobs, Many)
 	}
 	new(&m_Pool) CJobPool();
 }
+
+TEST(JobPool, HighPriorityFirst)
+{
+	// one worker, so the order is deterministic
+	CJobPool Pool;
+	Pool.Init(1);
+
+	SEMAPHORE Blocker;
+	sphore_init(&Blocker);
+	SEMAPHORE Done;
+	sphore_init(&Done);
+	Pool.Add(std::make_shared<CJob>([&] { sphore_wait(&Blocker); }));
+
+	std::vector<int> vOrder;
+	const int NumJobs = 10;
+	for(int i = 0; i < NumJobs; i++)
+		Pool.Add(std::make_shared<CJob>([&, i] { vOrder.push_back(i); sphore_signal(&Done); }));
+	auto pHigh = std::make_shared<CJob>([&] { vOrder.push_back(-1); sphore_signal(&Done); });
+	pHigh->SetPriority(IJob::PRIORITY_HIGH);
+	Pool.Add(pHigh);
+
+	sphore_signal(&Blocker);
+	for(int i = 0; i < NumJobs + 1; i++)
+		sphore_wait(&Done);
+	ASSERT_EQ((int)vOrder.size(), NumJobs + 1);
+	EXPECT_EQ(vOrder[0], -1);
+	for(int i = 0; i < NumJobs; i++)
+		EXPECT_EQ(vOrder[i + 1], i);
+
+	Pool.Destroy();
+	sphore_destroy(&Blocker);
+	sphore_destroy(&Done);
+}
+
+TEST_F(Jobs, AddFromJobs)
+{
+	// jobs added by workers go to their own queue and are stolen by the others
+	const int NumParents = 8;
+	const int NumChildren = 100;
+	std::atomic<int> NumDone(0);
+	SEMAPHORE sphore;
+	sphore_init(&sphore);
+	for(int i = 0; i < NumParents; i++)
+	{
+		Add(std::make_shared<CJob>([&] {
+			for(int j = 0; j < NumChildren; j++)
+				Add(std::make_shared<CJob>([&] {
+					if(NumDone.fetch_add(1) == NumParents * NumChildren - 1)
+						sphore_signal(&sphore);
+				}));
+		}));
+	}
+	sphore_wait(&sphore);
+	sphore_destroy(&sphore);
+	EXPECT_EQ(NumDone.load(), NumParents * NumChildren);
+}
+
+
+// many small jobs, from the outside and added by jobs.
+// only prints the throughput, run it with --gtest_also_run_disabled_tests
+TEST_F(Jobs, DISABLED_Benchmark)
+{
+	const int NumJobs = 200000;
+	for(int FromJobs = 0; FromJobs < 2; FromJobs++)
+	{
+		std::atomic<int> NumDone(0);
+		SEMAPHORE sphore;
+		sphore_init(&sphore);
+		auto Work = [&] {
+			if(NumDone.fetch_add(1) == NumJobs - 1)
+				sphore_signal(&sphore);
+		};
+		int64_t Start = time_get_nanoseconds().count();
+		if(FromJobs)
+		{
+			const int NumParents = TEST_NUM_THREADS * 4;
+			for(int i = 0; i < NumParents; i++)
+				Add(std::make_shared<CJob>([&] {
+					for(int j = 0; j < NumJobs / NumParents; j++)
+						Add(std::make_shared<CJob>(Work));
+				}));
+		}
+		else
+		{
+			for(int i = 0; i < NumJobs; i++)
+				Add(std::make_shared<CJob>(Work));
+		}
+		sphore_wait(&sphore);
+		int64_t Ns = time_get_nanoseconds().count() - Start;
+		sphore_destroy(&sphore);
+		EXPECT_EQ(NumDone.load(), NumJobs);
+		dbg_msg("jobs", "%d jobs added %s: %.0f jobs/s", NumJobs, FromJobs ? "by jobs" : "from outside", NumJobs * 1e9 / Ns);
+	}
+}
@@ -0,0 +1,137 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+#include <game/generated/protocol.h>
+#include <game/server/entities/mario_outline.h>
+
+#include <vector>
+
+static const int NUM_SNAPS = 100;
+static const int NUM_TRIANGLES = 700;
+static const int FIRST_OUTLINE_ID = 100;
+
+// Mario walking to the right: the mesh moves and its limbs swing a little every snapshot
+static void WalkingMarioMesh(int Snap, std::vector<float> &vPositions)
+{
+	vPositions.clear();
+	unsigned State = 0x12345678;
+	auto Random = [&State]() {
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return (State % 2001) / 1000.0f - 1.0f;
+	};
+
+	float Swing = (Snap % 8 - 4) / 4.0f;
+	for(int i = 0; i < NUM_TRIANGLES * 3; i++)
+	{
+		float x = Random() * 30;
+		float y = -60 + Random() * 60;
+		if(y > -20) // legs
+			x += Swing * (x > 0 ? 6 : -6);
+		vPositions.push_back(1000 + Snap * 4 + x);
+		vPositions.push_back(500 + y);
+		vPositions.push_back(Random() * 30);
+	}
+}
+
+static void SnapLasers(CSnapshotBuilder *pBuilder, const CMarioOutline &Outline, int FirstID)
+{
+	int ID = FirstID;
+	for(const ivec2 &Point : Outline.Points())
+	{
+		CNetObj_Laser *pObj = (CNetObj_Laser *)pBuilder->NewItem(NETOBJTYPE_LASER, ID++, sizeof(CNetObj_Laser));
+		ASSERT_TRUE(pObj);
+		pObj->m_X = pObj->m_FromX = Point.x;
+		pObj->m_Y = pObj->m_FromY = Point.y;
+		pObj->m_StartTick = 1;
+	}
+}
+
+static void SnapMario(CSnapshotBuilder *pBuilder, int Snap)
+{
+	CNetObj_Mario *pObj = (CNetObj_Mario *)pBuilder->NewItem(NETOBJTYPE_MARIO, 0, sizeof(CNetObj_Mario));
+	ASSERT_TRUE(pObj);
+	pObj->m_X = 1000 + Snap * 4;
+	pObj->m_Y = 500;
+	pObj->m_VelX = 4 * 256;
+	pObj->m_VelY = 0;
+	pObj->m_Action = 0x04000440; // ACT_WALKING
+	pObj->m_Flags = 0x00000001;
+	pObj->m_AnimID = 72; // MARIO_ANIM_WALKING
+	pObj->m_AnimFrame = Snap * 2 % 80;
+	pObj->m_AnimAccel = 0x10000;
+	pObj->m_AngleX = 0;
+	pObj->m_AngleY = 0x4000;
+	pObj->m_AngleZ = 0;
+	pObj->m_Scale = 75;
+	pObj->m_TickPhase = 0;
+}
+
+class CMarioSnapSizes
+{
+public:
+	CSnapshotBuilder m_Builder;
+	CSnapshotDelta m_Delta;
+	std::vector<char> m_vPrev;
+	std::vector<char> m_vCurr;
+	int m_TotalBytes = 0;
+
+	CMarioSnapSizes() :
+		m_vPrev(CSnapshot::MAX_SIZE), m_vCurr(CSnapshot::MAX_SIZE)
+	{
+	}
+
+	// returns the compressed size of the delta from the previous snapshot
+	int Finish(int Snap)
+	{
+		m_Builder.Finish(m_vCurr.data());
+		int Bytes = 0;
+		if(Snap > 0)
+		{
+			static char s_aDelta[CSnapshot::MAX_SIZE];
+			static char s_aCompressed[CSnapshot::MAX_SIZE];
+			int DeltaSize = m_Delta.CreateDelta((CSnapshot *)m_vPrev.data(), (CSnapshot *)m_vCurr.data(), s_aDelta);
+			Bytes = CVariableInt::Compress(s_aDelta, DeltaSize, s_aCompressed, sizeof(s_aCompressed));
+			m_TotalBytes += Bytes;
+		}
+		std::swap(m_vPrev, m_vCurr);
+		return Bytes;
+	}
+};
+
+TEST(MarioNetObj, BytesPerSnapshot)
+{
+	std::vector<float> vPositions;
+	CMarioOutline Outline;
+	CMarioSnapSizes FreshIDs, StableIDs, NetObj;
+
+	for(int Snap = 0; Snap < NUM_SNAPS; Snap++)
+	{
+		WalkingMarioMesh(Snap, vPositions);
+		Outline.Build(CMarioOutline::MODE_QUICKHULL, vPositions.data(), vPositions.size() / 3, vec2(1000 + Snap * 4, 500), 0.75f, false);
+
+		// the outline used to get new snap IDs every snapshot
+		FreshIDs.m_Builder.Init();
+		SnapLasers(&FreshIDs.m_Builder, Outline, FIRST_OUTLINE_ID + (Snap % 2) * CSnapshot::MAX_ITEMS / 2);
+		FreshIDs.Finish(Snap);
+
+		StableIDs.m_Builder.Init();
+		SnapLasers(&StableIDs.m_Builder, Outline, FIRST_OUTLINE_ID);
+		StableIDs.Finish(Snap);
+
+		NetObj.m_Builder.Init();
+		SnapMario(&NetObj.m_Builder, Snap);
+		NetObj.Finish(Snap);
+	}
+
+	const double Deltas = NUM_SNAPS - 1;
+	dbg_msg("mario_netobj", "bytes per mario per snapshot: lasers with fresh IDs %.1f, lasers with stable IDs %.1f, CNetObj_Mario %.1f",
+		FreshIDs.m_TotalBytes / Deltas, StableIDs.m_TotalBytes / Deltas, NetObj.m_TotalBytes / Deltas);
+
+	EXPECT_LT(StableIDs.m_TotalBytes, FreshIDs.m_TotalBytes);
+	EXPECT_LT(NetObj.m_TotalBytes * 4, StableIDs.m_TotalBytes);
+}
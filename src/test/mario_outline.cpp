@@ -0,0 +1,124 @@
+#include "test.h"
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/entities/mario_outline.h>
+
+#include <set>
+#include <vector>
+
+// roughly the triangle count of Mario's mesh
+static const int NUM_TRIANGLES = 700;
+static const int NUM_CLIENTS = 64;
+
+// deterministic point cloud shaped like Mario standing at (1000, 500), in world coordinates
+static std::vector<float> MarioLikeMesh()
+{
+	std::vector<float> vPositions;
+	unsigned State = 0x12345678;
+	auto Random = [&State]() {
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return (State % 2001) / 1000.0f - 1.0f;
+	};
+
+	for(int i = 0; i < NUM_TRIANGLES * 3; i++)
+	{
+		vPositions.push_back(1000 + Random() * 30);
+		vPositions.push_back(500 - 60 + Random() * 60);
+		vPositions.push_back(Random() * 30);
+	}
+	return vPositions;
+}
+
+static void ExpectNoRepeatedPoints(const std::vector<ivec2> &vPoints)
+{
+	std::set<std::pair<int, int>> Seen;
+	for(const ivec2 &Point : vPoints)
+		EXPECT_TRUE(Seen.emplace(Point.x, Point.y).second) << Point.x << "," << Point.y;
+}
+
+TEST(MarioOutline, NoRepeatedPoints)
+{
+	std::vector<float> vPositions = MarioLikeMesh();
+	CMarioOutline Outline;
+	for(int Mode = CMarioOutline::MODE_VERTICES; Mode <= CMarioOutline::MODE_HITBOX; Mode++)
+	{
+		Outline.Build(Mode, vPositions.data(), vPositions.size() / 3, vec2(1000, 500), 0.25f, false);
+		EXPECT_FALSE(Outline.Points().empty()) << "mode " << Mode;
+		ExpectNoRepeatedPoints(Outline.Points());
+	}
+}
+
+TEST(MarioOutline, KeepsFirstOccurrence)
+{
+	const float aPositions[] = {
+		3, 4, 0,
+		1, 2, 0,
+		3, 4, 5,
+		7, 8, 0,
+		1, 2, 9};
+	CMarioOutline Outline;
+	Outline.Build(CMarioOutline::MODE_VERTICES, aPositions, 5, vec2(0, 0), 1, false);
+	ASSERT_EQ(Outline.Points().size(), 3u);
+	EXPECT_EQ(Outline.Points()[0], ivec2(3, 4));
+	EXPECT_EQ(Outline.Points()[1], ivec2(1, 2));
+	EXPECT_EQ(Outline.Points()[2], ivec2(7, 8));
+}
+
+TEST(MarioOutline, HitboxWithoutMesh)
+{
+	CMarioOutline Outline;
+	Outline.Build(CMarioOutline::MODE_HITBOX, nullptr, 0, vec2(100, 200), 0.25f, false);
+	ASSERT_FALSE(Outline.Points().empty());
+	ExpectNoRepeatedPoints(Outline.Points());
+	for(const ivec2 &Point : Outline.Points())
+	{
+		EXPECT_LE(Point.y, 200);
+		EXPECT_GE(Point.y, 200 - 40);
+	}
+
+	std::vector<ivec2> vTall = Outline.Points();
+	Outline.Build(CMarioOutline::MODE_HITBOX, nullptr, 0, vec2(100, 200), 0.25f, true);
+	EXPECT_LT(Outline.Points().size(), vTall.size());
+}
+
+// the snap cost per Mario when building the outline for every snapping client (the old Snap) against building it once per tick.
+// only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(MarioOutline, DISABLED_Benchmark)
+{
+	std::vector<float> vPositions = MarioLikeMesh();
+	const int NumVertices = vPositions.size() / 3;
+	const int NumSnaps = 10;
+
+	for(int Mode = CMarioOutline::MODE_VERTICES; Mode <= CMarioOutline::MODE_HITBOX; Mode++)
+	{
+		CMarioOutline Outline;
+		int64_t Checksum[2] = {0, 0};
+
+		int64_t Start = time_get_nanoseconds().count();
+		for(int Snap = 0; Snap < NumSnaps; Snap++)
+			for(int Client = 0; Client < NUM_CLIENTS; Client++)
+			{
+				Outline.Build(Mode, vPositions.data(), NumVertices, vec2(1000, 500), 0.25f, false);
+				for(const ivec2 &Point : Outline.Points())
+					Checksum[0] += Point.x + Point.y;
+			}
+		int64_t PerClient = time_get_nanoseconds().count() - Start;
+
+		Start = time_get_nanoseconds().count();
+		for(int Snap = 0; Snap < NumSnaps; Snap++)
+		{
+			Outline.Build(Mode, vPositions.data(), NumVertices, vec2(1000, 500), 0.25f, false);
+			for(int Client = 0; Client < NUM_CLIENTS; Client++)
+				for(const ivec2 &Point : Outline.Points())
+					Checksum[1] += Point.x + Point.y;
+		}
+		int64_t Cached = time_get_nanoseconds().count() - Start;
+
+		EXPECT_EQ(Checksum[0], Checksum[1]);
+		dbg_msg("mario_outline", "mode %d, %d points, %d clients: per client %.0f ns/mario/snap, cached %.0f ns/mario/snap",
+			Mode, (int)Outline.Points().size(), NUM_CLIENTS, PerClient / (double)NumSnaps, Cached / (double)NumSnaps);
+	}
+}
@@ -45,3 +45,68 @@ TEST(Net, Ipv4AndIpv6Work)
 	EXPECT_EQ(Addr, LocalhostV6);
 	EXPECT_EQ(mem_comp(pData, "def", 3), 0);
 }
+
+TEST(Net, BatchedSendsArriveInOrder)
+{
+	NETADDR Bindaddr = {};
+	NETSOCKET Socket1;
+	NETSOCKET Socket2;
+
+	Bindaddr.type = NETTYPE_IPV4 | NETTYPE_IPV6;
+	Socket2 = net_udp_create(Bindaddr);
+	do
+	{
+		Bindaddr.port = secure_rand() % 64511 + 1024;
+	} while(!(Socket1 = net_udp_create(Bindaddr)));
+
+	NETADDR TargetV4;
+	NETADDR TargetV6;
+	ASSERT_FALSE(net_addr_from_str(&TargetV4, "127.0.0.1"));
+	ASSERT_FALSE(net_addr_from_str(&TargetV6, "[::1]"));
+	TargetV4.port = Bindaddr.port;
+	TargetV6.port = Bindaddr.port;
+
+	// more than fit into one system call
+	const int NumPackets = 200;
+	NETSTATS Before;
+	net_stats(&Before);
+	net_udp_batch_begin(Socket2);
+	for(int i = 0; i < NumPackets; i++)
+	{
+		char aData[16];
+		str_format(aData, sizeof(aData), "packet %d", i);
+		EXPECT_EQ(net_udp_send(Socket2, i % 2 ? &TargetV6 : &TargetV4, aData, str_length(aData)), str_length(aData));
+	}
+	net_udp_batch_end(Socket2);
+	NETSTATS After;
+	net_stats(&After);
+	EXPECT_EQ(After.sent_packets - Before.sent_packets, (uint64_t)NumPackets);
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_LT(After.send_syscalls - Before.send_syscalls, (uint64_t)NumPackets / 10);
+#endif
+
+	// packets of each address family arrive in the order they were sent
+	int aNext[2] = {0, 1};
+	for(int i = 0; i < NumPackets; i++)
+	{
+		// received packets are buffered, only wait once they are used up
+		NETADDR Addr;
+		unsigned char *pData;
+		int Size = net_udp_recv(Socket1, &Addr, &pData);
+		if(Size <= 0)
+		{
+			ASSERT_EQ(net_socket_read_wait(Socket1, 10000000), 1);
+			Size = net_udp_recv(Socket1, &Addr, &pData);
+		}
+		ASSERT_GT(Size, 0);
+		int Family = Addr.type == NETTYPE_IPV6 ? 1 : 0;
+		char aExpected[16];
+		str_format(aExpected, sizeof(aExpected), "packet %d", aNext[Family]);
+		ASSERT_EQ(Size, str_length(aExpected));
+		EXPECT_EQ(mem_comp(pData, aExpected, Size), 0);
+		aNext[Family] += 2;
+	}
+
+	net_udp_close(Socket1);
+	net_udp_close(Socket2);
+}
@@ -0,0 +1,299 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/snapshot.h>
+#include <game/generated/protocol.h>
+
+#include <vector>
+
+static const int NUM_PLAYERS = 64;
+static const int NUM_PROJECTILES = 100;
+
+static unsigned NextRandom(unsigned *pState)
+{
+	*pState ^= *pState << 13;
+	*pState ^= *pState >> 17;
+	*pState ^= *pState << 5;
+	return *pState;
+}
+
+// mostly zeros and small numbers like in deltas, sometimes anything
+static int RandomDeltaInt(unsigned *pState)
+{
+	unsigned Random = NextRandom(pState);
+	switch(Random % 8)
+	{
+	case 0:
+	case 1:
+	case 2: return 0;
+	case 3:
+	case 4: return (int)(Random >> 8) % 64 - 32;
+	case 5: return (int)(Random >> 8) % 20000 - 10000;
+	case 6:
+	{
+		unsigned Value = NextRandom(pState) >> (NextRandom(pState) % 32);
+		return (int)(Random & 0x80 ? 0 - Value : Value);
+	}
+	default: return (int)NextRandom(pState);
+	}
+}
+
+TEST(SnapshotDelta, DiffUndiffMatchScalar)
+{
+	unsigned State = 0x12345678;
+	std::vector<int> vPast, vCurrent, vOut, vScalarOut;
+	for(int i = 0; i < 20000; i++)
+	{
+		int Size = NextRandom(&State) % 70;
+		vPast.resize(Size);
+		vCurrent.resize(Size);
+		vOut.resize(Size);
+		vScalarOut.resize(Size);
+		for(int j = 0; j < Size; j++)
+		{
+			vPast[j] = (int)NextRandom(&State);
+			// wrap around instead of overflowing
+			vCurrent[j] = (int)((unsigned)vPast[j] + (unsigned)RandomDeltaInt(&State));
+		}
+
+		int Needed = CSnapshotDelta::DiffItem(vPast.data(), vCurrent.data(), vOut.data(), Size);
+		int ScalarNeeded = CSnapshotDelta::DiffItemScalar(vPast.data(), vCurrent.data(), vScalarOut.data(), Size);
+		ASSERT_EQ(Needed, ScalarNeeded) << "size " << Size;
+		ASSERT_EQ(vOut, vScalarOut) << "size " << Size;
+
+		std::vector<int> vDiff = vOut;
+		int DataRate = 0, ScalarDataRate = 0;
+		CSnapshotDelta::UndiffItem(vPast.data(), vDiff.data(), vOut.data(), Size, &DataRate);
+		CSnapshotDelta::UndiffItemScalar(vPast.data(), vDiff.data(), vScalarOut.data(), Size, &ScalarDataRate);
+		ASSERT_EQ(DataRate, ScalarDataRate) << "size " << Size;
+		ASSERT_EQ(vOut, vScalarOut) << "size " << Size;
+		ASSERT_EQ(vOut, vCurrent) << "size " << Size;
+	}
+}
+
+// a DDRace server with everyone moving around and some projectiles
+static int BuildSnapshot(int Tick, CSnapshot *pSnapshot)
+{
+	static CSnapshotBuilder s_Builder;
+	s_Builder.Init();
+	for(int i = 0; i < NUM_PLAYERS; i++)
+	{
+		CNetObj_PlayerInfo *pInfo = (CNetObj_PlayerInfo *)s_Builder.NewItem(NETOBJTYPE_PLAYERINFO, i, sizeof(CNetObj_PlayerInfo));
+		pInfo->m_ClientID = i;
+		pInfo->m_Score = -9999;
+		pInfo->m_Latency = 20 + (i + Tick / 50) % 30;
+
+		CNetObj_ClientInfo *pClientInfo = (CNetObj_ClientInfo *)s_Builder.NewItem(NETOBJTYPE_CLIENTINFO, i, sizeof(CNetObj_ClientInfo));
+		for(int j = 0; j < (int)(sizeof(CNetObj_ClientInfo) / sizeof(int)); j++)
+			((int *)pClientInfo)[j] = (int)(0x80808080u + i * 0x01020304u + j * 0x11111111u);
+
+		CNetObj_Character *pChar = (CNetObj_Character *)s_Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+		pChar->m_Tick = Tick - i % 3;
+		pChar->m_X = 1000 + i * 100 + (Tick * (i % 7 + 1)) % 2000;
+		pChar->m_Y = 2000 + (i % 5 == 0 ? (Tick * 3) % 300 : 0);
+		pChar->m_VelX = (i % 7 + 1) * 256;
+		pChar->m_VelY = i % 5 == 0 ? 3 * 256 : 0;
+		pChar->m_Angle = (Tick * 13 + i * 100) % 1600;
+		pChar->m_Direction = i % 3 - 1;
+		pChar->m_Jumped = i % 5 == 0;
+		pChar->m_HookedPlayer = -1;
+		pChar->m_HookState = i % 4 == 0 ? 1 : 0;
+		pChar->m_HookTick = i % 4 == 0 ? Tick % 60 : 0;
+		pChar->m_HookX = pChar->m_X + (i % 4 == 0 ? (Tick % 60) * 20 : 0);
+		pChar->m_HookY = pChar->m_Y;
+		pChar->m_PlayerFlags = 1;
+		pChar->m_Health = 10;
+		pChar->m_Weapon = i % 4;
+		pChar->m_AttackTick = Tick - Tick % 25;
+	}
+	for(int i = 0; i < NUM_PROJECTILES; i++)
+	{
+		CNetObj_Projectile *pProj = (CNetObj_Projectile *)s_Builder.NewItem(NETOBJTYPE_PROJECTILE, 100 + (i + Tick / 10) % 150, sizeof(CNetObj_Projectile));
+		pProj->m_X = 500 + i * 37;
+		pProj->m_Y = 800 + i * 11;
+		pProj->m_VelX = 1000;
+		pProj->m_VelY = -200;
+		pProj->m_Type = 2;
+		pProj->m_StartTick = Tick - 10 + i % 10;
+	}
+	return s_Builder.Finish(pSnapshot);
+}
+
+// the scalar and vectorised diffs and packing in MB/s on snapshots like the one above.
+// only prints timings, run it with --gtest_also_run_disabled_tests
+TEST(SnapshotDelta, DISABLED_Benchmark)
+{
+	const int NumSnaps = 50;
+	const int NumRepeats = 20;
+	std::vector<char> vPast(CSnapshot::MAX_SIZE), vCurrent(CSnapshot::MAX_SIZE);
+	CSnapshot *pPast = (CSnapshot *)vPast.data();
+	CSnapshot *pCurrent = (CSnapshot *)vCurrent.data();
+	CSnapshotDelta Delta;
+	std::vector<int> vDiff(CSnapshot::MAX_SIZE / sizeof(int)), vOut(CSnapshot::MAX_SIZE / sizeof(int));
+	std::vector<char> vDelta(CSnapshot::MAX_SIZE), vCompressed(CSnapshot::MAX_SIZE), vDecompressed(CSnapshot::MAX_SIZE);
+
+	// [scalar, vectorised] for diff, undiff, compress, decompress
+	int64_t aaNs[4][2] = {{0}};
+	int64_t aBytes[4] = {0};
+	int64_t aaChecksum[4][2] = {{0}};
+	BuildSnapshot(0, pPast);
+	for(int Snap = 1; Snap < NumSnaps; Snap++)
+	{
+		BuildSnapshot(Snap * 2, pCurrent);
+
+		std::vector<std::pair<int, int>> vPairs;
+		for(int i = 0; i < pCurrent->NumItems(); i++)
+		{
+			int PastIndex = pPast->GetItemIndex(pCurrent->GetItem(i)->Key());
+			if(PastIndex != -1)
+				vPairs.emplace_back(PastIndex, i);
+		}
+
+		int DeltaSize = Delta.CreateDelta(pPast, pCurrent, vDelta.data());
+		ASSERT_GT(DeltaSize, 0);
+		long CompressedSize = CVariableInt::Compress(vDelta.data(), DeltaSize, vCompressed.data(), vCompressed.size());
+		ASSERT_GT(CompressedSize, 0);
+
+		for(int Vectorised = 0; Vectorised < 2; Vectorised++)
+		{
+			int64_t Start = time_get_nanoseconds().count();
+			for(int r = 0; r < NumRepeats; r++)
+				for(const auto &Pair : vPairs)
+				{
+					int Size = pCurrent->GetItemSize(Pair.second) / sizeof(int);
+					int *pPastData = pPast->GetItem(Pair.first)->Data();
+					int *pCurrentData = pCurrent->GetItem(Pair.second)->Data();
+					aaChecksum[0][Vectorised] += Vectorised ? CSnapshotDelta::DiffItem(pPastData, pCurrentData, vDiff.data(), Size) : CSnapshotDelta::DiffItemScalar(pPastData, pCurrentData, vDiff.data(), Size);
+				}
+			aaNs[0][Vectorised] += time_get_nanoseconds().count() - Start;
+
+			Start = time_get_nanoseconds().count();
+			for(int r = 0; r < NumRepeats; r++)
+				for(const auto &Pair : vPairs)
+				{
+					int Size = pCurrent->GetItemSize(Pair.second) / sizeof(int);
+					int *pPastData = pPast->GetItem(Pair.first)->Data();
+					int DataRate = 0;
+					if(Vectorised)
+						CSnapshotDelta::UndiffItem(pPastData, pCurrent->GetItem(Pair.second)->Data(), vOut.data(), Size, &DataRate);
+					else
+						CSnapshotDelta::UndiffItemScalar(pPastData, pCurrent->GetItem(Pair.second)->Data(), vOut.data(), Size, &DataRate);
+					aaChecksum[1][Vectorised] += DataRate + vOut[Size - 1];
+				}
+			aaNs[1][Vectorised] += time_get_nanoseconds().count() - Start;
+
+			Start = time_get_nanoseconds().count();
+			for(int r = 0; r < NumRepeats; r++)
+				aaChecksum[2][Vectorised] += Vectorised ? CVariableInt::Compress(vDelta.data(), DeltaSize, vCompressed.data(), vCompressed.size()) : CVariableInt::CompressScalar(vDelta.data(), DeltaSize, vCompressed.data(), vCompressed.size());
+			aaNs[2][Vectorised] += time_get_nanoseconds().count() - Start;
+
+			Start = time_get_nanoseconds().count();
+			for(int r = 0; r < NumRepeats; r++)
+				aaChecksum[3][Vectorised] += Vectorised ? CVariableInt::Decompress(vCompressed.data(), CompressedSize, vDecompressed.data(), vDecompressed.size()) : CVariableInt::DecompressScalar(vCompressed.data(), CompressedSize, vDecompressed.data(), vDecompressed.size());
+			aaNs[3][Vectorised] += time_get_nanoseconds().count() - Start;
+			ASSERT_EQ(mem_comp(vDecompressed.data(), vDelta.data(), DeltaSize), 0);
+		}
+
+		for(const auto &Pair : vPairs)
+		{
+			aBytes[0] += NumRepeats * pCurrent->GetItemSize(Pair.second);
+			aBytes[1] += NumRepeats * pCurrent->GetItemSize(Pair.second);
+		}
+		aBytes[2] += NumRepeats * (int64_t)DeltaSize;
+		aBytes[3] += NumRepeats * (int64_t)DeltaSize;
+
+		std::swap(vPast, vCurrent);
+		pPast = (CSnapshot *)vPast.data();
+		pCurrent = (CSnapshot *)vCurrent.data();
+	}
+
+	const char *apNames[] = {"DiffItem", "UndiffItem", "CVariableInt::Compress", "CVariableInt::Decompress"};
+	for(int i = 0; i < 4; i++)
+	{
+		EXPECT_EQ(aaChecksum[i][0], aaChecksum[i][1]) << apNames[i];
+		dbg_msg("snapshot", "%s: scalar %.0f MB/s, vectorised %.0f MB/s", apNames[i],
+			aBytes[i] * 1000.0 / aaNs[i][0], aBytes[i] * 1000.0 / aaNs[i][1]);
+	}
+}
+
+// with extended item types, which are looked up through their type items
+static int BuildExSnapshot(int Tick, CSnapshot *pSnapshot)
+{
+	static CSnapshotBuilder s_Builder;
+	s_Builder.Init();
+	for(int i = 0; i < NUM_PLAYERS; i++)
+	{
+		if((i + Tick) % 7 == 0)
+			continue;
+		CNetObj_Character *pChar = (CNetObj_Character *)s_Builder.NewItem(NETOBJTYPE_CHARACTER, i, sizeof(CNetObj_Character));
+		pChar->m_Tick = Tick;
+		pChar->m_X = i * 100 + Tick;
+		CNetObj_DDNetCharacter *pExtended = (CNetObj_DDNetCharacter *)s_Builder.NewItem(NETOBJTYPE_DDNETCHARACTER, i, sizeof(CNetObj_DDNetCharacter));
+		pExtended->m_Flags = i;
+		pExtended->m_FreezeEnd = Tick;
+		if(i % 3 == 0)
+		{
+			CNetObj_Mario *pMario = (CNetObj_Mario *)s_Builder.NewItem(NETOBJTYPE_MARIO, i, sizeof(CNetObj_Mario));
+			pMario->m_X = i * 100 + Tick * 4;
+			pMario->m_AnimFrame = Tick;
+		}
+	}
+	return s_Builder.Finish(pSnapshot);
+}
+
+TEST(SnapshotIndex, LookupsMatchLinear)
+{
+	std::vector<char> vSnap(CSnapshot::MAX_SIZE), vPrev(CSnapshot::MAX_SIZE), vUnpacked(CSnapshot::MAX_SIZE), vDelta(CSnapshot::MAX_SIZE);
+	CSnapshot *pSnap = (CSnapshot *)vSnap.data();
+	CSnapshot *pPrev = (CSnapshot *)vPrev.data();
+	CSnapshotDelta Delta;
+	CSnapshotIndexBuffer Index;
+	for(int Tick = 0; Tick < 40; Tick++)
+	{
+		int Size = Tick % 2 ? BuildSnapshot(Tick, pSnap) : BuildExSnapshot(Tick, pSnap);
+		Index.Get()->Build(pSnap);
+		ASSERT_TRUE(Index.Get()->IsIndexed());
+
+		for(int Type = 0; Type < NUM_NETOBJTYPES; Type++)
+			for(int ID = 0; ID < 300; ID++)
+			{
+				int Key = (Type << 16) | ID;
+				ASSERT_EQ(pSnap->GetItemIndex(Key, Index.Get()), pSnap->GetItemIndex(Key)) << "type " << Type << " id " << ID;
+			}
+		for(int Type : {(int)NETOBJTYPE_CHARACTER, (int)NETOBJTYPE_PROJECTILE, (int)NETOBJTYPE_DDNETCHARACTER, (int)NETOBJTYPE_MARIO})
+			for(int ID = 0; ID < 300; ID++)
+				ASSERT_EQ(pSnap->FindItem(Type, ID, Index.Get()), pSnap->FindItem(Type, ID)) << "type " << Type << " id " << ID;
+		for(int i = 0; i < pSnap->NumItems(); i++)
+			ASSERT_EQ(pSnap->GetItemType(i, Index.Get()), pSnap->GetItemType(i));
+
+		// unpacking looks up the previous items through an index too
+		if(Tick > 0)
+		{
+			int DeltaSize = Delta.CreateDelta(pPrev, pSnap, vDelta.data());
+			ASSERT_GT(DeltaSize, 0);
+			ASSERT_EQ(Delta.UnpackDelta(pPrev, (CSnapshot *)vUnpacked.data(), vDelta.data(), DeltaSize), Size);
+			const CSnapshot *pUnpacked = (CSnapshot *)vUnpacked.data();
+			ASSERT_EQ(pUnpacked->NumItems(), pSnap->NumItems());
+			for(int i = 0; i < pSnap->NumItems(); i++)
+			{
+				int UnpackedIndex = pUnpacked->GetItemIndex(pSnap->GetItem(i)->Key());
+				ASSERT_NE(UnpackedIndex, -1);
+				ASSERT_EQ(pUnpacked->GetItemSize(UnpackedIndex), pSnap->GetItemSize(i));
+				ASSERT_EQ(mem_comp(pUnpacked->GetItem(UnpackedIndex)->Data(), pSnap->GetItem(i)->Data(), pSnap->GetItemSize(i)), 0);
+			}
+		}
+		std::swap(vSnap, vPrev);
+		pSnap = (CSnapshot *)vSnap.data();
+		pPrev = (CSnapshot *)vPrev.data();
+	}
+
+	// invalidated items are not found anymore
+	pSnap = pPrev;
+	Index.Get()->Build(pSnap);
+	int Index0 = pSnap->GetItemIndex((NETOBJTYPE_CHARACTER << 16) | 5, Index.Get());
+	ASSERT_NE(Index0, -1);
+	pSnap->GetItem(Index0)->m_TypeAndID = -1;
+	EXPECT_EQ(pSnap->GetItemIndex((NETOBJTYPE_CHARACTER << 16) | 5, Index.Get()), -1);
+}
+